@@ -71,4 +71,7 @@
 #define rmb()      dmb()
 #define wmb()      dmb()
 
+// Tell the CPU we're spinning in a polling loop.
+#define cpu_relax() asm volatile ("yield" : : : "memory")
+
 #endif /* __ARCH_BARRIER_H__ */
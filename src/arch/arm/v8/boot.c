@@ -28,6 +28,7 @@
 #include "base/lz4/lz4.h"
 #include "base/lzma/lzma.h"
 #include "base/physmem.h"
+#include "base/profile.h"
 #include "base/ranges.h"
 #include "base/timestamp.h"
 #include "vboot/boot.h"
@@ -141,8 +142,10 @@ int boot_arm_linux(void *fdt, FitImageNode *kernel)
 		break;
 	case CompressionLzma:
 		printf("Decompressing LZMA kernel to %p\n", reloc_addr);
+		profile_begin(&profile_decompress);
 		true_size = ulzman(kernel->data, kernel->size,
 				   reloc_addr, MaxKernelSize);
+		profile_end(&profile_decompress, true_size);
 		if (!true_size) {
 			printf("ERROR: LZMA decompression failed!\n");
 			return 1;
@@ -150,8 +153,10 @@ int boot_arm_linux(void *fdt, FitImageNode *kernel)
 		break;
 	case CompressionLz4:
 		printf("Decompressing LZ4 kernel to %p\n", reloc_addr);
+		profile_begin(&profile_decompress);
 		true_size = ulz4fn(kernel->data, kernel->size,
 				   reloc_addr, MaxKernelSize);
+		profile_end(&profile_decompress, true_size);
 		if (!true_size) {
 			printf("ERROR: LZ4 decompression failed!\n");
 			return 1;
@@ -79,4 +79,7 @@
 #define rmb()      dmb_opt(ld)
 #define wmb()      dmb_opt(st)
 
+// Tell the CPU we're spinning in a polling loop.
+#define cpu_relax() asm volatile ("yield" : : : "memory")
+
 #endif /* __ARCH_BARRIER_H__ */
@@ -35,4 +35,7 @@
 #define rmb()
 #define wmb()
 
+// Tell the CPU we're spinning in a polling loop.
+#define cpu_relax() asm volatile ("pause" : : : "memory")
+
 #endif /* __ARCH_BARRIER_H__ */
@@ -126,79 +126,6 @@ static int get_cbfs_range(uint32_t *offset, uint32_t *cbfs_end,
 	return 0;
 }
 
-struct cbfs_file *cbfs_get_file(struct cbfs_media *media, const char *name)
-{
-	const char *vardata;
-	uint32_t offset, cbfs_end, vardata_len;
-	struct cbfs_file file, *file_ptr;
-	struct cbfs_media default_media;
-
-	if (media == CBFS_DEFAULT_MEDIA) {
-		media = &default_media;
-		if (init_default_cbfs_media(media) != 0) {
-			ERROR("Failed to initialize default media.\n");
-			return NULL;
-		}
-	}
-
-	if (get_cbfs_range(&offset, &cbfs_end, media)) {
-		ERROR("Failed to find cbfs range\n");
-		return NULL;
-	}
-
-	DEBUG("CBFS location: 0x%x~0x%x\n", offset, cbfs_end);
-	DEBUG("Looking for '%s' starting from 0x%x.\n", name, offset);
-
-	media->open(media);
-	while (offset < cbfs_end &&
-	       media->read(media, &file, offset, sizeof(file)) == sizeof(file)) {
-		if (memcmp(CBFS_FILE_MAGIC, file.magic,
-			   sizeof(file.magic)) != 0) {
-			uint32_t new_align = CBFS_ALIGNMENT;
-			if (offset % CBFS_ALIGNMENT)
-				new_align += CBFS_ALIGNMENT -
-					(offset % CBFS_ALIGNMENT);
-			ERROR("ERROR: No file header found at 0x%xx - "
-			      "try next aligned address: 0x%x.\n", offset,
-			      offset + new_align);
-			offset += new_align;
-			continue;
-		}
-		vardata_len = ntohl(file.offset) - sizeof(file);
-		DEBUG(" - load entry 0x%x variable data (%d bytes)...\n",
-			offset, vardata_len);
-
-		// load file name (arbitrary length).
-		vardata = (const char*)media->map(
-				media, offset + sizeof(file), vardata_len);
-		if (vardata == CBFS_MEDIA_INVALID_MAP_ADDRESS) {
-			ERROR("ERROR: Failed to get filename: 0x%x.\n", offset);
-		} else if (strcmp(vardata, name) == 0) {
-			int file_offset = ntohl(file.offset),
-			    file_len = ntohl(file.len);
-			DEBUG("Found file (offset=0x%x, len=%d).\n",
-			    offset + file_offset, file_len);
-			media->unmap(media, vardata);
-			file_ptr = media->map(media, offset,
-					      file_offset + file_len);
-			media->close(media);
-			return file_ptr;
-		} else {
-			DEBUG(" (unmatched file @0x%x: %s)\n", offset,
-			      vardata);
-			media->unmap(media, vardata);
-		}
-
-		// Move to next file.
-		offset += ntohl(file.len) + ntohl(file.offset);
-		if (offset % CBFS_ALIGNMENT)
-			offset += CBFS_ALIGNMENT - (offset % CBFS_ALIGNMENT);
-	}
-	media->close(media);
-	LOG("WARNING: '%s' not found.\n", name);
-	return NULL;
-}
-
 static struct cbfs_file_attribute *cbfs_file_first_attr(struct cbfs_file *file)
 {
 	/* attributes_offset should be 0 when there is no attribute, but all
@@ -253,6 +180,333 @@ static struct cbfs_file_attribute *cbfs_file_find_attr(struct cbfs_file *file,
 
 }
 
+/*
+ * A parsed directory entry. Everything a lookup needs is kept here so that
+ * finding a file doesn't touch the media until its data is actually wanted.
+ */
+struct cbfs_index_entry {
+	char *name;
+	uint32_t hash;
+	// Offset of the file header on the media.
+	uint32_t offset;
+	// Offset of the file data from the header, and its length.
+	uint32_t data_offset;
+	uint32_t len;
+	uint32_t type;
+	int compression;
+	uint32_t decompressed_size;
+	// The next entry in the same hash bucket, or -1.
+	int next;
+};
+
+struct cbfs_index {
+	// The context and read method identify the media this index describes.
+	void *context;
+	size_t (*read)(struct cbfs_media *media, void *dest, size_t offset,
+		       size_t count);
+	struct cbfs_index_entry *entries;
+	int count;
+	int *buckets;
+	// The number of buckets minus 1, which is always a power of 2 minus 1.
+	uint32_t bucket_mask;
+	struct cbfs_index *next;
+};
+
+static struct cbfs_index *cbfs_indices;
+
+static uint32_t cbfs_name_hash(const char *name)
+{
+	// FNV-1a.
+	uint32_t hash = 0x811c9dc5;
+	while (*name) {
+		hash ^= (uint8_t)*name++;
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+/*
+ * Reads the file header at *offset into entry and advances *offset to where
+ * the next header should be. Returns 0 if a file was found, in which case
+ * *header is the mapped file header which the caller needs to unmap, 1 if
+ * there is no usable file at this offset, and -1 if the media can't be read.
+ */
+static int cbfs_load_entry(struct cbfs_media *media, uint32_t *offset,
+			   struct cbfs_index_entry *entry,
+			   struct cbfs_file **header)
+{
+	struct cbfs_file file;
+	uint32_t pos = *offset;
+
+	if (media->read(media, &file, pos, sizeof(file)) != sizeof(file))
+		return -1;
+
+	if (memcmp(CBFS_FILE_MAGIC, file.magic, sizeof(file.magic)) != 0) {
+		uint32_t new_align = CBFS_ALIGNMENT;
+		if (pos % CBFS_ALIGNMENT)
+			new_align += CBFS_ALIGNMENT - (pos % CBFS_ALIGNMENT);
+		ERROR("ERROR: No file header found at 0x%xx - "
+		      "try next aligned address: 0x%x.\n", pos,
+		      pos + new_align);
+		*offset = pos + new_align;
+		return 1;
+	}
+
+	// Move to next file.
+	uint32_t header_len = ntohl(file.offset);
+	*offset = pos + ntohl(file.len) + header_len;
+	if (*offset % CBFS_ALIGNMENT)
+		*offset += CBFS_ALIGNMENT - (*offset % CBFS_ALIGNMENT);
+
+	if (header_len <= sizeof(file)) {
+		ERROR("ERROR: Malformed file header at 0x%x.\n", pos);
+		return 1;
+	}
+
+	DEBUG(" - load entry 0x%x variable data (%d bytes)...\n",
+	      pos, header_len - (uint32_t)sizeof(file));
+
+	// Load the whole header, file name (arbitrary length) and attributes.
+	*header = media->map(media, pos, header_len);
+	if (*header == CBFS_MEDIA_INVALID_MAP_ADDRESS) {
+		ERROR("ERROR: Failed to get filename: 0x%x.\n", pos);
+		return 1;
+	}
+	if (strnlen((*header)->filename, header_len - sizeof(file)) ==
+	    header_len - sizeof(file)) {
+		ERROR("ERROR: Unterminated filename: 0x%x.\n", pos);
+		media->unmap(media, *header);
+		return 1;
+	}
+
+	entry->offset = pos;
+	entry->data_offset = header_len;
+	entry->len = ntohl(file.len);
+	entry->type = ntohl(file.type);
+	entry->compression = CBFS_COMPRESS_NONE;
+	entry->decompressed_size = entry->len;
+
+	struct cbfs_file_attribute *attr =
+		cbfs_file_find_attr(*header, CBFS_FILE_ATTR_TAG_COMPRESSION);
+	if (attr) {
+		struct cbfs_file_attr_compression *comp =
+			(struct cbfs_file_attr_compression *)attr;
+		entry->compression = ntohl(comp->compression);
+		entry->decompressed_size = ntohl(comp->decompressed_size);
+	}
+	return 0;
+}
+
+static void cbfs_free_index(struct cbfs_index *index)
+{
+	for (int i = 0; i < index->count; i++)
+		free(index->entries[i].name);
+	free(index->entries);
+	free(index->buckets);
+	free(index);
+}
+
+static struct cbfs_index *cbfs_build_index(struct cbfs_media *media)
+{
+	uint32_t offset, cbfs_end;
+
+	if (get_cbfs_range(&offset, &cbfs_end, media)) {
+		ERROR("Failed to find cbfs range\n");
+		return NULL;
+	}
+
+	DEBUG("CBFS location: 0x%x~0x%x\n", offset, cbfs_end);
+
+	struct cbfs_index *index = malloc(sizeof(*index));
+	if (!index)
+		return NULL;
+	memset(index, 0, sizeof(*index));
+	index->context = media->context;
+	index->read = media->read;
+
+	int capacity = 0;
+	int failed = 0;
+	media->open(media);
+	while (offset < cbfs_end) {
+		struct cbfs_index_entry entry;
+		struct cbfs_file *header;
+
+		int ret = cbfs_load_entry(media, &offset, &entry, &header);
+		if (ret < 0)
+			break;
+		if (ret)
+			continue;
+
+		entry.name = strdup(header->filename);
+		media->unmap(media, header);
+		if (!entry.name) {
+			failed = 1;
+			break;
+		}
+		entry.hash = cbfs_name_hash(entry.name);
+
+		if (index->count == capacity) {
+			int new_capacity = capacity ? capacity * 2 : 32;
+			struct cbfs_index_entry *entries = realloc(
+				index->entries,
+				new_capacity * sizeof(*entries));
+			if (!entries) {
+				free(entry.name);
+				failed = 1;
+				break;
+			}
+			index->entries = entries;
+			capacity = new_capacity;
+		}
+		index->entries[index->count++] = entry;
+	}
+	media->close(media);
+
+	uint32_t buckets = 1;
+	while (buckets < index->count)
+		buckets <<= 1;
+	index->buckets = failed ? NULL :
+		malloc(buckets * sizeof(*index->buckets));
+	if (!index->buckets) {
+		cbfs_free_index(index);
+		return NULL;
+	}
+	index->bucket_mask = buckets - 1;
+	for (int i = 0; i < buckets; i++)
+		index->buckets[i] = -1;
+
+	// Insert backwards so the first of any duplicate names is found first,
+	// like a linear scan would.
+	for (int i = index->count - 1; i >= 0; i--) {
+		struct cbfs_index_entry *entry = &index->entries[i];
+		int *bucket = &index->buckets[entry->hash & index->bucket_mask];
+		entry->next = *bucket;
+		*bucket = i;
+	}
+
+	DEBUG("Indexed %d CBFS files.\n", index->count);
+	return index;
+}
+
+static struct cbfs_index *cbfs_get_index(struct cbfs_media *media)
+{
+	for (struct cbfs_index *index = cbfs_indices; index;
+	     index = index->next) {
+		if (index->context == media->context &&
+		    index->read == media->read)
+			return index;
+	}
+
+	struct cbfs_index *index = cbfs_build_index(media);
+	if (index) {
+		index->next = cbfs_indices;
+		cbfs_indices = index;
+	}
+	return index;
+}
+
+void cbfs_invalidate_index(struct cbfs_media *media)
+{
+	struct cbfs_media default_media;
+
+	if (media == CBFS_DEFAULT_MEDIA) {
+		media = &default_media;
+		if (init_default_cbfs_media(media) != 0)
+			return;
+	}
+
+	struct cbfs_index **link = &cbfs_indices;
+	while (*link) {
+		struct cbfs_index *index = *link;
+		if (index->context == media->context &&
+		    index->read == media->read) {
+			*link = index->next;
+			cbfs_free_index(index);
+		} else {
+			link = &index->next;
+		}
+	}
+}
+
+/*
+ * Finds name on media and fills in entry. The index is used when there is
+ * one, and the media is scanned directly if it couldn't be built.
+ */
+static int cbfs_find_entry(struct cbfs_media *media, const char *name,
+			   struct cbfs_index_entry *entry)
+{
+	struct cbfs_index *index = cbfs_get_index(media);
+
+	if (index) {
+		uint32_t hash = cbfs_name_hash(name);
+		int i = index->buckets[hash & index->bucket_mask];
+		for (; i >= 0; i = index->entries[i].next) {
+			struct cbfs_index_entry *candidate =
+				&index->entries[i];
+			if (candidate->hash == hash &&
+			    strcmp(candidate->name, name) == 0) {
+				*entry = *candidate;
+				return 0;
+			}
+		}
+		LOG("WARNING: '%s' not found.\n", name);
+		return -1;
+	}
+
+	uint32_t offset, cbfs_end;
+	if (get_cbfs_range(&offset, &cbfs_end, media)) {
+		ERROR("Failed to find cbfs range\n");
+		return -1;
+	}
+
+	DEBUG("Looking for '%s' starting from 0x%x.\n", name, offset);
+
+	media->open(media);
+	while (offset < cbfs_end) {
+		struct cbfs_file *header;
+		int ret = cbfs_load_entry(media, &offset, entry, &header);
+		if (ret < 0)
+			break;
+		if (ret)
+			continue;
+		int match = strcmp(header->filename, name) == 0;
+		media->unmap(media, header);
+		if (match) {
+			media->close(media);
+			return 0;
+		}
+	}
+	media->close(media);
+	LOG("WARNING: '%s' not found.\n", name);
+	return -1;
+}
+
+struct cbfs_file *cbfs_get_file(struct cbfs_media *media, const char *name)
+{
+	struct cbfs_index_entry entry;
+	struct cbfs_file *file_ptr;
+	struct cbfs_media default_media;
+
+	if (media == CBFS_DEFAULT_MEDIA) {
+		media = &default_media;
+		if (init_default_cbfs_media(media) != 0) {
+			ERROR("Failed to initialize default media.\n");
+			return NULL;
+		}
+	}
+
+	if (cbfs_find_entry(media, name, &entry))
+		return NULL;
+
+	DEBUG("Found file (offset=0x%x, len=%d).\n",
+	      entry.offset + entry.data_offset, entry.len);
+	media->open(media);
+	file_ptr = media->map(media, entry.offset,
+			      entry.data_offset + entry.len);
+	media->close(media);
+	return file_ptr;
+}
+
 static int cbfs_decompress(int algo, void *src, void *dst, int len)
 {
 	switch (algo) {
@@ -272,6 +526,7 @@ static int cbfs_decompress(int algo, void *src, void *dst, int len)
 void *cbfs_get_file_content(struct cbfs_media *media, const char *name,
 			    int type, size_t *sz)
 {
+	struct cbfs_index_entry entry;
 	struct cbfs_media default_media;
 
 	if (media == CBFS_DEFAULT_MEDIA) {
@@ -282,53 +537,51 @@ void *cbfs_get_file_content(struct cbfs_media *media, const char *name,
 		}
 	}
 
-	struct cbfs_file *file = cbfs_get_file(media, name);
-
 	if (sz)
 		*sz = 0;
 
-	if (file == NULL) {
+	if (cbfs_find_entry(media, name, &entry)) {
 		ERROR("Could not find file '%s'.\n", name);
 		return NULL;
 	}
 
-	if (ntohl(file->type) != type) {
+	if (entry.type != type) {
 		ERROR("File '%s' is of type %x, but we requested %x.\n", name,
-		      ntohl(file->type), type);
+		      entry.type, type);
 		return NULL;
 	}
 
-	void *file_content = (void *)CBFS_SUBHEADER(file);
-
-	struct cbfs_file_attribute *attr =
-		cbfs_file_find_attr(file, CBFS_FILE_ATTR_TAG_COMPRESSION);
-
-	size_t final_size = ntohl(file->len);
-	int compression_algo = CBFS_COMPRESS_NONE;
-	if (attr) {
-		struct cbfs_file_attr_compression *comp =
-			(struct cbfs_file_attr_compression *)attr;
-		compression_algo = ntohl(comp->compression);
+	if (entry.compression != CBFS_COMPRESS_NONE)
 		DEBUG("File '%s' is compressed (alg=%d)\n",
-		      name, compression_algo);
-		final_size = ntohl(comp->decompressed_size);
-	}
+		      name, entry.compression);
 
+	size_t final_size = entry.decompressed_size;
 	void *dst = malloc(final_size);
 	if (dst == NULL)
-		goto err;
+		return NULL;
+
+	media->open(media);
+	void *file_content = media->map(media, entry.offset + entry.data_offset,
+					entry.len);
+	media->close(media);
+	if (file_content == CBFS_MEDIA_INVALID_MAP_ADDRESS) {
+		ERROR("Failed to map file '%s'.\n", name);
+		free(dst);
+		return NULL;
+	}
 
-	if (!cbfs_decompress(compression_algo, file_content, dst, final_size))
+	if (!cbfs_decompress(entry.compression, file_content, dst,
+			     final_size))
 		goto err;
 
 	if (sz)
 		*sz = final_size;
 
-	media->unmap(media, file);
+	media->unmap(media, file_content);
 	return dst;
 
 err:
-	media->unmap(media, file);
+	media->unmap(media, file_content);
 	free(dst);
 	return NULL;
 }
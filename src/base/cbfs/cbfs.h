@@ -213,6 +213,12 @@ struct cbfs_file *cbfs_get_file(struct cbfs_media *media, const char *name);
 void *cbfs_get_file_content(struct cbfs_media *media, const char *name,
 			    int type, size_t *sz);
 
+/*
+ * Lookups build an index of the files on a media the first time it is used.
+ * Drops the index for media, which must be called if its contents change.
+ */
+void cbfs_invalidate_index(struct cbfs_media *media);
+
 /* legacy APIs */
 void *cbfs_load_payload(struct cbfs_media *media, const char *name);
 
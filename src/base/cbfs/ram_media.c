@@ -100,6 +100,8 @@ static struct cbfs_media default_cbfs_media;
 
 int setup_cbfs_from_ram(void *start, uint32_t size)
 {
+	if (is_default_cbfs_media_initialized)
+		cbfs_invalidate_index(&default_cbfs_media);
 	int result = init_cbfs_ram_media(&default_cbfs_media, start, size);
 	if (result == 0)
 		is_default_cbfs_media_initialized = 1;
@@ -115,6 +117,8 @@ int libpayload_init_default_cbfs_media(struct cbfs_media *media)
 
 int setup_cbfs_from_flash(void)
 {
+	if (is_default_cbfs_media_initialized)
+		cbfs_invalidate_index(&default_cbfs_media);
 	int result = libpayload_init_default_cbfs_media(&default_cbfs_media);
 	if (result == 0)
 	    is_default_cbfs_media_initialized = 1;
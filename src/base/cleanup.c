@@ -22,6 +22,10 @@
 
 #include "base/cleanup.h"
 #include "base/container_of.h"
+#include "base/task.h"
+
+// How long background tasks get to finish before the hardware is torn down.
+static const uint64_t CleanupTaskTimeoutMs = 2000;
 
 static ListNode cleanup_events;
 
@@ -39,6 +43,10 @@ int cleanup_trigger(CleanupType type)
 {
 	int ret = 0;
 
+	// Give background work a chance to finish before the hardware is torn
+	// down, but don't let one stuck task hold up the handoff.
+	task_wait_all(CleanupTaskTimeoutMs);
+
 	CleanupEvent *cleanup;
 	list_for_each(cleanup, cleanup_events, event.list_node)
 		if (cleanup->types & type)
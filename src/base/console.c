@@ -30,7 +30,10 @@
 #include <string.h>
 #include <usb/usb.h>
 
+#include "base/task.h"
+#include "base/time.h"
 #include "drivers/console/console.h"
+#include "drivers/keyboard/keyboard.h"
 
 int putchar(unsigned int i)
 {
@@ -58,13 +61,16 @@ static int _havekey(int trusted)
 
 static int _getchar(int trusted)
 {
-	ConsoleInputOps *console = NULL;
+	ConsoleInputOps *console;
 
-	do {
+	while (1) {
 		if (CONFIG_USB)
 			usb_poll();
 		console = console_has_key(trusted);
-	} while (!console);
+		if (console)
+			break;
+		task_mdelay(KeyboardPollMs);
+	}
 
 	return console->getchar(console);
 }
@@ -79,6 +85,18 @@ int havekey_trusted(void)
 	return _havekey(1);
 }
 
+int havekey_wait(uint64_t timeout_us)
+{
+	uint64_t deadline = time_deadline_us(timeout_us);
+
+	while (!_havekey(0)) {
+		if (time_deadline_expired(deadline))
+			return 0;
+		task_mdelay(KeyboardPollMs);
+	}
+	return 1;
+}
+
 int getchar(void)
 {
 	return _getchar(0);
@@ -30,10 +30,74 @@
 #include "base/xalloc.h"
 #include "drivers/flash/flash.h"
 
+// A hash bucket index or chain link which doesn't point to an entry.
+static const int DcDirNoEntry = -1;
+
+typedef struct
+{
+	// The label, zero padded to 8 bytes like it is in the table.
+	uint64_t label;
+	DcDirPointer *pointer;
+	// The next entry in the same hash bucket.
+	int next;
+} DcDirEntry;
+
+typedef struct DcDirCache
+{
+	// The raw pointer table the entries point into.
+	void *table;
+	DcDirEntry *entries;
+	int *buckets;
+	// The number of buckets minus 1, which is always a power of 2 minus 1.
+	uint32_t bucket_mask;
+} DcDirCache;
+
+static uint32_t dcdir_read_count;
+
+static int dcdir_read(StorageOps *storage, void *buffer, uint64_t offset,
+		      size_t size)
+{
+	dcdir_read_count++;
+	return storage_read(storage, buffer, offset, size);
+}
+
+uint32_t dcdir_storage_reads(void)
+{
+	return dcdir_read_count;
+}
+
+static uint64_t dcdir_label(const char *name)
+{
+	uint64_t label = 0;
+	memcpy(&label, name, MIN(strlen(name), sizeof(label)));
+	return label;
+}
+
+static uint32_t dcdir_hash(uint64_t label, uint32_t mask)
+{
+	uint32_t hash = (uint32_t)label ^ (uint32_t)(label >> 32);
+	hash *= 0x9e3779b1;
+	return (hash ^ (hash >> 16)) & mask;
+}
+
+// Drop the parsed table of a handle which is being reopened.
+static void dcdir_free_cache(DcDir *dir)
+{
+	DcDirCache *cache = dir->cache;
+
+	if (!cache)
+		return;
+	free(cache->table);
+	free(cache->entries);
+	free(cache->buckets);
+	free(cache);
+	dir->cache = NULL;
+}
+
 int dcdir_open_root(DcDir *dcdir, StorageOps *storage, uint32_t anchor_offset)
 {
 	DcDirAnchor anchor;
-	if (storage_read(storage, &anchor, anchor_offset, sizeof(anchor)))
+	if (dcdir_read(storage, &anchor, anchor_offset, sizeof(anchor)))
 		return 1;
 
 	if (memcmp(anchor.signature, DcDirAnchorSignature,
@@ -57,16 +121,16 @@ int dcdir_open_root(DcDir *dcdir, StorageOps *storage, uint32_t anchor_offset)
 
 	dcdir->offset = anchor_offset + sizeof(DcDirAnchor);
 	dcdir->base = anchor.root_base;
+	dcdir_free_cache(dcdir);
 
 	return 0;
 }
 
-static DcDirPointer *dcdir_find_in_dir(DcDir *dir, StorageOps *storage,
-				       const char *name)
+static DcDirCache *dcdir_load_cache(DcDir *dir, StorageOps *storage)
 {
 	DcDirDirectoryHeader header;
 
-	if (storage_read(storage, &header, dir->offset, sizeof(header)))
+	if (dcdir_read(storage, &header, dir->offset, sizeof(header)))
 		return NULL;
 
 	if (memcmp(header.signature, DcDirDirectorySignature,
@@ -82,39 +146,85 @@ static DcDirPointer *dcdir_find_in_dir(DcDir *dir, StorageOps *storage,
 	size -= sizeof(header);
 
 	if (size < 0) {
-		printf("Malformed DcDir directory found when looking up %s.\n",
-		       name);
+		printf("Malformed DcDir directory.\n");
 		return NULL;
 	}
 
-	void *pointers = xmalloc(size);
-	if (storage_read(storage, pointers, dir->offset + sizeof(header),
-			 size)) {
-		free(pointers);
+	uint8_t *table = xmalloc(size);
+	if (dcdir_read(storage, table, dir->offset + sizeof(header), size)) {
+		free(table);
 		return NULL;
 	}
 
-	while (size > 0) {
-		uint64_t *ptr_name = pointers;
-		pointers = (uint8_t *)pointers + sizeof(*ptr_name);
-
-		DcDirPointer *gen_ptr = pointers;
+	// Every entry is at least an 8 byte label and an 8 byte pointer.
+	int max_entries = size / 16;
+	uint32_t buckets = 1;
+	while (buckets < max_entries)
+		buckets <<= 1;
+
+	DcDirCache *cache = xmalloc(sizeof(*cache));
+	cache->table = table;
+	cache->entries = xmalloc(max_entries * sizeof(*cache->entries));
+	cache->buckets = xmalloc(buckets * sizeof(*cache->buckets));
+	cache->bucket_mask = buckets - 1;
+	for (int i = 0; i < buckets; i++)
+		cache->buckets[i] = DcDirNoEntry;
+
+	int count = 0;
+	uint8_t *pos = table;
+	while (size >= sizeof(uint64_t) + sizeof(DcDirPointer)) {
+		DcDirEntry *entry = &cache->entries[count];
+		memcpy(&entry->label, pos, sizeof(entry->label));
+		pos += sizeof(entry->label);
+		size -= sizeof(entry->label);
+
+		DcDirPointer *gen_ptr = (DcDirPointer *)pos;
 		int ptr_size = (gen_ptr->size + 1) * 8;
+		if (ptr_size > size) {
+			printf("Malformed DcDir pointer found.\n");
+			break;
+		}
+		entry->pointer = gen_ptr;
+
+		// Keep the first of any duplicate labels, like a linear scan.
+		uint32_t bucket = dcdir_hash(entry->label, cache->bucket_mask);
+		entry->next = DcDirNoEntry;
+		int *link = &cache->buckets[bucket];
+		while (*link != DcDirNoEntry)
+			link = &cache->entries[*link].next;
+		*link = count++;
+
+		pos += ptr_size;
+		size -= ptr_size;
+	}
 
-		size_t name_len = MIN(strlen(name), sizeof(*ptr_name));
+	dir->cache = cache;
+	return cache;
+}
 
-		if (!memcmp(name, ptr_name, name_len)) {
-			void *buf = xmalloc(ptr_size);
-			memcpy(buf, gen_ptr, ptr_size);
-			free(pointers);
-			return buf;
+static DcDirPointer *dcdir_find_in_dir(DcDir *dir, StorageOps *storage,
+				       const char *name)
+{
+	DcDirCache *cache = dir->cache;
+
+	if (!cache) {
+		cache = dcdir_load_cache(dir, storage);
+		if (!cache) {
+			printf("Failed to read DcDir directory when "
+			       "looking up %s.\n", name);
+			return NULL;
 		}
+	}
 
-		pointers = (uint8_t *)pointers + ptr_size;
-		size -= ptr_size;
+	uint64_t label = dcdir_label(name);
+	int index = cache->buckets[dcdir_hash(label, cache->bucket_mask)];
+	while (index != DcDirNoEntry) {
+		DcDirEntry *entry = &cache->entries[index];
+		if (entry->label == label)
+			return entry->pointer;
+		index = entry->next;
 	}
 
-	free(pointers);
 	return NULL;
 }
 
@@ -131,7 +241,6 @@ int dcdir_open_dir_raw(DcDir *dcdir, DcDirRegion *raw,
 	int type = ptr_ptr->type >> 1;
 
 	if (!directory) {
-		free(ptr_ptr);
 		printf("DcDir region is not a directory.\n");
 		return 1;
 	}
@@ -168,14 +277,13 @@ int dcdir_open_dir_raw(DcDir *dcdir, DcDirRegion *raw,
 	}
 	break;
 	default:
-		free(ptr_ptr);
 		printf("Unrecognized dcdir pointer type.");
 		return 1;
 	}
 
 	raw->offset = dcdir->offset;
+	dcdir_free_cache(dcdir);
 
-	free(ptr_ptr);
 	return 0;
 }
 
@@ -198,7 +306,6 @@ int dcdir_open_region(DcDirRegion *region, StorageOps *storage,
 	int type = ptr_ptr->type >> 1;
 
 	if (directory) {
-		free(ptr_ptr);
 		printf("DcDir region is a directory.\n");
 		return 1;
 	}
@@ -231,11 +338,9 @@ int dcdir_open_region(DcDirRegion *region, StorageOps *storage,
 	}
 	break;
 	default:
-		free(ptr_ptr);
 		printf("Unrecognized dcdir pointer type.");
 		return 1;
 	}
 
-	free(ptr_ptr);
 	return 0;
 }
@@ -31,13 +31,19 @@
  * This structure is supposed to be an opaque handle to a directory in a
  * DcDir. For practical reasons the information is visible, but it's only for
  * the dcdir's internal bookkeeping and shouldn't be examined or modified.
+ * A handle must be zeroed before it's opened for the first time. Opening it
+ * again frees anything held for the directory it referred to before.
  */
+struct DcDirCache;
+
 typedef struct
 {
 	// The offset of the directory table within the directory it describes.
 	uint32_t base;
 	// The offset of directory table within the image.
 	uint32_t offset;
+	// A parsed copy of the directory table, read in on the first lookup.
+	struct DcDirCache *cache;
 } DcDir;
 
 /*
@@ -102,4 +108,12 @@ int dcdir_open_dir_raw(DcDir *dcdir, DcDirRegion *raw_region,
 int dcdir_open_region(DcDirRegion *region, StorageOps *storage,
 		      DcDir *parent_dir, const char *name);
 
+/*
+ * Return the number of times the dcdir code has read from storage.
+ *
+ * Each directory's table is only read once and then looked up from memory,
+ * so this shows how much flash traffic opening regions is generating.
+ */
+uint32_t dcdir_storage_reads(void);
+
 #endif /* __BASE_DCDIR_H__ */
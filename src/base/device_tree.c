@@ -429,9 +429,10 @@ void dt_flatten(DeviceTree *tree, void *start_dest)
 	uint32_t strings_size = 0;
 	dt_flat_node_size(tree->root, &struct_size, &strings_size);
 
+	// The structure block's size includes the end token which closes it.
 	uint8_t *struct_start = dest;
 	header->structure_offset = htobe32(dest - (uint8_t *)start_dest);
-	header->structure_size = htobe32(struct_size);
+	header->structure_size = htobe32(struct_size + sizeof(uint32_t));
 	dest += struct_size;
 
 	*((uint32_t *)dest) = htobe32(TokenEnd);
@@ -118,23 +118,32 @@ int fwdb_use_db(FwdbHeader *header)
 		printf("Warning: Ignoring index structure.\n");
 
 	// Traverse the table and make sure all the entries are well formed
-	// (as far as we can tell), and that the table fits in the prescribed
-	// bounds so far.
-	uint32_t total_size = header->header_size;
-	uintptr_t entry_addr = (uintptr_t)header + total_size;
+	// (as far as we can tell), and that the table, including the padding
+	// between entries and the final 0 terminating size field, fits in the
+	// prescribed bounds.
+	uintptr_t header_addr = (uintptr_t)header;
+	uintptr_t entry_addr = header_addr + header->header_size;
 	while (1) {
 		uint32_t *entry_size = (uint32_t *)entry_addr;
-		total_size += *entry_size;
-		if (total_size >= header->max_size)
-			break;
+		uintptr_t end = entry_addr + sizeof(*entry_size);
+		if (end - header_addr <= header->max_size && *entry_size)
+			end = entry_addr + *entry_size;
+
+		if (end - header_addr > header->max_size) {
+			printf("The FWDB doesn't fit in %d bytes.\n",
+			       header->max_size);
+			return 1;
+		}
 
 		if (!*entry_size)
 			break;
 
+		// The name has to end within the entry.
 		const char *name_ptr =
 			(const char *)(entry_addr + sizeof(*entry_size));
-		size_t name_len = strnlen(name_ptr, *entry_size);
-		if (name_len == *entry_size) {
+		size_t name_space = *entry_size > sizeof(*entry_size) ?
+				    *entry_size - sizeof(*entry_size) : 0;
+		if (strnlen(name_ptr, name_space) == name_space) {
 			printf("Malformed entry name detected.\n");
 			return 1;
 		}
@@ -142,14 +151,6 @@ int fwdb_use_db(FwdbHeader *header)
 		entry_addr += *entry_size;
 		entry_addr = ALIGN(entry_addr, sizeof(uint64_t));
 	}
-	// Add in the final 0 terminating size field.
-	total_size += sizeof(uint32_t);
-
-	if (total_size > header->max_size) {
-		printf("FWDB takes %d bytes, which is more than %d.\n",
-		       total_size, header->max_size);
-		return 1;
-	}
 
 	fwdb_header = header;
 	return 0;
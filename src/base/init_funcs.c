@@ -21,6 +21,7 @@
  */
 
 #include "base/init_funcs.h"
+#include "base/task.h"
 #include "module/symbols.h"
 
 int run_init_funcs(void)
@@ -29,8 +30,11 @@ int run_init_funcs(void)
 	init_func_t *end = (init_func_t *)&_init_funcs_end;
 	int res = 0;
 
-	for (init_func_t *init_func = start; init_func != end; init_func++)
+	for (init_func_t *init_func = start; init_func != end; init_func++) {
 		res = (*init_func)() || res;
+		// Give anything an init function started a chance to progress.
+		task_yield();
+	}
 
 	return res;
 }
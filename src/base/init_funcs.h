@@ -41,6 +41,10 @@
 #define INIT_FUNC_PRIORITY_BANNER e_banner
 // The default priority.
 #define INIT_FUNC_PRIORITY_NORMAL n_normal
+// Start background work on the EC once the board has set up its bus.
+#define INIT_FUNC_PRIORITY_EC p_ec
+// Start bringing up storage once the board has registered its controllers.
+#define INIT_FUNC_PRIORITY_STORAGE s_storage
 
 typedef int (*init_func_t)(void);
 
@@ -66,6 +70,8 @@ typedef int (*init_func_t)(void);
 #define INIT_FUNC_BANNER(func) _INIT_FUNC_PRIORITY(BANNER, func)
 #define INIT_FUNC_TIMESTAMP(func) _INIT_FUNC_PRIORITY(TIMESTAMP, func)
 #define INIT_FUNC_NORMAL(func) _INIT_FUNC_PRIORITY(NORMAL, func)
+#define INIT_FUNC_EC(func) _INIT_FUNC_PRIORITY(EC, func)
+#define INIT_FUNC_STORAGE(func) _INIT_FUNC_PRIORITY(STORAGE, func)
 
 int run_init_funcs(void);
 
@@ -27,26 +27,131 @@
  * SUCH DAMAGE.
  */
 
+#include <endian.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
-uint16_t ipchecksum(const void *vptr, size_t nbytes)
+#include "base/ipchecksum.h"
+
+typedef union {
+	uint8_t bytes[2];
+	uint16_t word;
+} IpChecksumWord;
+
+static uint16_t ipchecksum_fold(uint64_t sum)
 {
-	int sum, oddbyte;
-	const uint16_t *ptr = vptr;
+	sum = (sum >> 32) + (sum & 0xffffffff);
+	sum = (sum >> 32) + (sum & 0xffffffff);
+	sum = (sum >> 16) + (sum & 0xffff);
+	sum = (sum >> 16) + (sum & 0xffff);
+	return sum;
+}
 
-	sum = 0;
-	while (nbytes > 1) {
-		sum += *ptr++;
+/*
+ * Sum a buffer in native byte order, optionally copying it to dest on the
+ * way through. dest must be NULL or have the same alignment modulo 4 as src.
+ * The 32 bit words are accumulated into a 64 bit sum which can't carry out
+ * for any buffer that fits in memory, so folding only happens at the end.
+ */
+static inline __attribute__((always_inline))
+uint16_t ipchecksum_sum(uint8_t *dest, const uint8_t *src, size_t nbytes)
+{
+	IpChecksumWord word;
+	uint64_t sum = 0;
+	int odd = (uintptr_t)src & 1;
+
+	if (!nbytes)
+		return 0;
+
+	/*
+	 * Sum an odd address as if a zero byte came before it. That swaps the
+	 * bytes of every 16 bit word relative to the real ones, which is
+	 * undone once the sum has been folded.
+	 */
+	if (odd) {
+		word.bytes[0] = 0;
+		word.bytes[1] = *src;
+		if (dest)
+			*dest++ = *src;
+		src++;
+		nbytes--;
+		sum += word.word;
+	}
+	if (nbytes >= 2 && ((uintptr_t)src & 2)) {
+		uint16_t val = *(const uint16_t *)src;
+		if (dest) {
+			*(uint16_t *)dest = val;
+			dest += 2;
+		}
+		src += 2;
 		nbytes -= 2;
+		sum += val;
 	}
-	if (nbytes == 1) {
-		oddbyte = 0;
-		((uint8_t *)&oddbyte)[0] = *(uint8_t *)ptr;
-		((uint8_t *)&oddbyte)[1] = 0;
-		sum += oddbyte;
+
+	const uint32_t *src32 = (const uint32_t *)src;
+	uint32_t *dest32 = (uint32_t *)dest;
+	while (nbytes >= 16) {
+		uint32_t a = src32[0], b = src32[1], c = src32[2], d = src32[3];
+		if (dest32) {
+			dest32[0] = a;
+			dest32[1] = b;
+			dest32[2] = c;
+			dest32[3] = d;
+			dest32 += 4;
+		}
+		src32 += 4;
+		nbytes -= 16;
+		sum += (uint64_t)a + b + c + d;
 	}
-	sum = (sum >> 16) + (sum & 0xffff);
-	sum += (sum >> 16);
-	return (~sum);
+	while (nbytes >= 4) {
+		uint32_t val = *src32++;
+		if (dest32)
+			*dest32++ = val;
+		nbytes -= 4;
+		sum += val;
+	}
+	src = (const uint8_t *)src32;
+	dest = (uint8_t *)dest32;
+
+	if (nbytes >= 2) {
+		uint16_t val = *(const uint16_t *)src;
+		if (dest) {
+			*(uint16_t *)dest = val;
+			dest += 2;
+		}
+		src += 2;
+		nbytes -= 2;
+		sum += val;
+	}
+	if (nbytes) {
+		word.bytes[0] = *src;
+		word.bytes[1] = 0;
+		if (dest)
+			*dest = *src;
+		sum += word.word;
+	}
+
+	uint16_t folded = ipchecksum_fold(sum);
+	return odd ? swap_bytes16(folded) : folded;
+}
+
+uint16_t ipchecksum_add(uint16_t sum, const void *ptr, size_t nbytes)
+{
+	return ipchecksum_fold((uint64_t)sum +
+			       ipchecksum_sum(NULL, ptr, nbytes));
+}
+
+uint16_t ipchecksum_copy(void *dest, const void *src, size_t nbytes)
+{
+	if (((uintptr_t)dest ^ (uintptr_t)src) & 3) {
+		memcpy(dest, src, nbytes);
+		return ipchecksum_sum(NULL, src, nbytes);
+	}
+	return ipchecksum_sum(dest, src, nbytes);
+}
+
+uint16_t ipchecksum(const void *ptr, size_t nbytes)
+{
+	return ~ipchecksum_sum(NULL, ptr, nbytes);
 }
@@ -31,6 +31,24 @@
 #include <stddef.h>
 #include <stdint.h>
 
+/*
+ * The Internet checksum (RFC 1071) of a buffer, ready to be stored in a
+ * header. The sum is computed on 16 bit words in native byte order, so the
+ * result can be stored into the buffer without swapping it.
+ */
 uint16_t ipchecksum(const void *ptr, size_t nbytes);
 
+/*
+ * Add the one's complement sum of a buffer to a partial sum and return the
+ * new, uncomplemented partial sum. Buffers chained together this way should
+ * all have even lengths except for possibly the last one.
+ */
+uint16_t ipchecksum_add(uint16_t sum, const void *ptr, size_t nbytes);
+
+/*
+ * Copy a buffer like memcpy and return its uncomplemented one's complement
+ * sum, reading the source only once.
+ */
+uint16_t ipchecksum_copy(void *dest, const void *src, size_t nbytes);
+
 #endif
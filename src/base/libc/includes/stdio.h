@@ -30,6 +30,7 @@
 
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /**
  * @defgroup printf Print functions
@@ -58,5 +59,7 @@ int havekey(void);
 int getchar(void);
 int havekey_trusted(void);
 int getchar_trusted(void);
+/* Wait up to timeout_us for a key, idling between checks. */
+int havekey_wait(uint64_t timeout_us);
 
 #endif
@@ -123,7 +123,7 @@ int dma_coherent(void *ptr)
 	return !dma_initialized() || (dma->start <= ptr && dma->end > ptr);
 }
 
-static void *alloc(int len, struct memory_type *type)
+static void *alloc(size_t len, struct memory_type *type)
 {
 	hdrtype_t header;
 	hdrtype_t volatile *ptr = (hdrtype_t volatile *)type->start;
@@ -266,7 +266,13 @@ void *dma_malloc(size_t size)
 void *calloc(size_t nmemb, size_t size)
 {
 	size_t total = nmemb * size;
-	void *ptr = alloc(total, heap);
+	void *ptr;
+
+	/* Don't hand out a short block if the size overflowed. */
+	if (size && total / size != nmemb)
+		return NULL;
+
+	ptr = alloc(total, heap);
 
 	if (ptr)
 		memset(ptr, 0, total);
@@ -276,13 +282,18 @@ void *calloc(size_t nmemb, size_t size)
 
 void *realloc(void *ptr, size_t size)
 {
-	void *ret, *pptr;
-	unsigned int osize;
+	void *ret, *pptr, *nptr;
+	size_t osize, len;
 	struct memory_type *type = heap;
 
 	if (ptr == NULL)
 		return alloc(size, type);
 
+	if (size == 0) {
+		free(ptr);
+		return NULL;
+	}
+
 	pptr = ptr - HDRSIZE;
 
 	if (!HAS_MAGIC(*((hdrtype_t *) pptr)))
@@ -294,23 +305,44 @@ void *realloc(void *ptr, size_t size)
 	/* Get the original size of the block. */
 	osize = SIZE(*((hdrtype_t *) pptr));
 
+	len = ALIGN_UP(size, HDRSIZE);
+	if (!len || len > MAX_SIZE)
+		return NULL;
+
+	/* Shrinking keeps the block as it is. */
+	if (len <= osize)
+		return ptr;
+
 	/*
-	 * Free the memory to update the tables - this won't touch the actual
-	 * memory, so we can still use it for the copy after we have
-	 * reallocated the new space.
+	 * Grow into the free block after this one if it's big enough, the
+	 * same way alloc() would split it.
 	 */
-	free(ptr);
-	ret = alloc(size, type);
+	nptr = ptr + osize;
+	if (nptr < type->end && IS_FREE(*((hdrtype_t *) nptr)) &&
+	    osize + HDRSIZE + SIZE(*((hdrtype_t *) nptr)) >= len) {
+		size_t total = osize + HDRSIZE + SIZE(*((hdrtype_t *) nptr));
+
+		if (total > len + HDRSIZE) {
+			*((hdrtype_t *) pptr) = USED_BLOCK(len);
+			*((hdrtype_t *) (ptr + len)) =
+				FREE_BLOCK(total - len - HDRSIZE);
+		} else {
+			*((hdrtype_t *) pptr) = USED_BLOCK(total);
+		}
+		return ptr;
+	}
 
 	/*
-	 * if ret == NULL, then doh - failure.
-	 * if ret == ptr then woo-hoo! no copy needed.
+	 * Otherwise move it. The old block has to stay allocated until the
+	 * copy is done, since alloc() writes headers into free space, and if
+	 * there's no room the caller still owns it.
 	 */
-	if (ret == NULL || ret == ptr)
-		return ret;
+	ret = alloc(size, type);
+	if (ret == NULL)
+		return NULL;
 
-	/* Copy the memory to the new location. */
-	memcpy(ret, ptr, osize > size ? size : osize);
+	memcpy(ret, ptr, osize);
+	free(ptr);
 
 	return ret;
 }
@@ -365,7 +397,7 @@ static struct align_region_t *allocate_region(int alignment, int num_elements,
 	if (r == NULL)
 		return NULL;
 
-	memset(r, 0, sizeof(r));
+	memset(r, 0, sizeof(*r));
 
 	if (num_elements != 0) {
 		r->alignment = alignment;
@@ -181,13 +181,13 @@ static int print_char(char c, int width, uint64_t flags, struct printf_spec *ps)
  *
  * @param s		String to be printed.
  * @param width		Width modifier.
- * @param precision	Precision modifier.
+ * @param precision	Precision modifier, or -1 if there isn't one.
  * @param flags		Flags that modify the way the string is printed.
  * @param ps		Output methods spec for different printf clones.
  * @return		Number of characters printed, negative value on	failure.
  */
 /** Structure for specifying output methods for different printf clones. */
-static int print_string(char *s, int width, unsigned int precision,
+static int print_string(char *s, int width, int precision,
 			uint64_t flags, struct printf_spec *ps)
 {
 	int counter = 0, retval;
@@ -195,11 +195,10 @@ static int print_string(char *s, int width, unsigned int precision,
 
 	if (s == NULL)
 		return printf_putstr("(NULL)", ps);
-	size = strlen(s);
+	/* Don't look past precision characters, which may not end in a 0. */
+	size = precision < 0 ? strlen(s) : strnlen(s, precision);
 	/* Print leading spaces. */
-	if (precision == 0)
-		precision = size;
-	width -= precision;
+	width -= size;
 
 	if (!(flags & __PRINTF_FLAG_LEFTALIGNED)) {
 		if ((retval = print_spaces(width, ps)) < 0)
@@ -208,7 +207,7 @@ static int print_string(char *s, int width, unsigned int precision,
 			counter += retval;
 	}
 
-	if ((retval = printf_putnchars(s, MIN(size, precision), ps)) < 0)
+	if ((retval = printf_putnchars(s, size, ps)) < 0)
 		return retval;
 	counter += retval;
 
@@ -513,9 +512,10 @@ static int printf_core(const char *fmt, struct printf_spec *ps, va_list ap)
 			}
 
 			/* Precision and '*' operator. */
-			precision = 0;
+			precision = -1;
 			if (fmt[i] == '.') {
 				++i;
+				precision = 0;
 				if (isdigit(fmt[i])) {
 					while (isdigit(fmt[i])) {
 						precision *= 10;
@@ -527,7 +527,7 @@ static int printf_core(const char *fmt, struct printf_spec *ps, va_list ap)
 					precision = (int)va_arg(ap, int);
 					/* Ignore negative precision. */
 					if (precision < 0)
-						precision = 0;
+						precision = -1;
 				}
 			}
 
@@ -617,11 +617,11 @@ static int printf_core(const char *fmt, struct printf_spec *ps, va_list ap)
 			switch (qualifier) {
 			case PrintfQualifierByte:
 				size = sizeof(unsigned char);
-				number = (uint64_t) va_arg(ap, unsigned int);
+				number = (unsigned char) va_arg(ap, unsigned int);
 				break;
 			case PrintfQualifierShort:
 				size = sizeof(unsigned short);
-				number = (uint64_t) va_arg(ap, unsigned int);
+				number = (unsigned short) va_arg(ap, unsigned int);
 				break;
 			case PrintfQualifierInt:
 				size = sizeof(unsigned int);
@@ -655,8 +655,9 @@ static int printf_core(const char *fmt, struct printf_spec *ps, va_list ap)
 				}
 			}
 
-			if ((retval = print_number(number, width, precision,
-						   base, flags, ps)) < 0)
+			if ((retval = print_number(number, width,
+						   MAX(precision, 0), base,
+						   flags, ps)) < 0)
 				return retval;
 
 			counter += retval;
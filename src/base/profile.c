@@ -0,0 +1,189 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "base/cleanup.h"
+#include "base/init_funcs.h"
+#include "base/profile.h"
+#include "base/time.h"
+
+typedef struct {
+	ProfileZone *zone;
+	uint64_t start_us;
+	uint64_t duration_us;
+	uint64_t bytes;
+	int depth;
+} ProfileRecord;
+
+typedef struct {
+	ProfileZone *zone;
+	uint64_t start_us;
+	// Index into profile_records, or -1 if the buffer was full.
+	int record;
+} ProfileFrame;
+
+PROFILE_ZONE_TS(profile_storage, "storage", TS_PROFILE_STORAGE);
+PROFILE_ZONE_TS(profile_decompress, "decompress", TS_PROFILE_DECOMPRESS);
+PROFILE_ZONE_TS(profile_hash, "hash", TS_PROFILE_HASH);
+PROFILE_ZONE_TS(profile_display, "display", TS_PROFILE_DISPLAY);
+PROFILE_ZONE_TS(profile_usb, "usb", TS_PROFILE_USB);
+
+static ProfileRecord profile_records[CONFIG_PROFILE_MAX_RECORDS];
+static int profile_record_count;
+static int profile_records_dropped;
+
+static ProfileFrame profile_stack[CONFIG_PROFILE_MAX_DEPTH];
+static int profile_depth;
+static int profile_overflow_depth;
+
+static ProfileZone *profile_zones;
+
+void profile_begin(ProfileZone *zone)
+{
+	if (!CONFIG_PROFILE)
+		return;
+
+	uint64_t now = time_us(0);
+
+	if (!zone->registered) {
+		zone->next = profile_zones;
+		profile_zones = zone;
+		zone->registered = 1;
+	}
+
+	// Keep counting nesting we can't track so begins and ends still pair.
+	if (profile_depth == CONFIG_PROFILE_MAX_DEPTH) {
+		profile_overflow_depth++;
+		return;
+	}
+
+	// Only the first pass goes in the timestamp table, which is small
+	// and silently drops anything logged once it's full.
+	if (zone->ts_id && !zone->ts_logged) {
+		timestamp_add_now(zone->ts_id);
+		zone->ts_logged = 1;
+	}
+
+	ProfileFrame *frame = &profile_stack[profile_depth];
+	frame->zone = zone;
+	frame->start_us = now;
+	frame->record = -1;
+	if (profile_record_count < CONFIG_PROFILE_MAX_RECORDS) {
+		frame->record = profile_record_count++;
+		ProfileRecord *record = &profile_records[frame->record];
+		record->zone = zone;
+		record->start_us = now;
+		record->duration_us = 0;
+		record->bytes = 0;
+		record->depth = profile_depth;
+	} else {
+		profile_records_dropped++;
+	}
+	profile_depth++;
+}
+
+void profile_end(ProfileZone *zone, uint64_t bytes)
+{
+	if (!CONFIG_PROFILE)
+		return;
+
+	if (profile_overflow_depth) {
+		profile_overflow_depth--;
+		return;
+	}
+
+	if (!profile_depth || profile_stack[profile_depth - 1].zone != zone) {
+		printf("Profile zone %s ended out of order.\n", zone->name);
+		return;
+	}
+
+	ProfileFrame *frame = &profile_stack[--profile_depth];
+	uint64_t duration = time_us(0) - frame->start_us;
+
+	if (frame->record >= 0) {
+		ProfileRecord *record = &profile_records[frame->record];
+		record->duration_us = duration;
+		record->bytes = bytes;
+	}
+
+	zone->total_us += duration;
+	zone->bytes += bytes;
+	zone->calls++;
+
+	if (zone->ts_id)
+		zone->last_end_ts = timestamp_now();
+}
+
+void profile_dump(void)
+{
+	if (!CONFIG_PROFILE)
+		return;
+
+	printf("Boot profile (start us, duration us, bytes):\n");
+	for (int i = 0; i < profile_record_count; i++) {
+		ProfileRecord *record = &profile_records[i];
+		printf("profile: %*s%s %" PRIu64 " %" PRIu64 " %" PRIu64 "\n",
+		       record->depth * 2, "", record->zone->name,
+		       record->start_us, record->duration_us, record->bytes);
+	}
+	if (profile_records_dropped)
+		printf("profile: %d records dropped.\n",
+		       profile_records_dropped);
+
+	printf("Profile totals (calls, us, bytes, KB/s):\n");
+	for (ProfileZone *zone = profile_zones; zone; zone = zone->next) {
+		uint64_t rate = 0;
+		if (zone->total_us)
+			rate = zone->bytes * 1000 / 1024 * 1000 /
+			       zone->total_us;
+		printf("profile-total: %s %u %" PRIu64 " %" PRIu64
+		       " %" PRIu64 "\n", zone->name, zone->calls,
+		       zone->total_us, zone->bytes, rate);
+	}
+}
+
+static int profile_dump_on_handoff(DcEvent *event)
+{
+	// Close each timestamped zone with the end of its last pass.
+	for (ProfileZone *zone = profile_zones; zone; zone = zone->next)
+		if (zone->ts_logged && zone->calls)
+			timestamp_add(zone->ts_id + 1, zone->last_end_ts);
+
+	profile_dump();
+	return 0;
+}
+
+static int profile_init(void)
+{
+	static CleanupEvent dump = {
+		.event = { .trigger = &profile_dump_on_handoff },
+		.types = CleanupOnHandoff,
+	};
+
+	if (CONFIG_PROFILE)
+		cleanup_add(&dump);
+	return 0;
+}
+
+INIT_FUNC_TIMESTAMP(profile_init)
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef __BASE_PROFILE_H__
+#define __BASE_PROFILE_H__
+
+#include <stdint.h>
+
+#include "base/timestamp.h"
+
+/*
+ * A lightweight scoped profiler for finding out where boot time goes.
+ *
+ * Code being measured is bracketed with profile_begin() and profile_end() on
+ * a statically allocated ProfileZone. Zones can nest, and every pass through
+ * one is recorded with its start time, duration, nesting depth and a byte
+ * count in a fixed size buffer. Each zone also keeps running totals across
+ * all the passes through it.
+ *
+ * If a zone has a timestamp ID, the start of its first pass and the end of its
+ * last pass are also logged to the coreboot timestamp table as that ID and the
+ * one after it. The table only has room for a fixed number of entries, so
+ * individual passes are kept out of it. Before handing off to the kernel the
+ * recorded profile is printed to the console, which ends up in the CBMEM
+ * console where the OS can read it back.
+ *
+ * Nothing is recorded unless CONFIG_PROFILE is set.
+ */
+
+typedef struct ProfileZone {
+	// A static string describing what the zone measures.
+	const char *name;
+	// If not zero, the timestamp ID to log when the zone first begins.
+	// The end of the last pass is logged as ts_id + 1 at handoff.
+	enum timestamp_id ts_id;
+	uint64_t last_end_ts;
+
+	// Running totals across all passes through the zone.
+	uint64_t total_us;
+	uint64_t bytes;
+	uint32_t calls;
+
+	// Zones are added to a list the first time they're entered.
+	struct ProfileZone *next;
+	int registered;
+	int ts_logged;
+} ProfileZone;
+
+#define PROFILE_ZONE(var, zone_name) \
+	ProfileZone var = { .name = zone_name }
+
+#define PROFILE_ZONE_TS(var, zone_name, id) \
+	ProfileZone var = { .name = zone_name, .ts_id = id }
+
+// Zones shared by the subsystems which usually dominate boot time.
+extern ProfileZone profile_storage;
+extern ProfileZone profile_decompress;
+extern ProfileZone profile_hash;
+extern ProfileZone profile_display;
+extern ProfileZone profile_usb;
+
+/*
+ * Start a pass through a zone.
+ *
+ * @param zone	The zone being entered.
+ */
+void profile_begin(ProfileZone *zone);
+
+/*
+ * Finish a pass through a zone. Zones have to be ended in the reverse of the
+ * order they were begun.
+ *
+ * @param zone	The zone being left, which must be the innermost one.
+ * @param bytes	The amount of data processed during this pass, or 0.
+ */
+void profile_end(ProfileZone *zone, uint64_t bytes);
+
+/*
+ * Print the recorded profile and the per zone totals to the console.
+ */
+void profile_dump(void);
+
+#endif /* __BASE_PROFILE_H__ */
@@ -22,94 +22,120 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "base/physmem.h"
 #include "base/ranges.h"
 #include "base/xalloc.h"
 
 /*
- * This implementation tracks a collection of ranges by keeping a linked list
+ * This implementation tracks a collection of ranges by keeping a sorted array
  * of the edges between ranges in the collection and the space between them.
+ * Edges are found with a binary search, and the whole array is a single
+ * allocation which grows geometrically, so building up a collection from a
+ * large memory map doesn't hit the heap once per edge.
  * New ranges take precedence over older ranges they overlap with.
  */
 
-static void ranges_insert_between(RangesEdge *before, RangesEdge *after,
-				  uint64_t pos)
+enum {
+	RangesInitialCapacity = 16
+};
+
+/*
+ * Returns the index of the first edge past pos, or the first one at or past
+ * pos if inclusive is set.
+ */
+static size_t ranges_search(Ranges *ranges, uint64_t pos, int inclusive)
 {
-	RangesEdge *new_edge = xmalloc(sizeof(*new_edge));
+	size_t low = 0;
+	size_t high = ranges->count;
 
-	assert(before != after);
+	while (low < high) {
+		size_t mid = low + (high - low) / 2;
+		uint64_t edge = ranges->edges[mid];
+
+		if (edge < pos || (!inclusive && edge == pos))
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
 
-	new_edge->next = after;
-	new_edge->pos = pos;
-	before->next = new_edge;
+static void ranges_reserve(Ranges *ranges, size_t count)
+{
+	if (count <= ranges->capacity)
+		return;
+
+	size_t capacity = ranges->capacity ? ranges->capacity :
+					     RangesInitialCapacity;
+	while (capacity < count)
+		capacity *= 2;
+
+	uint64_t *edges = xmalloc(capacity * sizeof(*edges));
+	if (ranges->count)
+		memcpy(edges, ranges->edges, ranges->count * sizeof(*edges));
+	free(ranges->edges);
+	ranges->edges = edges;
+	ranges->capacity = capacity;
 }
 
 void ranges_init(Ranges *ranges)
 {
-	ranges->head.next = NULL;
-	ranges->head.pos = 0;
+	ranges->edges = NULL;
+	ranges->count = 0;
+	ranges->capacity = 0;
 }
 
 void ranges_teardown(Ranges *ranges)
 {
-	RangesEdge *edge = ranges->head.next;
-
-	while (edge) {
-		RangesEdge *next = edge->next;
-		free(edge);
-		edge = next;
-	}
-	ranges->head.next = NULL;
+	free(ranges->edges);
+	ranges_init(ranges);
 }
 
 static void ranges_set_region_to(Ranges *ranges, uint64_t start,
 				 uint64_t end, int new_included)
 {
-	/* whether the current region was originally going to be included. */
-	int included = 0;
-
-	assert(start != end);
-
-	/* prev is never NULL, but cur might be. */
-	RangesEdge *prev = &ranges->head;
-	RangesEdge *cur = prev->next;
+	uint64_t new_edges[2];
+	size_t new_count = 0;
 
 	/*
-	 * Find the start of the new region. After this loop, prev will be
-	 * before the start of the new region, and cur will be after it or
-	 * overlapping start. If they overlap, this ensures that the existing
-	 * edge is deleted and we don't end up with two edges in the same spot.
+	 * A backwards range would put last before first below and make the
+	 * edge move run off the end of the array, so refuse it even when
+	 * asserts are compiled out.
 	 */
-	while (cur && cur->pos < start) {
-		prev = cur;
-		cur = cur->next;
-		included = !included;
-	}
-
-	/* Add the "start" edge between prev and cur, if needed. */
-	if (new_included != included) {
-		ranges_insert_between(prev, cur, start);
-		prev = prev->next;
-	}
+	assert(start < end);
+	if (start >= end)
+		return;
 
 	/*
-	 * Delete any edges obscured by the new region. After this loop, prev
-	 * will be before the end of the new region or overlapping it, and cur
-	 * will be after if, if there is a edge after it. For the same
-	 * reason as above, we want to ensure that we end up with one edge if
-	 * there's an overlap.
+	 * Edges strictly before start are kept, and the number of them tells
+	 * whether start was originally going to be included. An edge exactly
+	 * at start is replaced so we don't end up with two edges in the same
+	 * spot.
 	 */
-	while (cur && cur->pos <= end) {
-		cur = cur->next;
-		free(prev->next);
-		prev->next = cur;
-		included = !included;
-	}
+	size_t first = ranges_search(ranges, start, 1);
+	if ((first & 1) != new_included)
+		new_edges[new_count++] = start;
 
-	/* Add the "end" edge between prev and cur, if needed. */
-	if (included != new_included)
-		ranges_insert_between(prev, cur, end);
+	/*
+	 * Edges up to and including end are obscured by the new region. For
+	 * the same reason as above, we want to ensure that we end up with one
+	 * edge if there's an overlap.
+	 */
+	size_t last = ranges_search(ranges, end, 0);
+	if ((last & 1) != new_included)
+		new_edges[new_count++] = end;
+
+	size_t removed = last - first;
+	if (new_count > removed)
+		ranges_reserve(ranges, ranges->count + new_count - removed);
+
+	memmove(&ranges->edges[first + new_count], &ranges->edges[last],
+		(ranges->count - last) * sizeof(*ranges->edges));
+	memcpy(&ranges->edges[first], new_edges,
+	       new_count * sizeof(*ranges->edges));
+	ranges->count = ranges->count + new_count - removed;
 }
 
 /* Add a range to a collection of ranges. */
@@ -127,12 +153,11 @@ void ranges_sub(Ranges *ranges, uint64_t start, uint64_t end)
 /* Run a function on each range in Ranges. */
 void ranges_for_each(Ranges *ranges, RangesForEachFunc func, void *data)
 {
-	for (RangesEdge *cur = ranges->head.next; cur; cur = cur->next->next) {
-		if (!cur->next) {
-			printf("Odd number of range edges!\n");
-			return;
-		}
-
-		func(cur->pos, cur->next->pos, data);
+	if (ranges->count & 1) {
+		printf("Odd number of range edges!\n");
+		return;
 	}
+
+	for (size_t i = 0; i < ranges->count; i += 2)
+		func(ranges->edges[i], ranges->edges[i + 1], data);
 }
@@ -23,20 +23,18 @@
 #ifndef __BASE_RANGES_H__
 #define __BASE_RANGES_H__
 
+#include <stddef.h>
 #include <stdint.h>
 
-/* A node in a linked list of edges, each at position "pos". */
-typedef struct RangesEdge {
-	struct RangesEdge *next;
-	uint64_t pos;
-} RangesEdge;
-
 /*
- * Data describing ranges. Contains a linked list of edges between the ranges
- * and the empty space between them.
+ * Data describing ranges. Contains a sorted array of the positions of the
+ * edges between the ranges and the empty space between them. Even entries
+ * start a range and odd entries end one.
  */
 typedef struct Ranges {
-	RangesEdge head;
+	uint64_t *edges;
+	size_t count;
+	size_t capacity;
 } Ranges;
 
 /*
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <arch/barrier.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "base/die.h"
+#include "base/task.h"
+#include "base/time.h"
+
+// Pending tasks sorted by wake time, earliest first.
+static ListNode task_queue;
+static uint32_t task_pass;
+static int task_running;
+
+static void task_enqueue(DcTask *task)
+{
+	ListNode *after = &task_queue;
+	while (after->next) {
+		DcTask *next = container_of(after->next, DcTask, list_node);
+		if ((int64_t)(next->wake - task->wake) > 0)
+			break;
+		after = after->next;
+	}
+	list_insert_after(&task->list_node, after);
+}
+
+void task_start(DcTask *task)
+{
+	die_if(task->pending, "Task %s is already running.\n", task->name);
+	task->wake = time_deadline_us(0);
+	task->pending = 1;
+	task->pass = task_pass;
+	task_enqueue(task);
+}
+
+void task_sleep_us(DcTask *task, uint64_t us)
+{
+	task->wake = time_deadline_us(us);
+}
+
+void task_sleep_ms(DcTask *task, uint64_t ms)
+{
+	task->wake = time_deadline_ms(ms);
+}
+
+void task_yield(void)
+{
+	// Steps which end up yielding don't get to run other tasks.
+	if (task_running)
+		return;
+	task_running = 1;
+	task_pass++;
+
+	ListNode *node = task_queue.next;
+	while (node) {
+		DcTask *task = container_of(node, DcTask, list_node);
+		// The queue is sorted, so nothing after this is due either.
+		if (!time_deadline_expired(task->wake))
+			break;
+		if (task->pass == task_pass) {
+			node = node->next;
+			continue;
+		}
+
+		list_remove(&task->list_node);
+		task->pass = task_pass;
+		uint64_t wake = task->wake;
+		if (task->step(task) == TaskDone) {
+			task->pending = 0;
+		} else {
+			// A step which didn't sleep is due again right away.
+			if (task->wake == wake)
+				task->wake = time_deadline_us(0);
+			task_enqueue(task);
+		}
+		// Stepping may have reordered the queue, so start over.
+		node = task_queue.next;
+	}
+
+	task_running = 0;
+}
+
+void task_wait(DcTask *task)
+{
+	die_if(task_running && task->pending,
+	       "Can't wait for task %s from another task.\n", task->name);
+	while (task->pending)
+		task_yield();
+}
+
+int task_wait_all(uint64_t timeout_ms)
+{
+	die_if(task_running && task_queue.next,
+	       "Can't wait for tasks from another task.\n");
+
+	uint64_t deadline = time_deadline_ms(timeout_ms);
+	while (task_queue.next && !time_deadline_expired(deadline))
+		task_yield();
+
+	int pending = 0;
+	DcTask *task;
+	list_for_each(task, task_queue, list_node) {
+		printf("Task %s didn't finish in %" PRIu64 " ms.\n",
+		       task->name, timeout_ms);
+		pending++;
+	}
+	return pending;
+}
+
+void task_mdelay(uint64_t ms)
+{
+	uint64_t deadline = time_deadline_ms(ms);
+	while (!time_deadline_expired(deadline)) {
+		task_yield();
+		cpu_relax();
+	}
+}
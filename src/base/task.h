@@ -0,0 +1,93 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef __BASE_TASK_H__
+#define __BASE_TASK_H__
+
+#include <stdint.h>
+
+#include "base/list.h"
+
+/*
+ * A small cooperative scheduler for overlapping slow hardware bring-up with
+ * the rest of boot.
+ *
+ * A task is a step function with a deadline. Each step should do a bounded
+ * amount of work, like starting a reset or checking a status bit, and then
+ * return TaskDone if the task is finished or TaskPending to be called again.
+ * A pending step can push its deadline back with task_sleep_us() or
+ * task_sleep_ms() first. Tasks don't get stacks of their own, so whatever
+ * state they need lives in the structure they embed their DcTask in.
+ *
+ * Steps run only when something yields. task_yield() steps every task whose
+ * deadline has passed, task_wait() keeps yielding until a particular task
+ * is done and task_mdelay() yields for as long as it's asked to wait. Init
+ * functions yield between each other and the vboot sleep callback yields
+ * while it waits. Before cleanup events are triggered, pending tasks get a
+ * bounded amount of time to finish so little is left running at handoff.
+ * Tasks which are stuck, say polling a device which never answers, are
+ * reported and then abandoned rather than holding up the kernel.
+ *
+ * Steps must not yield or wait themselves.
+ */
+
+typedef enum {
+	TaskDone = 0,
+	TaskPending = 1,
+} TaskStatus;
+
+typedef struct DcTask {
+	TaskStatus (*step)(struct DcTask *me);
+	// A static string for messages about the task.
+	const char *name;
+
+	// Raw timer value before which step won't be called again.
+	uint64_t wake;
+	// Set from task_start() until a step returns TaskDone.
+	int pending;
+	// The task_yield() pass this task last ran in.
+	uint32_t pass;
+
+	ListNode list_node;
+} DcTask;
+
+// Queue a task and make it due right away.
+void task_start(DcTask *task);
+
+// From a step, don't run the task again for at least this long.
+void task_sleep_us(DcTask *task, uint64_t us);
+void task_sleep_ms(DcTask *task, uint64_t ms);
+
+// Run each task whose deadline has passed once.
+void task_yield(void);
+
+// Run tasks until the given one has finished.
+void task_wait(DcTask *task);
+
+// Run tasks until every one has finished or timeout_ms has passed. Returns
+// the number of tasks still pending, after printing their names.
+int task_wait_all(uint64_t timeout_ms);
+
+// Like mdelay(), but run tasks while waiting.
+void task_mdelay(uint64_t ms);
+
+#endif /* __BASE_TASK_H__ */
@@ -25,6 +25,7 @@
  * SUCH DAMAGE.
  */
 
+#include <arch/barrier.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -32,10 +33,109 @@
 #include "base/time.h"
 #include "drivers/timer/timer.h"
 
+/*
+ * Conversions between timer ticks and units of time are done as a multiply
+ * by a fixed point factor and a shift, which are worked out once from the
+ * timer frequency. That keeps divides out of delay and polling loops, and
+ * because the product is computed at 128 bit precision it can't overflow
+ * the way multiplying the raw tick count by a million up front does.
+ */
+typedef struct {
+	uint64_t mult;
+	int shift;
+} TimeScale;
+
+static uint64_t hz;
+// The raw timer value wraps at this mask, which may be less than 64 bits.
+static uint64_t raw_mask;
+static TimeScale ticks_to_us;
+static TimeScale us_to_ticks;
+static TimeScale ns_to_ticks;
+static TimeScale ms_to_ticks;
+
+// Returns (a * b) >> shift, keeping all 128 bits of the intermediate product.
+static uint64_t time_mul_shift(uint64_t a, uint64_t b, int shift)
+{
+	uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+	uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+
+	uint64_t lo = a_lo * b_lo;
+	uint64_t mid1 = a_hi * b_lo;
+	uint64_t mid2 = a_lo * b_hi;
+	uint64_t hi = a_hi * b_hi;
+
+	uint64_t mid = (lo >> 32) + (uint32_t)mid1 + (uint32_t)mid2;
+	lo = (uint32_t)lo | (mid << 32);
+	hi += (mid1 >> 32) + (mid2 >> 32) + (mid >> 32);
+
+	if (!shift)
+		return lo;
+	return (hi << (64 - shift)) | (lo >> shift);
+}
+
+// Set up a scale which converts a count at rate "from" to rate "to". The
+// factor is worked out by long division one bit at a time until it has as
+// many significant bits as will fit, then rounded to nearest.
+static void time_scale_init(TimeScale *scale, uint64_t from, uint64_t to)
+{
+	uint64_t mult = to / from;
+	uint64_t rem = to % from;
+	int shift = 0;
+
+	while (shift < 63 && !(mult >> 62)) {
+		rem <<= 1;
+		mult <<= 1;
+		if (rem >= from) {
+			rem -= from;
+			mult |= 1;
+		}
+		shift++;
+	}
+	if (rem >= from - rem)
+		mult++;
+
+	scale->mult = mult;
+	scale->shift = shift;
+}
+
+static inline uint64_t time_scale(const TimeScale *scale, uint64_t value)
+{
+	return time_mul_shift(value, scale->mult, scale->shift);
+}
+
+/**
+ * Return the timer frequency, which is only looked up once.
+ */
+uint64_t time_hz(void)
+{
+	if (hz)
+		return hz;
+
+	// Assume the frequency doesn't change.
+	uint64_t new_hz = timer_hz();
+	if (new_hz < 1000000) {
+		printf("Timer frequency %"PRId64" is too low, "
+		       "must be at least 1MHz.\n", new_hz);
+		halt();
+	}
+
+	time_scale_init(&ticks_to_us, new_hz, 1000000);
+	time_scale_init(&us_to_ticks, 1000000, new_hz);
+	time_scale_init(&ns_to_ticks, 1000000000, new_hz);
+	time_scale_init(&ms_to_ticks, 1000, new_hz);
+
+	int bits = timer_raw_bits();
+	raw_mask = bits < 64 ? (1ULL << bits) - 1 : ~0ULL;
+	hz = new_hz;
+
+	return hz;
+}
+
 static inline void _delay(uint64_t delta)
 {
 	uint64_t start = timer_raw_value();
-	while (timer_raw_value() - start < delta) ;
+	while (((timer_raw_value() - start) & raw_mask) < delta)
+		cpu_relax();
 }
 
 /**
@@ -45,7 +145,8 @@ static inline void _delay(uint64_t delta)
  */
 void ndelay(uint64_t n)
 {
-	_delay(n * timer_hz() / 1000000000);
+	time_hz();
+	_delay(time_scale(&ns_to_ticks, n));
 }
 
 /**
@@ -55,7 +156,8 @@ void ndelay(uint64_t n)
  */
 void udelay(uint64_t u)
 {
-	_delay(u * timer_hz() / 1000000);
+	time_hz();
+	_delay(time_scale(&us_to_ticks, u));
 }
 
 /**
@@ -65,7 +167,8 @@ void udelay(uint64_t u)
  */
 void mdelay(uint64_t m)
 {
-	_delay(m * timer_hz() / 1000);
+	time_hz();
+	_delay(time_scale(&ms_to_ticks, m));
 }
 
 /**
@@ -75,22 +178,49 @@ void mdelay(uint64_t m)
  */
 void delay(uint64_t s)
 {
-	_delay(s * timer_hz());
+	_delay(s * time_hz());
 }
 
 uint64_t time_us(uint64_t base)
 {
-	static uint64_t hz;
-
-	// Only check timer_hz once. Assume it doesn't change.
-	if (hz == 0) {
-		hz = timer_hz();
-		if (hz < 1000000) {
-			printf("Timer frequency %"PRId64" is too low, "
-			       "must be at least 1MHz.\n", hz);
-			halt();
-		}
-	}
+	time_hz();
+	return time_scale(&ticks_to_us, timer_raw_value()) - base;
+}
+
+/**
+ * Work out the raw timer value a polling loop should give up at.
+ *
+ * @param u Number of microseconds from now.
+ */
+uint64_t time_deadline_us(uint64_t u)
+{
+	time_hz();
+	return (timer_raw_value() + time_scale(&us_to_ticks, u)) & raw_mask;
+}
+
+/**
+ * Work out the raw timer value a polling loop should give up at.
+ *
+ * @param m Number of milliseconds from now.
+ */
+uint64_t time_deadline_ms(uint64_t m)
+{
+	time_hz();
+	return (timer_raw_value() + time_scale(&ms_to_ticks, m)) & raw_mask;
+}
 
-	return (1000000 * timer_raw_value()) / hz - base;
+/**
+ * Check whether a deadline from time_deadline_us/ms has passed. This only
+ * reads the timer, and copes with the raw value wrapping around at whatever
+ * width the timer has, as long as the deadline is less than half the
+ * counter's range away.
+ *
+ * @param deadline The deadline to check.
+ */
+int time_deadline_expired(uint64_t deadline)
+{
+	time_hz();
+	uint64_t past = (timer_raw_value() - deadline) & raw_mask;
+	// A "negative" difference at the counter's width means it's not due.
+	return !(past & (raw_mask ^ (raw_mask >> 1)));
 }
@@ -31,5 +31,10 @@ void mdelay(uint64_t m);
 void delay(uint64_t s);
 
 uint64_t time_us(uint64_t base);
+uint64_t time_hz(void);
+
+uint64_t time_deadline_us(uint64_t u);
+uint64_t time_deadline_ms(uint64_t m);
+int time_deadline_expired(uint64_t deadline);
 
 #endif /* __BASE_TIME_H__ */
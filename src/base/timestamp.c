@@ -58,10 +58,15 @@ void timestamp_add(enum timestamp_id id, uint64_t ts_time)
 	tse->entry_stamp = ts_time - ts_table->base_time;
 }
 
-void timestamp_add_now(enum timestamp_id id)
+uint64_t timestamp_now(void)
 {
 	if (CONFIG_TIMESTAMP_RAW)
-		timestamp_add(id, timer_raw_value());
+		return timer_raw_value();
 	else
-		timestamp_add(id, time_us(0));
+		return time_us(0);
+}
+
+void timestamp_add_now(enum timestamp_id id)
+{
+	timestamp_add(id, timestamp_now());
 }
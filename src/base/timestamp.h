@@ -35,11 +35,33 @@ enum timestamp_id {
 
 	TS_VB_EC_VBOOT_DONE = 1030,
 
+	// Background bring-up of fixed storage, and how long vboot waited.
+	TS_STORAGE_PREWARM_START = 1040,
+	TS_STORAGE_PREWARM_DONE = 1041,
+	TS_STORAGE_PREWARM_WAIT = 1042,
+	TS_STORAGE_PREWARM_WAIT_DONE = 1043,
+
+	// Handing off from one depthcharge module to the next. The next
+	// module's TS_START marks the end of the trampoline.
+	TS_MODULE_LOAD_START = 1050,
+	TS_MODULE_READ_DONE = 1051,
+	TS_MODULE_STAGED = 1052,
+
 	TS_CROSSYSTEM_DATA = 1100,
-	TS_START_KERNEL = 1101
+	TS_START_KERNEL = 1101,
+
+	// Profiler zones, logged as the start of the first pass followed by
+	// start + 1 for the end of the last one.
+	TS_PROFILE_STORAGE = 1200,
+	TS_PROFILE_DECOMPRESS = 1202,
+	TS_PROFILE_HASH = 1204,
+	TS_PROFILE_DISPLAY = 1206,
+	TS_PROFILE_USB = 1208
 };
 
 void timestamp_add(enum timestamp_id id, uint64_t ts_time);
 void timestamp_add_now(enum timestamp_id id);
+// The current time in the units timestamp_add() expects.
+uint64_t timestamp_now(void);
 
 #endif /* __BASE_TIMESTAMP_H__ */
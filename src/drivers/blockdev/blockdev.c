@@ -20,6 +20,9 @@
  * MA 02111-1307 USA
  */
 
+#include "base/container_of.h"
+#include "base/init_funcs.h"
+#include "base/timestamp.h"
 #include "drivers/blockdev/blockdev.h"
 
 ListNode fixed_block_devices;
@@ -27,3 +30,47 @@ ListNode removable_block_devices;
 
 ListNode fixed_block_dev_controllers;
 ListNode removable_block_dev_controllers;
+
+static int prewarm_pending;
+
+static TaskStatus block_dev_prewarm_step(DcTask *task)
+{
+	BlockDevCtrlr *ctrlr = container_of(task, BlockDevCtrlr, prewarm);
+
+	if (ctrlr->ops.update_step(&ctrlr->ops, task) == TaskPending)
+		return TaskPending;
+
+	if (!--prewarm_pending)
+		timestamp_add_now(TS_STORAGE_PREWARM_DONE);
+	return TaskDone;
+}
+
+static int block_dev_prewarm(void)
+{
+	BlockDevCtrlr *ctrlr;
+	list_for_each(ctrlr, fixed_block_dev_controllers, list_node) {
+		if (!ctrlr->ops.update_step || !ctrlr->need_update)
+			continue;
+
+		if (!prewarm_pending++)
+			timestamp_add_now(TS_STORAGE_PREWARM_START);
+		ctrlr->prewarm.step = &block_dev_prewarm_step;
+		ctrlr->prewarm.name = "storage prewarm";
+		task_start(&ctrlr->prewarm);
+	}
+	return 0;
+}
+
+INIT_FUNC_STORAGE(block_dev_prewarm);
+
+void block_dev_wait_prewarm(ListNode *ctrlrs)
+{
+	if (!prewarm_pending)
+		return;
+
+	timestamp_add_now(TS_STORAGE_PREWARM_WAIT);
+	BlockDevCtrlr *ctrlr;
+	list_for_each(ctrlr, *ctrlrs, list_node)
+		task_wait(&ctrlr->prewarm);
+	timestamp_add_now(TS_STORAGE_PREWARM_WAIT_DONE);
+}
@@ -26,6 +26,7 @@
 #include <stdint.h>
 
 #include "base/list.h"
+#include "base/task.h"
 
 typedef uint64_t lba_t;
 
@@ -53,16 +54,29 @@ extern ListNode removable_block_devices;
 
 typedef struct BlockDevCtrlrOps {
 	int (*update)(struct BlockDevCtrlrOps *me);
+	/*
+	 * Optional. Does one bounded step of bringing a fixed controller up
+	 * and returns TaskPending until it's done, sleeping task in between
+	 * if it likes. This lets the controller get ready in the background
+	 * long before vboot asks for disks. If need_update is still set
+	 * afterwards, update() is called as usual.
+	 */
+	TaskStatus (*update_step)(struct BlockDevCtrlrOps *me, DcTask *task);
 } BlockDevCtrlrOps;
 
 typedef struct BlockDevCtrlr {
 	BlockDevCtrlrOps ops;
 
 	int need_update;
+	// Runs update_step in the background.
+	DcTask prewarm;
 	ListNode list_node;
 } BlockDevCtrlr;
 
 extern ListNode fixed_block_dev_controllers;
 extern ListNode removable_block_dev_controllers;
 
+// Wait for any background bring-up of the controllers in ctrlrs to finish.
+void block_dev_wait_prewarm(ListNode *ctrlrs);
+
 #endif /* __DRIVERS_BLOCKDEV_BLOCKDEV_H__ */
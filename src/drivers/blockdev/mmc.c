@@ -49,12 +49,12 @@ int mmc_busy_wait_io(volatile uint32_t *address, uint32_t *output,
 		     uint32_t io_mask, uint32_t timeout_ms)
 {
 	uint32_t value = (uint32_t)-1;
-	uint64_t start = time_us(0);
+	uint64_t deadline = time_deadline_ms(timeout_ms);
 
 	if (!output)
 		output = &value;
 	for (; *output & io_mask; *output = read32(address)) {
-		if (time_us(start) > timeout_ms * 1000)
+		if (time_deadline_expired(deadline))
 			return -1;
 	}
 	return 0;
@@ -64,12 +64,12 @@ int mmc_busy_wait_io_until(volatile uint32_t *address, uint32_t *output,
 			   uint32_t io_mask, uint32_t timeout_ms)
 {
 	uint32_t value = 0;
-	uint64_t start = time_us(0);
+	uint64_t deadline = time_deadline_ms(timeout_ms);
 
 	if (!output)
 		output = &value;
 	for (; !(*output & io_mask); *output = read32(address)) {
-		if (time_us(start) > timeout_ms * 1000)
+		if (time_deadline_expired(deadline))
 			return -1;
 	}
 	return 0;
@@ -410,29 +410,25 @@ static int mmc_send_op_cond(MmcMedia *media)
 	return MMC_IN_PROGRESS;
 }
 
-static int mmc_complete_op_cond(MmcMedia *media)
+/*
+ * Polls the card once to see whether it finished powering up. Returns
+ * MMC_IN_PROGRESS while it's still busy and hasn't run out of time.
+ */
+static int mmc_poll_op_cond(MmcMedia *media)
 {
 	MmcCommand cmd;
 
-	int timeout = MMC_INIT_TIMEOUT_US;
-	uint64_t start;
-
-	start = time_us(0);
-	while (1) {
-		// CMD1 queries whether initialization is done.
-		int err = mmc_send_op_cond_iter(media, &cmd, 1);
-		if (err)
-			return err;
-
-		// OCR_BUSY means "initialization complete".
-		if (media->op_cond_response & OCR_BUSY)
-			break;
+	// CMD1 queries whether initialization is done.
+	int err = mmc_send_op_cond_iter(media, &cmd, 1);
+	if (err)
+		return err;
 
+	// OCR_BUSY means "initialization complete".
+	if (!(media->op_cond_response & OCR_BUSY)) {
 		// Check if init timeout has expired.
-		if (time_us(start) > timeout)
+		if (time_deadline_expired(media->ctrlr->setup_deadline))
 			return MMC_UNUSABLE_ERR;
-
-		udelay(100);
+		return MMC_IN_PROGRESS;
 	}
 
 	media->version = MMC_VERSION_UNKNOWN;
@@ -985,7 +981,19 @@ static int mmc_send_if_cond(MmcMedia *media)
 	return 0;
 }
 
-int mmc_setup_media(MmcCtrlr *ctrlr)
+static int mmc_finish_setup(MmcMedia *media)
+{
+	int err = mmc_startup(media);
+	if (!err) {
+		media->ctrlr->media = media;
+		return 0;
+	}
+
+	free(media);
+	return err;
+}
+
+int mmc_setup_media_start(MmcCtrlr *ctrlr)
 {
 	int err;
 
@@ -1024,18 +1032,41 @@ int mmc_setup_media(MmcCtrlr *ctrlr)
 		return err;
 	}
 
+	if (err == MMC_IN_PROGRESS) {
+		/* The card is still powering up. Leave that to the polls. */
+		ctrlr->setup_media = media;
+		ctrlr->setup_deadline = time_deadline_us(MMC_INIT_TIMEOUT_US);
+		return MMC_IN_PROGRESS;
+	}
+
+	return mmc_finish_setup(media);
+}
+
+int mmc_setup_media_poll(MmcCtrlr *ctrlr)
+{
+	MmcMedia *media = ctrlr->setup_media;
+
+	int err = mmc_poll_op_cond(media);
 	if (err == MMC_IN_PROGRESS)
-		err = mmc_complete_op_cond(media);
+		return err;
 
-	if (!err) {
-		err = mmc_startup(media);
-		if (!err) {
-			ctrlr->media = media;
-			return 0;
-		}
+	ctrlr->setup_media = NULL;
+	if (err) {
+		free(media);
+		return err;
 	}
+	return mmc_finish_setup(media);
+}
 
-	free(media);
+int mmc_setup_media(MmcCtrlr *ctrlr)
+{
+	int err = mmc_setup_media_start(ctrlr);
+
+	while (err == MMC_IN_PROGRESS) {
+		err = mmc_setup_media_poll(ctrlr);
+		if (err == MMC_IN_PROGRESS)
+			udelay(100);
+	}
 	return err;
 }
 
@@ -258,6 +258,11 @@ typedef struct MmcCtrlr {
 	 */
 	uint32_t hardcoded_voltage;
 
+	/* Media still powering up between setup start and poll calls. */
+	MmcMedia *setup_media;
+	/* Raw timer value at which setup_media gives up powering up. */
+	uint64_t setup_deadline;
+
 	int (*send_cmd)(struct MmcCtrlr *me, MmcCommand *cmd, MmcData *data);
 	void (*set_ios)(struct MmcCtrlr *me);
 } MmcCtrlr;
@@ -290,6 +295,14 @@ int mmc_busy_wait_io_until(volatile uint32_t *address, uint32_t *output,
 			   uint32_t io_mask, uint32_t timeout_ms);
 
 int mmc_setup_media(MmcCtrlr *ctrlr);
+/*
+ * mmc_setup_media() split in two so a card can power up in the background.
+ * mmc_setup_media_start() resets the card and asks it to power up. While it
+ * returns MMC_IN_PROGRESS, mmc_setup_media_poll() should be called from time
+ * to time until it returns something else.
+ */
+int mmc_setup_media_start(MmcCtrlr *ctrlr);
+int mmc_setup_media_poll(MmcCtrlr *ctrlr);
 
 lba_t block_mmc_read(BlockDevOps *me, lba_t start, lba_t count, void *buffer);
 lba_t block_mmc_write(BlockDevOps *me, lba_t start, lba_t count,
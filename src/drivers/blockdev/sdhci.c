@@ -679,6 +679,18 @@ static int sdhci_init(SdhciHost *host)
 	return 0;
 }
 
+static void sdhci_add_fixed_media(SdhciHost *host)
+{
+	MmcMedia *media = host->mmc_ctrlr.media;
+
+	media->dev.name = "SDHCI fixed";
+	media->dev.removable = host->removable;
+	media->dev.ops.read = block_mmc_read;
+	media->dev.ops.write = block_mmc_write;
+	list_insert_after(&media->dev.list_node, &fixed_block_devices);
+	host->mmc_ctrlr.ctrlr.need_update = 0;
+}
+
 static int sdhci_update(BlockDevCtrlrOps *me)
 {
 	SdhciHost *host = container_of
@@ -724,10 +736,8 @@ static int sdhci_update(BlockDevCtrlrOps *me)
 
 		if (mmc_setup_media(&host->mmc_ctrlr))
 			return -1;
-		host->mmc_ctrlr.media->dev.name = "SDHCI fixed";
-		list_insert_after(&host->mmc_ctrlr.media->dev.list_node,
-				  &fixed_block_devices);
-		host->mmc_ctrlr.ctrlr.need_update = 0;
+		sdhci_add_fixed_media(host);
+		return 0;
 	}
 
 	host->mmc_ctrlr.media->dev.removable = host->removable;
@@ -737,12 +747,46 @@ static int sdhci_update(BlockDevCtrlrOps *me)
 	return 0;
 }
 
+static TaskStatus sdhci_update_step(BlockDevCtrlrOps *me, DcTask *task)
+{
+	SdhciHost *host = container_of
+		(me, SdhciHost, mmc_ctrlr.ctrlr.ops);
+	int err;
+
+	/* Removable cards come and go, so they're left to sdhci_update. */
+	if (host->removable)
+		return TaskDone;
+
+	if (!host->mmc_ctrlr.setup_media) {
+		if (!host->initialized && sdhci_init(host))
+			return TaskDone;
+
+		host->initialized = 1;
+
+		err = mmc_setup_media_start(&host->mmc_ctrlr);
+	} else {
+		err = mmc_setup_media_poll(&host->mmc_ctrlr);
+	}
+
+	if (err == MMC_IN_PROGRESS) {
+		/* eMMC power up takes tens of ms, no need to poll any faster */
+		task_sleep_ms(task, 1);
+		return TaskPending;
+	}
+
+	/* On failure sdhci_update starts over when vboot asks for disks. */
+	if (!err)
+		sdhci_add_fixed_media(host);
+	return TaskDone;
+}
+
 void add_sdhci(SdhciHost *host)
 {
 	host->mmc_ctrlr.send_cmd = &sdhci_send_command;
 	host->mmc_ctrlr.set_ios = &sdhci_set_ios;
 
 	host->mmc_ctrlr.ctrlr.ops.update = &sdhci_update;
+	host->mmc_ctrlr.ctrlr.ops.update_step = &sdhci_update_step;
 	host->mmc_ctrlr.ctrlr.need_update = 1;
 
 	/* TODO(vbendeb): check if SDHCI spec allows to retrieve this value. */
@@ -30,9 +30,97 @@
 #include "base/container_of.h"
 #include "drivers/blockdev/uefi.h"
 #include "uefi/edk/Protocol/BlockIo.h"
+#include "uefi/edk/Protocol/BlockIo2.h"
 #include "uefi/uefi.h"
 
+// Reads smaller than this per piece aren't worth splitting up.
+#define UEFI_BLOCKDEV_MIN_REQUEST (256 * 1024)
+
 static EFI_GUID block_io_protocol_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
+static EFI_GUID block_io2_protocol_guid = EFI_BLOCK_IO2_PROTOCOL_GUID;
+
+// The firmware can transfer straight to or from buffer.
+static int uefi_blockdev_aligned(UefiBlockDev *ubdev, const void *buffer)
+{
+	return ubdev->io_align <= 1 ||
+		!((uintptr_t)buffer % ubdev->io_align);
+}
+
+static int uefi_blockdev_get_events(UefiBlockDev *ubdev,
+				    EFI_BOOT_SERVICES *bs)
+{
+	for (int i = 0; i < ARRAY_SIZE(ubdev->events); i++) {
+		if (ubdev->events[i])
+			continue;
+		EFI_STATUS status = bs->CreateEvent(
+			0, TPL_CALLBACK, NULL, NULL, &ubdev->events[i]);
+		if (status != EFI_SUCCESS) {
+			ubdev->events[i] = NULL;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Split a large read into a few pieces and queue them all with
+ * EFI_BLOCK_IO2, so the firmware driver can keep the device busy with more
+ * than one request at a time. Returns 0 on success, 1 if the read should be
+ * done some other way, or -1 on a device error.
+ */
+static int uefi_blockdev_read_async(UefiBlockDev *ubdev, lba_t start,
+				    lba_t count, void *buffer)
+{
+	const size_t block_size = ubdev->dev.block_size;
+	EFI_BLOCK_IO2_TOKEN tokens[UEFI_BLOCKDEV_REQUESTS];
+	lba_t piece_blocks;
+	int pieces, queued, i;
+	int ret = 0;
+
+	pieces = MIN((uint64_t)UEFI_BLOCKDEV_REQUESTS,
+		     count * block_size / UEFI_BLOCKDEV_MIN_REQUEST);
+	if (pieces < 2)
+		return 1;
+
+	EFI_SYSTEM_TABLE *st = uefi_system_table_ptr();
+	if (!st || uefi_blockdev_get_events(ubdev, st->BootServices))
+		return 1;
+	EFI_BOOT_SERVICES *bs = st->BootServices;
+
+	piece_blocks = (count + pieces - 1) / pieces;
+	for (queued = 0; queued < pieces && count; queued++) {
+		lba_t blocks = MIN(piece_blocks, count);
+
+		tokens[queued].Event = ubdev->events[queued];
+		tokens[queued].TransactionStatus = EFI_SUCCESS;
+		EFI_STATUS status = ubdev->bio2->ReadBlocksEx(
+			ubdev->bio2, ubdev->media_id, start, &tokens[queued],
+			blocks * block_size, buffer);
+		if (status != EFI_SUCCESS) {
+			printf("Failed to queue read from UEFI device.\n");
+			ret = -1;
+			break;
+		}
+
+		buffer = (uint8_t *)buffer + blocks * block_size;
+		start += blocks;
+		count -= blocks;
+	}
+
+	// Whatever was queued has to finish before buffer can be given back.
+	for (i = 0; i < queued; i++) {
+		UINTN index;
+		EFI_STATUS status = bs->WaitForEvent(1, &tokens[i].Event,
+						     &index);
+		if (status != EFI_SUCCESS ||
+		    tokens[i].TransactionStatus != EFI_SUCCESS) {
+			printf("Failed to read blocks from UEFI device.\n");
+			ret = -1;
+		}
+	}
+
+	return ret;
+}
 
 static lba_t uefi_blockdev_read(BlockDevOps *me, lba_t start, lba_t count,
 				void *buffer)
@@ -40,6 +128,28 @@ static lba_t uefi_blockdev_read(BlockDevOps *me, lba_t start, lba_t count,
 	UefiBlockDev *ubdev = container_of(me, UefiBlockDev, dev.ops);
 
 	const size_t block_size = ubdev->dev.block_size;
+
+	// Read directly into buffer if the firmware can, all in one go.
+	if (uefi_blockdev_aligned(ubdev, buffer)) {
+		if (ubdev->bio2) {
+			int ret = uefi_blockdev_read_async(ubdev, start, count,
+							   buffer);
+			if (ret == 0)
+				return count;
+			if (ret < 0)
+				return 0;
+		}
+
+		EFI_STATUS status = ubdev->bio->ReadBlocks(
+			ubdev->bio, ubdev->media_id, start,
+			block_size * count, buffer);
+		if (status != EFI_SUCCESS) {
+			printf("Failed to read blocks from UEFI device.\n");
+			return 0;
+		}
+		return count;
+	}
+
 	size_t buffer_size = block_size * count;
 	size_t chunk_size = MIN(64 * 1024, buffer_size);
 	// Round chunk_size up to the nearest multiple of block_size;
@@ -77,12 +187,38 @@ static lba_t uefi_blockdev_read(BlockDevOps *me, lba_t start, lba_t count,
 	return count;
 }
 
+static int uefi_blockdev_flush(UefiBlockDev *ubdev)
+{
+	if (!ubdev->write_caching)
+		return 0;
+
+	EFI_STATUS status = ubdev->bio->FlushBlocks(ubdev->bio);
+	if (status != EFI_SUCCESS) {
+		printf("Failed to flush blocks to UEFI device.\n");
+		return 1;
+	}
+	return 0;
+}
+
 static lba_t uefi_blockdev_write(BlockDevOps *me, lba_t start, lba_t count,
 				 const void *buffer)
 {
 	UefiBlockDev *ubdev = container_of(me, UefiBlockDev, dev.ops);
 
 	const size_t block_size = ubdev->dev.block_size;
+
+	// Write directly from buffer if the firmware can, all in one go.
+	if (uefi_blockdev_aligned(ubdev, buffer)) {
+		EFI_STATUS status = ubdev->bio->WriteBlocks(
+			ubdev->bio, ubdev->media_id, start,
+			block_size * count, (void *)buffer);
+		if (status != EFI_SUCCESS) {
+			printf("Failed to write blocks to UEFI device.\n");
+			return 0;
+		}
+		return uefi_blockdev_flush(ubdev) ? 0 : count;
+	}
+
 	size_t buffer_size = block_size * count;
 	size_t chunk_size = MIN(64 * 1024, buffer_size);
 	// Round chunk_size up to the nearest multiple of block_size;
@@ -117,15 +253,20 @@ static lba_t uefi_blockdev_write(BlockDevOps *me, lba_t start, lba_t count,
 
 	free(write_buf);
 
-	if (ubdev->write_caching) {
-		EFI_STATUS status = ubdev->bio->FlushBlocks(ubdev->bio);
-		if (status != EFI_SUCCESS) {
-			printf("Failed to flush blocks to UEFI device.\n");
-			return 0;
-		}
-	}
+	return uefi_blockdev_flush(ubdev) ? 0 : count;
+}
 
-	return count;
+static void uefi_blockdev_free(UefiBlockDev *ubdev)
+{
+	EFI_SYSTEM_TABLE *st = uefi_system_table_ptr();
+
+	list_remove(&ubdev->uefi_blockdev_list);
+	list_remove(&ubdev->dev.list_node);
+	for (int i = 0; i < ARRAY_SIZE(ubdev->events); i++) {
+		if (st && ubdev->events[i])
+			st->BootServices->CloseEvent(ubdev->events[i]);
+	}
+	free(ubdev);
 }
 
 static int uefi_blockdev_ctrlr_update(struct BlockDevCtrlrOps *me)
@@ -138,16 +279,12 @@ static int uefi_blockdev_ctrlr_update(struct BlockDevCtrlrOps *me)
 	UefiBlockDev *ubdev;
 	UefiBlockDev *last_ubdev = NULL;
 	list_for_each(ubdev, ctrlr->uefi_blockdev_list, uefi_blockdev_list) {
-		list_remove(&last_ubdev->uefi_blockdev_list);
-		list_remove(&last_ubdev->dev.list_node);
-		free(last_ubdev);
+		if (last_ubdev)
+			uefi_blockdev_free(last_ubdev);
 		last_ubdev = ubdev;
 	}
-	if (last_ubdev) {
-		list_remove(&last_ubdev->uefi_blockdev_list);
-		list_remove(&last_ubdev->dev.list_node);
-		free(last_ubdev);
-	}
+	if (last_ubdev)
+		uefi_blockdev_free(last_ubdev);
 
 	EFI_SYSTEM_TABLE *st = uefi_system_table_ptr();
 	if (!st)
@@ -196,6 +333,9 @@ static int uefi_blockdev_ctrlr_update(struct BlockDevCtrlrOps *me)
 		ubdev = xzalloc(sizeof(*ubdev));
 
 		ubdev->bio = bio;
+		if (bs->HandleProtocol(handles[i], &block_io2_protocol_guid,
+				       (void **)&ubdev->bio2) != EFI_SUCCESS)
+			ubdev->bio2 = NULL;
 		ubdev->media_id = bio->Media->MediaId;
 		ubdev->io_align = bio->Media->IoAlign;
 		ubdev->write_caching = bio->Media->WriteCaching;
@@ -27,11 +27,20 @@
 
 struct _EFI_BLOCK_IO_PROTOCOL;
 typedef struct _EFI_BLOCK_IO_PROTOCOL EFI_BLOCK_IO_PROTOCOL;
+struct _EFI_BLOCK_IO2_PROTOCOL;
+typedef struct _EFI_BLOCK_IO2_PROTOCOL EFI_BLOCK_IO2_PROTOCOL;
+
+// How many pieces a large read is split into with EFI_BLOCK_IO2.
+#define UEFI_BLOCKDEV_REQUESTS 4
 
 typedef struct {
 	BlockDev dev;
 
 	EFI_BLOCK_IO_PROTOCOL *bio;
+	// NULL if the firmware doesn't provide EFI_BLOCK_IO2 for the device.
+	EFI_BLOCK_IO2_PROTOCOL *bio2;
+	// Completion events for bio2 requests, created on first use.
+	void *events[UEFI_BLOCKDEV_REQUESTS];
 	uint32_t media_id;
 	uint32_t io_align;
 	int write_caching;
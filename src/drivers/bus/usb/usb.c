@@ -24,6 +24,7 @@
 #include <libpayload.h>
 
 #include "base/cleanup.h"
+#include "base/profile.h"
 #include "base/xalloc.h"
 #include "drivers/bus/usb/usb.h"
 
@@ -104,6 +105,7 @@ void dc_usb_initialize(void)
 	};
 
 	if (need_init) {
+		profile_begin(&profile_usb);
 		usb_initialize();
 		need_init = 0;
 		cleanup_add(&cleanup);
@@ -116,5 +118,6 @@ void dc_usb_initialize(void)
 			if (hc->init_callback)
 				hc->init_callback(hc);
 		}
+		profile_end(&profile_usb, 0);
 	}
 }
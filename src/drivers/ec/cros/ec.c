@@ -33,6 +33,7 @@
 #include <stdio.h>
 
 #include "base/algorithm.h"
+#include "base/task.h"
 #include "base/time.h"
 #include "base/xalloc.h"
 #include "drivers/ec/cros/message.h"
@@ -56,6 +57,51 @@ static int max_param_size;
 static int passthru_param_size;
 static int initialized;
 
+/*
+ * What we've learned about each EC (the main one and the PD chip behind
+ * passthru) which can't change until it reboots or jumps to another image.
+ * Entries are filled in as they're first needed and dropped by
+ * cros_ec_reboot(), so each only costs a host command once.
+ */
+#define CROS_EC_MAX_DEVICES 2
+#define CROS_EC_CACHED_VERSIONS 8
+
+typedef struct {
+	struct {
+		int cmd;
+		uint32_t mask;
+	} versions[CROS_EC_CACHED_VERSIONS];
+	int num_versions;
+
+	int have_flash_info;
+	struct ec_response_flash_info flash_info;
+
+	uint32_t region_valid;
+	struct ec_response_flash_region_info regions[EC_FLASH_REGION_COUNT];
+
+	int have_current_image;
+	enum ec_current_image current_image;
+
+	// Write burst size, or 0 if not known yet.
+	uint32_t burst_size;
+} CrosEcCaps;
+
+static CrosEcCaps cros_ec_caps[CROS_EC_MAX_DEVICES];
+
+static CrosEcCaps *cros_ec_get_caps(int devidx)
+{
+	if (devidx < 0 || devidx >= CROS_EC_MAX_DEVICES)
+		return NULL;
+	return &cros_ec_caps[devidx];
+}
+
+static void cros_ec_invalidate_caps(int devidx)
+{
+	CrosEcCaps *caps = cros_ec_get_caps(devidx);
+	if (caps)
+		memset(caps, 0, sizeof(*caps));
+}
+
 #define DEFAULT_BUF_SIZE 0x100
 
 int cros_ec_set_bus(CrosEcBusOps *bus)
@@ -77,9 +123,6 @@ static const int CROS_EC_HASH_TIMEOUT_MS = 2000;
 /* Time to delay between polling status of EC hash calculation */
 static const int CROS_EC_HASH_CHECK_DELAY_MS = 10;
 
-/* Note: depends on enum ec_current_image */
-static const char * const ec_current_image_name[] = {"unknown", "RO", "RW"};
-
 void cros_ec_dump_data(const char *name, int cmd, const void *data, int len)
 {
 #ifdef DEBUG
@@ -404,11 +447,19 @@ int cros_ec_get_protocol_info(int devidx,
  */
 static int cros_ec_get_cmd_versions(int devidx, int cmd, uint32_t *pmask)
 {
+	CrosEcCaps *caps = cros_ec_get_caps(devidx);
 	struct ec_params_get_cmd_versions p;
 	struct ec_response_get_cmd_versions r;
 
 	*pmask = 0;
 
+	for (int i = 0; caps && i < caps->num_versions; i++) {
+		if (caps->versions[i].cmd == cmd) {
+			*pmask = caps->versions[i].mask;
+			return 0;
+		}
+	}
+
 	p.cmd = cmd;
 
 	if (ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) + EC_CMD_GET_CMD_VERSIONS,
@@ -416,6 +467,11 @@ static int cros_ec_get_cmd_versions(int devidx, int cmd, uint32_t *pmask)
 		return -1;
 
 	*pmask = r.version_mask;
+	if (caps && caps->num_versions < CROS_EC_CACHED_VERSIONS) {
+		caps->versions[caps->num_versions].cmd = cmd;
+		caps->versions[caps->num_versions].mask = r.version_mask;
+		caps->num_versions++;
+	}
 	return 0;
 }
 
@@ -491,29 +547,76 @@ int cros_ec_read_build_info(char *strp)
 
 int cros_ec_read_current_image(int devidx, enum ec_current_image *image)
 {
+	CrosEcCaps *caps = cros_ec_get_caps(devidx);
 	struct ec_response_get_version r;
 
+	if (caps && caps->have_current_image) {
+		*image = caps->current_image;
+		return 0;
+	}
+
 	if (ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) + EC_CMD_GET_VERSION, 0,
 		       NULL, 0, &r, sizeof(r)) < sizeof(r))
 		return -1;
 
 	*image = r.current_image;
+	if (caps) {
+		caps->current_image = r.current_image;
+		caps->have_current_image = 1;
+	}
 	return 0;
 }
 
-int cros_ec_read_hash(int devidx, struct ec_response_vboot_hash *hash)
+static int cros_ec_get_hash(int devidx, struct ec_response_vboot_hash *hash)
 {
 	struct ec_params_vboot_hash p;
+
+	p.cmd = EC_VBOOT_HASH_GET;
+	if (ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) + EC_CMD_VBOOT_HASH, 0,
+		       &p, sizeof(p), hash, sizeof(*hash)) < 0)
+		return -1;
+	return 0;
+}
+
+static int cros_ec_request_hash(int devidx,
+				struct ec_response_vboot_hash *hash)
+{
+	struct ec_params_vboot_hash p;
+
+	p.cmd = EC_VBOOT_HASH_START;
+	p.hash_type = EC_VBOOT_HASH_TYPE_SHA256;
+	p.nonce_size = 0;
+	p.offset = EC_VBOOT_HASH_OFFSET_RW;
+
+	if (ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) + EC_CMD_VBOOT_HASH, 0,
+		       &p, sizeof(p), hash, sizeof(*hash)) < 0)
+		return -1;
+	return 0;
+}
+
+int cros_ec_start_hash(int devidx)
+{
+	struct ec_response_vboot_hash hash;
+
+	if (cros_ec_get_hash(devidx, &hash))
+		return -1;
+
+	/* Leave a finished or running hash alone. */
+	if (hash.status != EC_VBOOT_HASH_STATUS_NONE)
+		return 0;
+
+	return cros_ec_request_hash(devidx, &hash);
+}
+
+int cros_ec_read_hash(int devidx, struct ec_response_vboot_hash *hash)
+{
 	uint64_t start;
 	int recalc_requested = 0;
 
 	start = time_us(0);
 	do {
 		/* Get hash if available. */
-		p.cmd = EC_VBOOT_HASH_GET;
-		if (ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) +
-			       EC_CMD_VBOOT_HASH, 0, &p, sizeof(p),
-			       hash, sizeof(*hash)) < 0)
+		if (cros_ec_get_hash(devidx, hash))
 			return -1;
 
 		switch (hash->status) {
@@ -526,14 +629,7 @@ int cros_ec_read_hash(int devidx, struct ec_response_vboot_hash *hash)
 			      "Compute one...\n", __func__, hash->status,
 			      hash->size);
 
-			p.cmd = EC_VBOOT_HASH_START;
-			p.hash_type = EC_VBOOT_HASH_TYPE_SHA256;
-			p.nonce_size = 0;
-			p.offset = EC_VBOOT_HASH_OFFSET_RW;
-
-			if (ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) +
-				       EC_CMD_VBOOT_HASH, 0, &p,
-				       sizeof(p), hash, sizeof(*hash)) < 0)
+			if (cros_ec_request_hash(devidx, hash))
 				return -1;
 
 			recalc_requested = 1;
@@ -542,8 +638,8 @@ int cros_ec_read_hash(int devidx, struct ec_response_vboot_hash *hash)
 			hash->status = EC_VBOOT_HASH_STATUS_BUSY;
 			break;
 		case EC_VBOOT_HASH_STATUS_BUSY:
-			/* Hash is still calculating. */
-			mdelay(CROS_EC_HASH_CHECK_DELAY_MS);
+			/* Hash is still calculating, let other work run. */
+			task_mdelay(CROS_EC_HASH_CHECK_DELAY_MS);
 			break;
 		case EC_VBOOT_HASH_STATUS_DONE:
 		default:
@@ -573,6 +669,9 @@ int cros_ec_reboot(int devidx, enum ec_reboot_cmd cmd, uint8_t flags)
 		       &p, sizeof(p), NULL, 0) < 0)
 		return -1;
 
+	/* Whatever comes back may be a different image. */
+	cros_ec_invalidate_caps(devidx);
+
 	if (!(flags & EC_REBOOT_FLAG_ON_AP_SHUTDOWN)) {
 		/*
 		 * EC reboot will take place immediately so delay to allow it
@@ -697,16 +796,28 @@ int cros_ec_test(void)
 int cros_ec_flash_offset(int devidx, enum ec_flash_region region,
 			 uint32_t *offset, uint32_t *size)
 {
+	CrosEcCaps *caps = cros_ec_get_caps(devidx);
 	struct ec_params_flash_region_info p;
 	struct ec_response_flash_region_info r;
 	int ret;
 
-	p.region = region;
-	ret = ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) +
-			 EC_CMD_FLASH_REGION_INFO, EC_VER_FLASH_REGION_INFO,
-			 &p, sizeof(p), &r, sizeof(r));
-	if (ret != sizeof(r))
-		return -1;
+	if (caps && region < EC_FLASH_REGION_COUNT &&
+	    (caps->region_valid & (1 << region))) {
+		r = caps->regions[region];
+	} else {
+		p.region = region;
+		ret = ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) +
+				 EC_CMD_FLASH_REGION_INFO,
+				 EC_VER_FLASH_REGION_INFO,
+				 &p, sizeof(p), &r, sizeof(r));
+		if (ret != sizeof(r))
+			return -1;
+
+		if (caps && region < EC_FLASH_REGION_COUNT) {
+			caps->regions[region] = r;
+			caps->region_valid |= 1 << region;
+		}
+	}
 
 	if (offset)
 		*offset = r.offset;
@@ -738,38 +849,51 @@ int cros_ec_flash_erase(int devidx, uint32_t offset, uint32_t size)
  * Attempting to write to the region where the EC is currently running from
  * will result in an error.
  *
- * @param data		Pointer to data buffer to write
+ * The data has to already be in place right after the parameter header in
+ * buf, which lets callers build bursts in a buffer they reuse.
+ *
+ * @param buf		Parameter header followed by the data to write
  * @param offset	Offset within flash to write to.
  * @param size		Number of bytes to write
  * @return 0 if ok, -1 on error
  */
-static int cros_ec_flash_write_block(int devidx, const uint8_t *data,
+static int cros_ec_flash_write_block(int devidx, uint8_t *buf,
 				     uint32_t offset, uint32_t size)
 {
-	uint8_t *buf;
-	struct ec_params_flash_write *p;
+	struct ec_params_flash_write *p = (struct ec_params_flash_write *)buf;
 	uint32_t bufsize = sizeof(*p) + size;
-	int rv;
 
-	assert(data);
+	assert(buf);
 
 	/* Make sure request fits in the allowed packet size */
 	if (bufsize > (devidx == 0 ? max_param_size : passthru_param_size))
 		return -1;
 
-	buf = xmalloc(bufsize);
-
-	p = (struct ec_params_flash_write *)buf;
 	p->offset = offset;
 	p->size = size;
-	memcpy(p + 1, data, size);
 
-	rv = ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) + EC_CMD_FLASH_WRITE,
-			0, buf, bufsize, NULL, 0) >= 0 ? 0 : -1;
+	return ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) + EC_CMD_FLASH_WRITE,
+			  0, buf, bufsize, NULL, 0) >= 0 ? 0 : -1;
+}
 
-	free(buf);
+static int cros_ec_flash_info(int devidx, struct ec_response_flash_info *info)
+{
+	CrosEcCaps *caps = cros_ec_get_caps(devidx);
 
-	return rv;
+	if (caps && caps->have_flash_info) {
+		*info = caps->flash_info;
+		return 0;
+	}
+
+	if (ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) + EC_CMD_FLASH_INFO, 0,
+		       NULL, 0, info, sizeof(*info)) < sizeof(*info))
+		return -1;
+
+	if (caps) {
+		caps->flash_info = *info;
+		caps->have_flash_info = 1;
+	}
+	return 0;
 }
 
 /**
@@ -777,63 +901,85 @@ static int cros_ec_flash_write_block(int devidx, const uint8_t *data,
  */
 static int cros_ec_flash_write_burst_size(int devidx)
 {
+	CrosEcCaps *caps = cros_ec_get_caps(devidx);
 	struct ec_response_flash_info info;
 	uint32_t pdata_max_size =
 		(devidx == 0 ? max_param_size : passthru_param_size) -
 		sizeof(struct ec_params_flash_write);
+	uint32_t burst;
+
+	if (caps && caps->burst_size)
+		return caps->burst_size;
 
 	/*
 	 * Determine whether we can use version 1 of the command with more
 	 * data, or only version 0.
 	 */
 	if (!cros_ec_cmd_version_supported(devidx, EC_CMD_FLASH_WRITE,
-					   EC_VER_FLASH_WRITE))
-		return EC_FLASH_WRITE_VER0_SIZE;
+					   EC_VER_FLASH_WRITE)) {
+		burst = EC_FLASH_WRITE_VER0_SIZE;
+	} else {
+		/*
+		 * Determine step size.  This must be a multiple of the write
+		 * block size, and must also fit into the host parameter
+		 * buffer.
+		 */
+		if (cros_ec_flash_info(devidx, &info))
+			return 0;
 
-	/*
-	 * Determine step size.  This must be a multiple of the write block
-	 * size, and must also fit into the host parameter buffer.
-	 */
-	if (ec_command(EC_CMD_PASSTHRU_OFFSET(devidx) + EC_CMD_FLASH_INFO, 0,
-		       NULL, 0, &info, sizeof(info)) < sizeof(info))
-		return 0;
+		burst = (pdata_max_size / info.write_block_size) *
+			info.write_block_size;
+	}
 
-	return (pdata_max_size / info.write_block_size) *
-		info.write_block_size;
+	if (caps)
+		caps->burst_size = burst;
+	return burst;
 }
 
-int cros_ec_flash_write(int devidx, const uint8_t *data, uint32_t offset,
-			uint32_t size)
+/*
+ * Write size bytes in bursts. If pad is set, a short final burst is filled
+ * out to a whole burst with 0xff, otherwise it's sent as is and nothing past
+ * offset + size is touched.
+ */
+static int cros_ec_flash_write_bursts(int devidx, const uint8_t *data,
+				      uint32_t offset, uint32_t size, int pad)
 {
 	uint32_t burst = cros_ec_flash_write_burst_size(devidx);
+	struct ec_params_flash_write *p;
 	uint32_t end, off;
-	int ret;
+	int ret = 0;
 
 	if (!burst)
 		return -1;
 
+	/* Every burst is built in the same buffer, right after its header. */
+	uint8_t *buf = xmalloc(sizeof(*p) + burst);
+	p = (struct ec_params_flash_write *)buf;
+
 	end = offset + size;
 	for (off = offset; off < end; off += burst, data += burst) {
 		uint32_t todo = MIN(end - off, burst);
 
-		if (todo < burst) {
-			uint8_t *buf = xmalloc(burst);
-			memcpy(buf, data, todo);
+		memcpy(p + 1, data, todo);
+		if (pad && todo < burst) {
 			// Pad the buffer with a decent guess for erased data
 			// value.
-			memset(buf + todo, 0xff, burst - todo);
-			ret = cros_ec_flash_write_block(devidx, buf,
-							off, burst);
-			free(buf);
-		} else {
-			ret = cros_ec_flash_write_block(devidx, data,
-							off, burst);
+			memset((uint8_t *)(p + 1) + todo, 0xff, burst - todo);
+			todo = burst;
 		}
+		ret = cros_ec_flash_write_block(devidx, buf, off, todo);
 		if (ret)
-			return ret;
+			break;
 	}
 
-	return 0;
+	free(buf);
+	return ret;
+}
+
+int cros_ec_flash_write(int devidx, const uint8_t *data, uint32_t offset,
+			uint32_t size)
+{
+	return cros_ec_flash_write_bursts(devidx, data, offset, size, 1);
 }
 
 /**
@@ -880,10 +1026,40 @@ int cros_ec_flash_read(int devidx, uint8_t *data, uint32_t offset,
 	return 0;
 }
 
+static int cros_ec_flash_update_rw_full(int devidx, const uint8_t *image,
+					int image_size, uint32_t rw_offset,
+					uint32_t rw_size)
+{
+	int ret;
+
+	/*
+	 * Erase the entire RW section, so that the EC doesn't see any garbage
+	 * past the new image if it's smaller than the current image.
+	 */
+	ret = cros_ec_flash_erase(devidx, rw_offset, rw_size);
+	if (ret)
+		return ret;
+
+	/* Write the image */
+	return cros_ec_flash_write(devidx, image, rw_offset, image_size);
+}
+
+/*
+ * Returns how many of the size bytes at data need writing to flash after an
+ * erase, which is everything up to the last byte that isn't 0xff.
+ */
+static uint32_t cros_ec_flash_used_size(const uint8_t *data, uint32_t size)
+{
+	while (size && data[size - 1] == 0xff)
+		size--;
+	return size;
+}
+
 int cros_ec_flash_update_rw(int devidx, const uint8_t *image, int image_size)
 {
+	struct ec_response_flash_info info;
 	uint32_t rw_offset, rw_size;
-	int ret;
+	int ret = 0;
 
 	if (cros_ec_flash_offset(devidx, EC_FLASH_REGION_RW,
 				 &rw_offset, &rw_size))
@@ -892,23 +1068,63 @@ int cros_ec_flash_update_rw(int devidx, const uint8_t *image, int image_size)
 		return -1;
 
 	/*
-	 * Erase the entire RW section, so that the EC doesn't see any garbage
-	 * past the new image if it's smaller than the current image.
-	 *
-	 * TODO: could optimize this to erase just the current image, since
-	 * presumably everything past that is 0xff's.  But would still need to
-	 * round up to the nearest multiple of erase size.
+	 * Only erase and rewrite the erase blocks which actually differ from
+	 * the new image, with everything past its end expected to be erased.
+	 * If the erase geometry doesn't make sense, rewrite the whole thing.
 	 */
-	ret = cros_ec_flash_erase(devidx, rw_offset, rw_size);
-	if (ret)
-		return ret;
+	if (cros_ec_flash_info(devidx, &info) ||
+	    !info.erase_block_size ||
+	    rw_offset % info.erase_block_size ||
+	    rw_size % info.erase_block_size)
+		return cros_ec_flash_update_rw_full(devidx, image, image_size,
+						    rw_offset, rw_size);
+
+	uint32_t block_size = info.erase_block_size;
+	uint32_t write_size = MAX(info.write_block_size, 1);
+	uint8_t *expected = xmalloc(block_size);
+	uint8_t *current = xmalloc(block_size);
+	int blocks_written = 0;
+
+	for (uint32_t off = 0; off < rw_size; off += block_size) {
+		uint32_t image_len = 0;
+		if (off < image_size)
+			image_len = MIN(image_size - off, block_size);
+		memcpy(expected, image + off, image_len);
+		memset(expected + image_len, 0xff, block_size - image_len);
+
+		if (cros_ec_flash_read(devidx, current, rw_offset + off,
+				       block_size) == 0 &&
+		    memcmp(current, expected, block_size) == 0)
+			continue;
+
+		blocks_written++;
+		ret = cros_ec_flash_erase(devidx, rw_offset + off, block_size);
+		if (ret)
+			break;
 
-	/* Write the image */
-	ret = cros_ec_flash_write(devidx, image, rw_offset, image_size);
-	if (ret)
-		return ret;
+		/*
+		 * Writes have to cover whole write blocks, but mustn't spill
+		 * into the next erase block, which wasn't erased and may
+		 * still hold data we're keeping.
+		 */
+		uint32_t used = cros_ec_flash_used_size(expected, block_size);
+		used = MIN((used + write_size - 1) / write_size * write_size,
+			   block_size);
+		if (used) {
+			ret = cros_ec_flash_write_bursts(devidx, expected,
+							 rw_offset + off,
+							 used, 0);
+			if (ret)
+				break;
+		}
+	}
 
-	return 0;
+	printf("EC: Updated %d of %d RW flash blocks.\n", blocks_written,
+	       rw_size / block_size);
+
+	free(current);
+	free(expected);
+	return ret;
 }
 
 int cros_ec_read_vbnvcontext(uint8_t *block)
@@ -1087,6 +1303,10 @@ int cros_ec_init(void)
 	if (initialized)
 		return 0;
 
+	// Packet sizes are about to be renegotiated, so forget what we knew.
+	for (int i = 0; i < CROS_EC_MAX_DEVICES; i++)
+		cros_ec_invalidate_caps(i);
+
 	if (!cros_ec_bus) {
 		printf("No ChromeOS EC bus configured.\n");
 		return -1;
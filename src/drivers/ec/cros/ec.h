@@ -127,6 +127,16 @@ int cros_ec_scan_keyboard(struct cros_ec_keyscan *scan);
  */
 int cros_ec_read_current_image(int devidx, enum ec_current_image *image);
 
+/**
+ * Ask the EC to start hashing its RW firmware, unless it already has a hash
+ * or is working on one. This doesn't wait, so the hash can be computed while
+ * the AP does other things and collected later with cros_ec_read_hash().
+ *
+ * @param devidx	Index of target device
+ * @return 0 if ok, <0 on error
+ */
+int cros_ec_start_hash(int devidx);
+
 /**
  * Read the hash of the ChromeOS EC device firmware.
  *
@@ -221,6 +231,9 @@ int cros_ec_test(void);
 /**
  * Update the EC RW copy.
  *
+ * Only the erase blocks whose contents differ from the new image (padded
+ * with 0xff to the end of the region) are erased and rewritten.
+ *
  * @param devidx	Index of target device
  * @param image		the content to write
  * @param imafge_size	content length
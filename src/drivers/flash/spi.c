@@ -109,7 +109,7 @@ static int wait_for_wip(SpiFlash *flash)
 {
 	const uint32_t FlashStatusWip = 1 << 0;
 
-	uint64_t start_time = time_us(0);
+	uint64_t deadline = time_deadline_ms(2 * 1000);
 	do {
 		uint8_t cmd = ReadSr1Command;
 		uint8_t status;
@@ -120,7 +120,7 @@ static int wait_for_wip(SpiFlash *flash)
 		if (!(status & FlashStatusWip))
 			return 0;
 
-		if (time_us(start_time) > 2 * 1000 * 1000) {
+		if (time_deadline_expired(deadline)) {
 			printf("Timeout waiting for WIP to clear.\n");
 			return 1;
 		}
@@ -21,6 +21,7 @@
  */
 
 #include "base/list.h"
+#include "base/task.h"
 #include "base/xalloc.h"
 #include "drivers/bus/usb/usb.h"
 #include "drivers/keyboard/dynamic.h"
@@ -42,6 +43,8 @@ static int get_char(KeyboardOps *me)
 			if (kb->ops.have_char(&kb->ops))
 				return kb->ops.get_char(&kb->ops);
 		}
+
+		task_mdelay(KeyboardPollMs);
 	}
 }
 
@@ -28,6 +28,10 @@ typedef struct KeyboardOps {
 	int (*have_char)(struct KeyboardOps *me);
 } KeyboardOps;
 
+// How often blocking reads look for input. Keyboards don't report keys any
+// faster than this, so scanning more often only burns power.
+enum { KeyboardPollMs = 1 };
+
 // Make sure all the keyboards on the system are awake and ready to receive
 // keys. This lets us get any delays out of the way ahead of time and avoids
 // having them between when we've prompted the user, displayed graphics, etc.,
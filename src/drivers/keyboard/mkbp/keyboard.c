@@ -29,6 +29,7 @@
 #include "base/container_of.h"
 #include "base/init_funcs.h"
 #include "base/keycodes.h"
+#include "base/task.h"
 #include "drivers/ec/cros/ec.h"
 #include "drivers/keyboard/keyboard.h"
 #include "drivers/keyboard/mkbp/keyboard.h"
@@ -233,7 +234,10 @@ static int mkbp_keyboard_get_char(KeyboardOps *me)
 {
 	MkbpKeyboard *keyboard = container_of(me, MkbpKeyboard, ops);
 
-	while (!mkbp_keyboard_have_char(me));
+	// The EC raises its interrupt line when it has keys, so there's
+	// nothing to do until then but let other work run.
+	while (!mkbp_keyboard_have_char(me))
+		task_mdelay(KeyboardPollMs);
 
 	return keyboard->key_fifo[keyboard->fifo_offset++];
 }
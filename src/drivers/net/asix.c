@@ -285,7 +285,8 @@ static int asix_recv(NetDevice *net_dev, void *buf, uint16_t *len, int maxlen)
 		return 1;
 	}
 
-	memcpy(buf, msg + offset + sizeof(packet_len), packet_len);
+	net_copy_rx_packet(buf, msg + offset + sizeof(packet_len),
+			   packet_len);
 	offset += sizeof(packet_len) + packet_len;
 
 	return 0;
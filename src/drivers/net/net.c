@@ -23,7 +23,9 @@
 #include <assert.h>
 #include <endian.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "base/ipchecksum.h"
 #include "base/time.h"
 #include "drivers/net/net.h"
 #include "net/uip.h"
@@ -109,6 +111,7 @@ void net_poll(void)
 	}
 
 	struct uip_eth_hdr *hdr = (struct uip_eth_hdr *)uip_buf;
+	uip_set_rx_sum(0, 0);
 	if (net_device->recv(net_device, uip_buf, &uip_len,
 			     CONFIG_UIP_BUFSIZE)) {
 		printf("Receive failed.\n");
@@ -130,6 +133,15 @@ void net_poll(void)
 	}
 }
 
+void net_copy_rx_packet(void *dest, const void *src, uint16_t len)
+{
+	// Only frames landing in uip_buf are going to be checked by uIP.
+	if (dest == uip_buf)
+		uip_set_rx_sum(ipchecksum_copy(dest, src, len), len);
+	else
+		memcpy(dest, src, len);
+}
+
 int net_send(void *buf, uint16_t len)
 {
 	if (!net_device) {
@@ -50,6 +50,8 @@ void net_remove_device(NetDevice *dev);
 NetDevice *net_get_device(void);
 void net_poll(void);
 int net_send(void *buf, uint16_t len);
+// Copy a received frame out of a driver's buffer, checksumming it on the way.
+void net_copy_rx_packet(void *dest, const void *src, uint16_t len);
 void net_wait_for_link(void);
 const uip_eth_addr *net_get_mac(void);
 
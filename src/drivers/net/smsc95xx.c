@@ -361,7 +361,8 @@ static int smsc95xx_recv(NetDevice *net_dev, void *buf, uint16_t *len,
 		return 1;
 	}
 
-	memcpy(buf, msg + offset + sizeof(rx_status), packet_len);
+	net_copy_rx_packet(buf, msg + offset + sizeof(rx_status),
+			   packet_len);
 	offset += sizeof(rx_status) + packet_len;
 
 	return 0;
@@ -33,3 +33,8 @@ uint64_t timer_raw_value(void)
 {
 	return 0;
 }
+
+int timer_raw_bits(void)
+{
+	return 64;
+}
@@ -111,3 +111,8 @@ uint64_t timer_raw_value(void)
 
 	return (upper << 32) | lower;
 }
+
+int timer_raw_bits(void)
+{
+	return 64;
+}
@@ -77,3 +77,8 @@ uint64_t timer_raw_value(void)
 {
 	return rdtsc();
 }
+
+int timer_raw_bits(void)
+{
+	return 64;
+}
@@ -45,3 +45,8 @@ uint64_t timer_raw_value(void)
 	upper = (uint64_t)rk_timer->timer_curr_value1;
 	return (upper << 32) | lower;
 }
+
+int timer_raw_bits(void)
+{
+	return 64;
+}
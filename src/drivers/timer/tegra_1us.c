@@ -42,3 +42,8 @@ uint64_t timer_raw_value(void)
 {
 	return read32(tegra_tmrus);
 }
+
+int timer_raw_bits(void)
+{
+	return 32;
+}
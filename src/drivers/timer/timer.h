@@ -27,6 +27,8 @@
 
 uint64_t timer_hz(void);
 uint64_t timer_raw_value(void);
+// The number of bits in the raw value, which wraps to 0 after all ones.
+int timer_raw_bits(void);
 uint64_t time_us(uint64_t base);
 
 #endif /* __DRIVERS_TIMER_TIMER_H__ */
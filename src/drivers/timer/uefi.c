@@ -137,3 +137,20 @@ uint64_t timer_raw_value(void)
 	EFI_TIMESTAMP_PROTOCOL *prot = timer_uefi_timestamp_protocol();
 	return prot->GetTimestamp();
 }
+
+int timer_raw_bits(void)
+{
+	static int bits;
+
+	if (!bits) {
+		EFI_TIMESTAMP_PROPERTIES properties;
+		EFI_TIMESTAMP_PROTOCOL *prot = timer_uefi_timestamp_protocol();
+		uefi_timer_get_props(prot, &properties);
+		// The counter rolls over after EndValue, which is all ones.
+		bits = 64;
+		while (bits > 1 && !(properties.EndValue >> (bits - 1)))
+			bits--;
+	}
+
+	return bits;
+}
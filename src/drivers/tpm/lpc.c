@@ -32,6 +32,7 @@
 #include <endian.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "base/algorithm.h"
 #include "base/cleanup.h"
@@ -53,10 +54,14 @@ typedef struct {
 	uint8_t burst_count[2];
 	uint8_t padding2[9];
 	uint8_t data;
-	uint8_t padding3[3803];
+	uint8_t padding3[11];
+	uint32_t interface_id;
+	uint8_t padding4[76];
+	uint32_t xdata;
+	uint8_t padding5[3708];
 	uint32_t did_vid;
 	uint8_t rid;
-	uint8_t padding4[251];
+	uint8_t padding6[251];
 } TpmLocality;
 
 typedef struct TpmRegs
@@ -73,6 +78,19 @@ enum {
 	TisStsResponseRetry = 0x02
 };
 
+enum {
+	TisCapDataTransferMask = 0x3 << 9,
+	TisCapDataTransferLegacy = 0x0 << 9,
+
+	TisInterfaceTypeMask = 0xf,
+	TisInterfaceTypeFifo = 0x0
+};
+
+enum {
+	TpmTimeoutUs = 1000 * 1000,
+	TpmMaxPollDelayUs = 1000
+};
+
 enum {
 	TisAccessTpmRegValidSts = 0x80,
 	TisAccessActiveLocality = 0x20,
@@ -134,13 +152,36 @@ static const struct vendor_name vendor_names[] = {
  */
 static uint32_t vendor_dev_id;
 
-// Retrieve burst count value.
-static uint16_t burst_count(TpmLocality *dev)
+/*
+ * Read the status register and the burst count behind it with a single
+ * access. The status is in the low byte, the burst count in the next two.
+ */
+static uint32_t lpctpm_status(TpmLocality *dev)
+{
+	return le32toh(read32(&dev->tpm_status));
+}
+
+static uint16_t status_burst(uint32_t status)
 {
-	uint16_t value;
-	value = read8(&dev->burst_count[0]);
-	value |= read8(&dev->burst_count[1]) << 8;
-	return value;
+	return (status >> 8) & 0xffff;
+}
+
+/*
+ * Sleep between polls, doubling the delay each time so a TPM which answers
+ * quickly is noticed quickly and a slow one isn't hammered with reads.
+ *
+ * @start - time the wait started, as returned by time_us(0)
+ * @delay - current delay in microseconds, updated for the next poll
+ *
+ * Returns 0 if polling should continue or -1 on timeout.
+ */
+static int lpctpm_backoff(uint64_t start, uint32_t *delay)
+{
+	if (time_us(start) >= TpmTimeoutUs)
+		return -1;
+	udelay(*delay);
+	*delay = MIN(*delay * 2, (uint32_t)TpmMaxPollDelayUs);
+	return 0;
 }
 
 /*
@@ -158,13 +199,72 @@ static uint16_t burst_count(TpmLocality *dev)
 static int lpctpm_wait_reg(uint8_t *reg, uint8_t mask, uint8_t expected)
 {
 	uint64_t start = time_us(0);
+	uint32_t delay = 1;
 	do {
 		if ((read8(reg) & mask) == expected)
 			return 0;
-	} while (time_us(start) < 1000 * 1000);
+	} while (!lpctpm_backoff(start, &delay));
 	return -1;
 }
 
+/*
+ * Wait for the TPM to report a nonzero burst count.
+ *
+ * @dev - pointer to the locality registers
+ * @status - where to store the status register which had the burst count
+ *
+ * Returns the burst count, or 0 on timeout.
+ */
+static uint16_t lpctpm_wait_burst(TpmLocality *dev, uint32_t *status)
+{
+	uint64_t start = time_us(0);
+	uint32_t delay = 1;
+	do {
+		*status = lpctpm_status(dev);
+		uint16_t burst = status_burst(*status);
+		if (burst)
+			return burst;
+	} while (!lpctpm_backoff(start, &delay));
+	return 0;
+}
+
+/*
+ * Move data through the FIFO, a word at a time through the XDATA register if
+ * the TPM supports it and a byte at a time through the data register
+ * otherwise. Both registers front the same FIFO, so a transfer which isn't a
+ * multiple of four just finishes with byte accesses.
+ */
+static void lpctpm_write_fifo(LpcTpm *tpm, const uint8_t *data, uint32_t count)
+{
+	TpmLocality *dev = &tpm->regs->localities[0];
+
+	if (tpm->xdata) {
+		for (; count >= sizeof(uint32_t); count -= sizeof(uint32_t)) {
+			uint32_t word;
+			memcpy(&word, data, sizeof(word));
+			write32(&dev->xdata, word);
+			data += sizeof(word);
+		}
+	}
+	while (count--)
+		write8(&dev->data, *data++);
+}
+
+static void lpctpm_read_fifo(LpcTpm *tpm, uint8_t *buffer, uint32_t count)
+{
+	TpmLocality *dev = &tpm->regs->localities[0];
+
+	if (tpm->xdata) {
+		for (; count >= sizeof(uint32_t); count -= sizeof(uint32_t)) {
+			uint32_t word = read32(&dev->xdata);
+			memcpy(buffer, &word, sizeof(word));
+			buffer += sizeof(word);
+		}
+	}
+	while (count--)
+		*buffer++ = read8(&dev->data);
+}
+
 /*
  * PC Client Specific TPM Interface Specification section 11.2.12:
  *
@@ -214,78 +314,65 @@ static int lpctpm_command_ready(LpcTpm *tpm)
 static uint32_t lpctpm_senddata(LpcTpm *tpm, const uint8_t * const data,
 				uint32_t len)
 {
+	TpmLocality *dev = &tpm->regs->localities[0];
 	uint32_t offset = 0;
+	uint32_t status;
 
-	if (lpctpm_wait_reg(&tpm->regs->localities[0].tpm_status,
+	if (lpctpm_wait_reg(&dev->tpm_status,
 			    TisStsCommandReady, TisStsCommandReady)) {
 		printf("%s:%d - failed to get 'command_ready' status\n",
 		       __FILE__, __LINE__);
 		return -1;
 	}
-	uint16_t burst = burst_count(&tpm->regs->localities[0]);
-
-	while (1) {
-		// Wait till the device is ready to accept more data.
-		uint64_t start = time_us(0);
-		while (!burst) {
-			if (time_us(start) > 1000 * 1000) {
-				printf("%s:%d failed to feed %d bytes of %d.\n",
-				       __FILE__, __LINE__, len - offset, len);
-				return -1;
-			}
-			burst = burst_count(&tpm->regs->localities[0]);
-		}
 
-		/*
-		 * Calculate number of bytes the TPM is ready to accept in one
-		 * shot.
-		 *
-		 * We want to send the last byte outside of the loop (hence
-		 * the -1 below) to make sure that the 'expected' status bit
-		 * changes to zero exactly after the last byte is fed into the
-		 * FIFO.
-		 */
-		unsigned count = MIN(burst, len - offset - 1);
-		while (count--)
-			write8(&tpm->regs->localities[0].data, data[offset++]);
-
-		if (lpctpm_wait_reg(&tpm->regs->localities[0].tpm_status,
-				    TisStsValid, TisStsValid) ||
-		    !(read8(&tpm->regs->localities[0].tpm_status) &
-		      TisStsExpect)) {
-			printf("%s:%d TPM command feed overflow\n",
-			       __FILE__, __LINE__);
+	/*
+	 * Feed the command as fast as the TPM will take it, only going back
+	 * to the status register when a burst runs out.
+	 *
+	 * We want to send the last byte outside of the loop (hence the -1
+	 * below) to make sure that the 'expected' status bit changes to zero
+	 * exactly after the last byte is fed into the FIFO.
+	 */
+	while (offset < len - 1) {
+		uint16_t burst = lpctpm_wait_burst(dev, &status);
+		if (!burst) {
+			printf("%s:%d failed to feed %d bytes of %d.\n",
+			       __FILE__, __LINE__, len - offset, len);
 			return -1;
 		}
 
-		burst = burst_count(&tpm->regs->localities[0]);
-		if ((offset == (len - 1)) && burst) {
-			/*
-			 * We need to be able to send the last byte to the
-			 * device, so burst size must be nonzero before we
-			 * break out.
-			 */
-			break;
-		}
+		uint32_t count = MIN((uint32_t)burst, len - offset - 1);
+		lpctpm_write_fifo(tpm, data + offset, count);
+		offset += count;
+	}
+
+	if (lpctpm_wait_reg(&dev->tpm_status, TisStsValid, TisStsValid) ||
+	    !(read8(&dev->tpm_status) & TisStsExpect)) {
+		printf("%s:%d TPM command feed overflow\n",
+		       __FILE__, __LINE__);
+		return -1;
 	}
 
 	// Send the last byte.
-	write8(&tpm->regs->localities[0].data, data[offset++]);
+	if (!lpctpm_wait_burst(dev, &status)) {
+		printf("%s:%d failed to feed the last byte.\n",
+		       __FILE__, __LINE__);
+		return -1;
+	}
+	write8(&dev->data, data[offset++]);
 	/*
 	 * Verify that TPM does not expect any more data as part of this
 	 * command.
 	 */
-	if (lpctpm_wait_reg(&tpm->regs->localities[0].tpm_status,
-			    TisStsValid, TisStsValid) ||
-	    (read8(&tpm->regs->localities[0].tpm_status) & TisStsExpect)) {
+	if (lpctpm_wait_reg(&dev->tpm_status, TisStsValid, TisStsValid) ||
+	    (read8(&dev->tpm_status) & TisStsExpect)) {
 		printf("%s:%d unexpected TPM status 0x%x\n",
-		       __FILE__, __LINE__,
-		       read8(&tpm->regs->localities[0].tpm_status));
+		       __FILE__, __LINE__, read8(&dev->tpm_status));
 		return -1;
 	}
 
 	// OK, sitting pretty, let's start the command execution.
-	write8(&tpm->regs->localities[0].tpm_status, TisStsTpmGo);
+	write8(&dev->tpm_status, TisStsTpmGo);
 	return 0;
 }
 
@@ -295,7 +382,7 @@ static uint32_t lpctpm_senddata(LpcTpm *tpm, const uint8_t * const data,
  * read the TPM device response after a command was issued.
  *
  * @tpm - pointer to the TPM structure
- * @buffer - address where to read the response, byte by byte.
+ * @buffer - address where to read the response.
  * @len - pointer to the size of buffer
  *
  * On success stores the number of received bytes to len and returns 0. On
@@ -303,79 +390,61 @@ static uint32_t lpctpm_senddata(LpcTpm *tpm, const uint8_t * const data,
  */
 static uint32_t lpctpm_readresponse(LpcTpm *tpm, uint8_t *buffer, size_t *len)
 {
-	uint16_t burst;
+	TpmLocality *dev = &tpm->regs->localities[0];
 	uint32_t offset = 0;
 	const uint32_t has_data = TisStsDataAvailable | TisStsValid;
+	const uint32_t header_size = 6;
 	uint32_t expected_count = *len;
 
 	// Wait for the TPM to process the command.
-	if (lpctpm_wait_reg(&tpm->regs->localities[0].tpm_status,
-			      has_data, has_data)) {
+	if (lpctpm_wait_reg(&dev->tpm_status, has_data, has_data)) {
 		printf("%s:%d failed processing command\n", __FILE__, __LINE__);
 		return -1;
 	}
 
-	do {
-		uint64_t start = time_us(0);
-		while ((burst = burst_count(&tpm->regs->localities[0])) == 0) {
-			if (time_us(start) > 1000 * 1000) {
-				printf("%s:%d TPM stuck on read\n",
-				       __FILE__, __LINE__);
-				return -1;
-			}
-			udelay(1);
-		}
-
-		while (burst-- && (offset < expected_count)) {
-			buffer[offset++] =
-				read8(&tpm->regs->localities[0].data);
-
-			if (offset == 6) {
-				/*
-				 * We got the first six bytes of the reply,
-				 * let's figure out how many bytes to expect
-				 * total - it is stored as a 4 byte number in
-				 * network order, starting with offset 2 into
-				 * the body of the reply.
-				 */
-				uint32_t real_length;
-				memcpy(&real_length,
-				       buffer + 2,
-				       sizeof(real_length));
-				expected_count = be32toh(real_length);
-
-				if ((expected_count < offset) ||
-				    (expected_count > *len)) {
-					printf("%s:%d bad response size %d\n",
-					       __FILE__, __LINE__,
-					       expected_count);
-					return -1;
-				}
-			}
-		}
-
-		// Wait for the next portion.
-		if (lpctpm_wait_reg(&tpm->regs->localities[0].tpm_status,
-				     TisStsValid, TisStsValid)) {
-			printf("%s:%d failed to read response\n",
-			       __FILE__, __LINE__);
+	while (offset < expected_count) {
+		uint32_t status;
+		uint16_t burst = lpctpm_wait_burst(dev, &status);
+		if (!burst) {
+			printf("%s:%d TPM stuck on read\n", __FILE__, __LINE__);
 			return -1;
 		}
 
-		if (offset == expected_count)
-			break;	// We got all we needed.
+		// Stop at the end of the header until we know the real size.
+		uint32_t count = MIN((uint32_t)burst, expected_count - offset);
+		if (offset < header_size)
+			count = MIN(count, header_size - offset);
+		lpctpm_read_fifo(tpm, buffer + offset, count);
+		offset += count;
 
-	} while ((read8(&tpm->regs->localities[0].tpm_status) & has_data)
-	         == has_data);
+		if (offset == header_size) {
+			/*
+			 * We got the first six bytes of the reply,
+			 * let's figure out how many bytes to expect
+			 * total - it is stored as a 4 byte number in
+			 * network order, starting with offset 2 into
+			 * the body of the reply.
+			 */
+			uint32_t real_length;
+			memcpy(&real_length, buffer + 2, sizeof(real_length));
+			expected_count = be32toh(real_length);
+
+			if ((expected_count < offset) ||
+			    (expected_count > *len)) {
+				printf("%s:%d bad response size %d\n",
+				       __FILE__, __LINE__, expected_count);
+				return -1;
+			}
+		}
+	}
 
 	/*
-	 * Make sure we indeed read all there was. The TisStsValid bit is
-	 * known to be set.
+	 * Make sure we indeed read all there was.
 	 */
-	if (read8(&tpm->regs->localities[0].tpm_status) & TisStsDataAvailable) {
+	if (lpctpm_wait_reg(&dev->tpm_status, TisStsValid, TisStsValid) ||
+	    (read8(&dev->tpm_status) & TisStsDataAvailable)) {
 		printf("%s:%d wrong receive status %x\n",
-		       __FILE__, __LINE__,
-		       read8(&tpm->regs->localities[0].tpm_status));
+		       __FILE__, __LINE__, read8(&dev->tpm_status));
 		return -1;
 	}
 
@@ -423,6 +492,19 @@ static int lpctpm_init(LpcTpm *tpm)
 	const char *device_name = "unknown";
 	const char *vendor_name = device_name;
 
+	/*
+	 * TIS 2.0/PTP FIFO interfaces which can transfer more than a byte at
+	 * a time can move data through the 32 bit XDATA register. Older TIS
+	 * 1.2 parts read all ones from the interface ID register. Every
+	 * instance needs to know, so check before the shortcut below.
+	 */
+	uint32_t interface_id = read32(&tpm->regs->localities[0].interface_id);
+	uint32_t capability = read32(&tpm->regs->localities[0].int_capability);
+	tpm->xdata = (interface_id & TisInterfaceTypeMask) ==
+		     TisInterfaceTypeFifo &&
+		     (capability & TisCapDataTransferMask) !=
+		     TisCapDataTransferLegacy;
+
 	if (vendor_dev_id)
 		return 0;
 
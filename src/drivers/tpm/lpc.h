@@ -33,6 +33,8 @@ typedef struct {
 	TpmOps ops;
 
 	int initialized;
+	// Whether data can go through the 32 bit XDATA FIFO register.
+	int xdata;
 	TpmRegs *regs;
 	CleanupEvent cleanup;
 } LpcTpm;
@@ -20,13 +20,182 @@
  * MA 02111-1307 USA
  */
 
+#include <endian.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "base/algorithm.h"
 #include "base/die.h"
+#include "base/list.h"
+#include "base/profile.h"
+#include "base/xalloc.h"
 #include "drivers/tpm/tpm.h"
 
 static TpmOps *tpm_ops;
 
+/*
+ * TPM 1.2 command tags and ordinals the NV read cache needs to know about.
+ * Only commands without authorization sessions are cached; everything else
+ * goes straight to the TPM.
+ */
+enum {
+	TpmTagRquCommand = 0x00c1,
+
+	TpmOrdExtend = 0x14,
+	TpmOrdPcrRead = 0x15,
+	TpmOrdGetRandom = 0x46,
+	TpmOrdSelfTestFull = 0x50,
+	TpmOrdContinueSelfTest = 0x53,
+	TpmOrdGetCapability = 0x65,
+	TpmOrdStartup = 0x99,
+	TpmOrdNvReadValue = 0xcf,
+
+	TpmNvReadRequestSize = 22,
+	TpmNvReadSizeOffset = 18,
+
+	TpmRspReturnCodeOffset = 6
+};
+
+/*
+ * The contents of NV spaces don't change unless we change them, so a read
+ * of the same index, offset and size can be answered from memory for the
+ * rest of the boot. Entries hold the exact request and the response it got.
+ */
+typedef struct {
+	ListNode list_node;
+	uint8_t request[TpmNvReadRequestSize];
+	size_t response_size;
+	uint8_t response[0];
+} TpmNvCacheEntry;
+
+static ListNode tpm_nv_cache;
+static int tpm_nv_cache_entries;
+
+enum {
+	TpmNvCacheMaxEntries = 16,
+	TpmCommandZones = 16
+};
+
+// Per command latency, reported through the profiler. A boot sends enough
+// TPM commands that these stay out of the coreboot timestamp table and only
+// go in the profiler's own buffer.
+typedef struct {
+	uint32_t ordinal;
+	char name[16];
+	ProfileZone zone;
+} TpmCommandZone;
+
+static TpmCommandZone tpm_command_zones[TpmCommandZones];
+static PROFILE_ZONE(tpm_other_zone, "tpm-other");
+static PROFILE_ZONE(tpm_nv_cache_zone, "tpm-nv-cache");
+
+static uint32_t tpm_read_be32(const uint8_t *buf)
+{
+	uint32_t value;
+	memcpy(&value, buf, sizeof(value));
+	return be32toh(value);
+}
+
+static ProfileZone *tpm_command_zone(uint32_t ordinal)
+{
+	for (int i = 0; i < ARRAY_SIZE(tpm_command_zones); i++) {
+		TpmCommandZone *command = &tpm_command_zones[i];
+		if (command->zone.name && command->ordinal != ordinal)
+			continue;
+
+		if (!command->zone.name) {
+			command->ordinal = ordinal;
+			snprintf(command->name, sizeof(command->name),
+				 "tpm-%#x", ordinal);
+			command->zone.name = command->name;
+		}
+		return &command->zone;
+	}
+	return &tpm_other_zone;
+}
+
+static void tpm_nv_cache_flush(void)
+{
+	while (tpm_nv_cache.next) {
+		TpmNvCacheEntry *entry = container_of(tpm_nv_cache.next,
+			TpmNvCacheEntry, list_node);
+		list_remove(&entry->list_node);
+		free(entry);
+	}
+	tpm_nv_cache_entries = 0;
+}
+
+/*
+ * Decide whether a command can be answered from, or added to, the cache.
+ * Commands which can't change NV contents or readability are left alone,
+ * and anything else (writes, space definitions, zero sized reads which set
+ * read locks, authorized or unrecognized commands) empties the cache.
+ *
+ * Returns 1 if the command is a cacheable NV read, 0 otherwise.
+ */
+static int tpm_nv_cache_check(const uint8_t *sendbuf, size_t send_size)
+{
+	if (send_size < TpmCmdOrdinalOffset + sizeof(uint32_t)) {
+		tpm_nv_cache_flush();
+		return 0;
+	}
+
+	uint16_t tag = (sendbuf[0] << 8) | sendbuf[1];
+	uint32_t ordinal = tpm_read_be32(sendbuf + TpmCmdOrdinalOffset);
+
+	if (tag == TpmTagRquCommand) {
+		switch (ordinal) {
+		case TpmOrdNvReadValue:
+			if (send_size == TpmNvReadRequestSize &&
+			    tpm_read_be32(sendbuf + TpmNvReadSizeOffset))
+				return 1;
+			break;
+		case TpmOrdExtend:
+		case TpmOrdPcrRead:
+		case TpmOrdGetRandom:
+		case TpmOrdSelfTestFull:
+		case TpmOrdContinueSelfTest:
+		case TpmOrdGetCapability:
+		case TpmOrdStartup:
+			return 0;
+		}
+	}
+
+	tpm_nv_cache_flush();
+	return 0;
+}
+
+static TpmNvCacheEntry *tpm_nv_cache_find(const uint8_t *sendbuf)
+{
+	TpmNvCacheEntry *entry;
+	list_for_each(entry, tpm_nv_cache, list_node) {
+		if (!memcmp(entry->request, sendbuf, sizeof(entry->request)))
+			return entry;
+	}
+	return NULL;
+}
+
+static void tpm_nv_cache_add(const uint8_t *sendbuf,
+			     const uint8_t *recvbuf, size_t recv_len)
+{
+	// Only remember reads which worked.
+	if (recv_len < TpmRspReturnCodeOffset + sizeof(uint32_t) ||
+	    tpm_read_be32(recvbuf + TpmRspReturnCodeOffset))
+		return;
+
+	if (tpm_nv_cache_entries == TpmNvCacheMaxEntries)
+		tpm_nv_cache_flush();
+
+	TpmNvCacheEntry *entry = xmalloc(sizeof(*entry) + recv_len);
+	memcpy(entry->request, sendbuf, sizeof(entry->request));
+	entry->response_size = recv_len;
+	memcpy(entry->response, recvbuf, recv_len);
+	list_insert_after(&entry->list_node, &tpm_nv_cache);
+	tpm_nv_cache_entries++;
+}
+
 void tpm_set_ops(TpmOps *ops)
 {
 	die_if(tpm_ops, "%s: TPM ops already set.\n", __func__);
@@ -37,5 +206,36 @@ int tpm_xmit(const uint8_t *sendbuf, size_t send_size,
 	     uint8_t *recvbuf, size_t *recv_len)
 {
 	die_if(!tpm_ops, "%s: No TPM ops set.\n", __func__);
-	return tpm_ops->xmit(tpm_ops, sendbuf, send_size, recvbuf, recv_len);
+
+	int cacheable = 0;
+	if (CONFIG_DRIVER_TPM_NV_CACHE) {
+		cacheable = tpm_nv_cache_check(sendbuf, send_size);
+		TpmNvCacheEntry *entry =
+			cacheable ? tpm_nv_cache_find(sendbuf) : NULL;
+		if (entry && entry->response_size <= *recv_len) {
+			profile_begin(&tpm_nv_cache_zone);
+			memcpy(recvbuf, entry->response, entry->response_size);
+			*recv_len = entry->response_size;
+			profile_end(&tpm_nv_cache_zone, *recv_len);
+			return 0;
+		}
+		// Let the TPM deal with a buffer which is too small.
+		if (entry)
+			cacheable = 0;
+	}
+
+	ProfileZone *zone = &tpm_other_zone;
+	if (CONFIG_PROFILE && send_size >= TpmCmdOrdinalOffset +
+				       sizeof(uint32_t))
+		zone = tpm_command_zone(
+			tpm_read_be32(sendbuf + TpmCmdOrdinalOffset));
+
+	profile_begin(zone);
+	int ret = tpm_ops->xmit(tpm_ops, sendbuf, send_size,
+				recvbuf, recv_len);
+	profile_end(zone, ret ? 0 : send_size + *recv_len);
+
+	if (cacheable && !ret)
+		tpm_nv_cache_add(sendbuf, recvbuf, *recv_len);
+	return ret;
 }
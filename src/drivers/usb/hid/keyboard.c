@@ -51,6 +51,7 @@
 #include "base/algorithm.h"
 #include "base/keycodes.h"
 #include "base/list.h"
+#include "base/task.h"
 #include "base/xalloc.h"
 #include "drivers/bus/usb/usb.h"
 #include "drivers/keyboard/keyboard.h"
@@ -323,6 +324,8 @@ static int usb_kbd_get_char(KeyboardOps *me)
 		if (keybuffer_count(&kbd->key_buffer))
 			return keybuffer_pop(&kbd->key_buffer);
 		usb_poll();
+		if (!keybuffer_count(&kbd->key_buffer))
+			task_mdelay(KeyboardPollMs);
 	}
 }
 
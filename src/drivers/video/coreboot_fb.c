@@ -20,6 +20,7 @@
  * MA 02111-1307 USA
  */
 
+#include <cbgfx.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <sysinfo.h>
@@ -172,6 +173,9 @@ int dc_corebootfb_draw_bitmap(uint32_t x, uint32_t y, void *bitmap)
 	if (!fbaddr)
 		return -1;
 
+	/* This draws straight to the screen, behind cbgfx's back. */
+	invalidate_screen();
+
 	uint32_t header_size;
 	memcpy(&header_size, file_header + 1, sizeof(header_size));
 	switch (header_size) {
@@ -62,7 +62,8 @@ class RwArea(Area):
 class Image(Area):
     model = "Google_Samus"
 
-    def __init__(self, paths, model, size, hwid, gbb_flags=None):
+    def __init__(self, paths, model, size, hwid, gbb_flags=None,
+                 compression="lzma"):
         self.fmap = Fmap(size)
         fmap = self.fmap
 
@@ -108,7 +109,7 @@ class Image(Area):
                         Cbfs(
                             CbfsPayload(
                                 "fallback/payload", File(paths["dc_elf"])
-                            ).compression("lzma")
+                            ).compression(compression)
                         ).base(PartialFile(paths["coreboot"], 7 * MB, 1 * MB))
                     ).size(1 * MB)
                 ).expand()
@@ -163,6 +164,10 @@ def add_arguments(parser):
     parser.add_argument('--hwid', dest='hwid', required=True,
                         help='Hardware ID to put in the GBB')
 
+    parser.add_argument('--compression', dest='compression', default='lzma',
+                        choices=['lzma', 'lz4', 'none'],
+                        help='How to compress the payload in the boot stub')
+
 def prepare(options):
     gbb_flags = None
     paths = {
@@ -208,4 +213,5 @@ def prepare(options):
     hwid = options.hwid
 
     return Image(paths=paths, model=options.model, size=options.size * KB,
-                 gbb_flags=gbb_flags, hwid=hwid)
+                 gbb_flags=gbb_flags, hwid=hwid,
+                 compression=options.compression)
@@ -41,6 +41,10 @@ typedef struct {
 	 */
 	volatile portsc_t *ports;
 	int *devices;
+	/* raw timer value at which the ports have settled power */
+	uint64_t ports_ready;
+	/* set until the first poll has looked at every port */
+	int initial_scan;
 } rh_inst_t;
 
 #define RH_INST(dev) ((rh_inst_t*)(dev)->data)
@@ -98,9 +102,8 @@ ehci_rh_scanport (UsbDev *dev, int port)
 		usb_detach_device(dev->controller, RH_INST(dev)->devices[port]);
 		RH_INST(dev)->devices[port]=-1;
 	}
-	/* device connected, handle */
+	/* device connected, handle (debounced by the caller) */
 	if (RH_INST(dev)->ports[port] & P_CURR_CONN_STATUS) {
-		mdelay(100); // usb20 spec 9.1.2
 		if (!CONFIG_USB_EHCI_HOSTPC_ROOT_HUB_TT &&
 				(RH_INST(dev)->ports[port] & P_LINE_STATUS) ==
 				P_LINE_STATUS_LOWSPEED) {
@@ -152,23 +155,45 @@ ehci_rh_scanport (UsbDev *dev, int port)
 	RH_INST(dev)->ports[port] |= P_CONN_STATUS_CHANGE;
 }
 
-static int
-ehci_rh_report_port_changes (UsbDev *dev)
-{
-	int i;
-	for (i=0; i<RH_INST(dev)->n_ports; i++) {
-		if (RH_INST(dev)->ports[i] & P_CONN_STATUS_CHANGE)
-			return i;
-	}
-	return -1;
-}
-
 static void
 ehci_rh_poll (UsbDev *dev)
 {
 	int port;
-	while ((port = ehci_rh_report_port_changes (dev)) != -1)
-		ehci_rh_scanport (dev, port);
+
+	if (RH_INST(dev)->initial_scan) {
+		while (!time_deadline_expired(RH_INST(dev)->ports_ready))
+			udelay(10);
+	}
+
+	/*
+	 * Take a snapshot of the changed ports so their connections can
+	 * settle together, then scan them one by one. Anything that changes
+	 * in the meantime is picked up, and debounced, on the next round.
+	 */
+	for (;;) {
+		uint32_t changed = 0;
+		int connected = 0;
+		for (port = 0; port < RH_INST(dev)->n_ports; port++) {
+			if (RH_INST(dev)->initial_scan ||
+			    (RH_INST(dev)->ports[port] & P_CONN_STATUS_CHANGE)) {
+				changed |= 1 << port;
+				if (RH_INST(dev)->ports[port] &
+				    P_CURR_CONN_STATUS)
+					connected = 1;
+			}
+		}
+		RH_INST(dev)->initial_scan = 0;
+		if (!changed)
+			break;
+
+		if (connected)
+			mdelay(100); // usb20 spec 9.1.2
+
+		for (port = 0; port < RH_INST(dev)->n_ports; port++) {
+			if (changed & (1 << port))
+				ehci_rh_scanport (dev, port);
+		}
+	}
 }
 
 
@@ -196,14 +221,17 @@ ehci_rh_init (UsbDev *dev)
 		for (i=0; i < RH_INST(dev)->n_ports; i++)
 			RH_INST(dev)->ports[i] |= P_PP;
 	}
-	mdelay(20); // ehci spec 2.3.9
+	/*
+	 * ehci spec 2.3.9 asks for 20ms. The first poll waits out the rest of
+	 * it and scans the ports, so other controllers can come up meanwhile.
+	 */
+	RH_INST(dev)->ports_ready = time_deadline_ms(20);
+	RH_INST(dev)->initial_scan = 1;
 
 	dev->speed = UsbHighSpeed;
 	dev->address = 0;
 	dev->hub = -1;
 	dev->port = -1;
-	for (i=0; i < RH_INST(dev)->n_ports; i++) {
+	for (i=0; i < RH_INST(dev)->n_ports; i++)
 		RH_INST(dev)->devices[i] = -1;
-		ehci_rh_scanport(dev, i);
-	}
 }
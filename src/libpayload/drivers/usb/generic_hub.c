@@ -56,12 +56,18 @@ generic_hub_destroy(UsbDev *const dev)
 			hub->ops->disable_port(dev, port);
 	}
 
+	free(hub->port_state);
 	free(hub->ports);
 	free(hub);
 }
 
+/*
+ * Debounces every port in GEN_HUB_PORT_DEBOUNCE state at the same time, so
+ * a hub full of devices waits for the slowest connection to settle instead
+ * of for the sum of them. Settled ports move on to GEN_HUB_PORT_ATTACH.
+ */
 static int
-generic_hub_debounce(UsbDev *const dev, const int port)
+generic_hub_debounce(UsbDev *const dev)
 {
 	generic_hub_t *const hub = GEN_HUB(dev);
 
@@ -69,28 +75,54 @@ generic_hub_debounce(UsbDev *const dev, const int port)
 	const int at_least_ms	= 100;	/* 100ms as in usb20 spec 9.1.2 */
 	const int timeout_ms	= 1500;	/* linux uses this value */
 
-	int total_ms = 0;
-	int stable_ms = 0;
-	while (stable_ms < at_least_ms && total_ms < timeout_ms) {
-		mdelay(step_ms);
+	const uint64_t timeout = time_deadline_ms(timeout_ms);
+	int port, pending = 0;
+	for (port = 1; port <= hub->num_ports; ++port) {
+		generic_hub_port_t *const state = &hub->port_state[port];
+		if (state->state == GEN_HUB_PORT_DEBOUNCE) {
+			state->stable_at = time_deadline_ms(at_least_ms);
+			++pending;
+		}
+	}
 
-		const int changed = hub->ops->port_status_changed(dev, port);
-		const int connected = hub->ops->port_connected(dev, port);
-		if (changed < 0 || connected < 0)
-			return -1;
+	while (pending) {
+		mdelay(step_ms);
 
-		if (!changed && connected) {
-			stable_ms += step_ms;
-		} else {
-			usb_debug("generic_hub: Unstable connection at %d\n",
-				  port);
-			stable_ms = 0;
+		const int timed_out = time_deadline_expired(timeout);
+		for (port = 1; port <= hub->num_ports; ++port) {
+			generic_hub_port_t *const state =
+				&hub->port_state[port];
+			if (state->state != GEN_HUB_PORT_DEBOUNCE)
+				continue;
+
+			const int changed =
+				hub->ops->port_status_changed(dev, port);
+			const int connected =
+				hub->ops->port_connected(dev, port);
+			if (changed < 0 || connected < 0)
+				return -1;
+
+			if (changed || !connected) {
+				usb_debug("generic_hub: Unstable connection "
+					  "at %d\n", port);
+				state->stable_at =
+					time_deadline_ms(at_least_ms);
+			} else if (time_deadline_expired(state->stable_at)) {
+				state->state = GEN_HUB_PORT_ATTACH;
+				--pending;
+				continue;
+			}
+
+			/* ignore timeouts, try to always go on */
+			if (timed_out) {
+				usb_debug("generic_hub: Debouncing timed out "
+					  "at %d\n", port);
+				state->state = GEN_HUB_PORT_ATTACH;
+				--pending;
+			}
 		}
-		total_ms += step_ms;
 	}
-	if (total_ms >= timeout_ms)
-		usb_debug("generic_hub: Debouncing timed out at %d\n", port);
-	return 0; /* ignore timeouts, try to always go on */
+	return 0;
 }
 
 int
@@ -151,9 +183,6 @@ generic_hub_attach_dev(UsbDev *const dev, const int port)
 {
 	generic_hub_t *const hub = GEN_HUB(dev);
 
-	if (generic_hub_debounce(dev, port) < 0)
-		return -1;
-
 	if (hub->ops->reset_port) {
 		if (hub->ops->reset_port(dev, port) < 0)
 			return -1;
@@ -180,8 +209,12 @@ generic_hub_attach_dev(UsbDev *const dev, const int port)
 	return 0;
 }
 
-int
-generic_hub_scanport(UsbDev *const dev, const int port)
+/*
+ * Detaches whatever was at the port and queues it for debouncing if
+ * something is connected now.
+ */
+static int
+generic_hub_queue_port(UsbDev *const dev, const int port)
 {
 	generic_hub_t *const hub = GEN_HUB(dev);
 
@@ -195,13 +228,50 @@ generic_hub_scanport(UsbDev *const dev, const int port)
 
 	if (hub->ops->port_connected(dev, port)) {
 		usb_debug("generic_hub: Attachment at port %d\n", port);
-
-		return generic_hub_attach_dev(dev, port);
+		hub->port_state[port].state = GEN_HUB_PORT_DEBOUNCE;
 	}
 
 	return 0;
 }
 
+/*
+ * Brings up all queued ports. Debouncing runs for all of them at once.
+ * Resets and address assignment stay one port at a time, because every
+ * freshly reset device answers to address 0 until it gets its own.
+ */
+static int
+generic_hub_enumerate(UsbDev *const dev)
+{
+	generic_hub_t *const hub = GEN_HUB(dev);
+	int port, ret;
+
+	/* wait for whatever is left of the power on delay */
+	if (hub->ops->enable_port) {
+		while (!time_deadline_expired(hub->ports_ready))
+			udelay(10);
+	}
+
+	ret = generic_hub_debounce(dev);
+	for (port = 1; port <= hub->num_ports; ++port) {
+		const int attach = hub->port_state[port].state ==
+				   GEN_HUB_PORT_ATTACH;
+		hub->port_state[port].state = GEN_HUB_PORT_IDLE;
+		if (ret >= 0 && attach)
+			ret = generic_hub_attach_dev(dev, port);
+	}
+	return ret;
+}
+
+int
+generic_hub_scanport(UsbDev *const dev, const int port)
+{
+	const int ret = generic_hub_queue_port(dev, port);
+	if (ret < 0)
+		return ret;
+
+	return generic_hub_enumerate(dev);
+}
+
 static void
 generic_hub_poll(UsbDev *const dev)
 {
@@ -217,13 +287,16 @@ generic_hub_poll(UsbDev *const dev)
 	for (port = 1; port <= hub->num_ports; ++port) {
 		const int ret = hub->ops->port_status_changed(dev, port);
 		if (ret < 0) {
-			return;
+			break;
 		} else if (ret == 1) {
 			usb_debug("generic_hub: Port change at %d\n", port);
-			if (generic_hub_scanport(dev, port) < 0)
-				return;
+			if (generic_hub_queue_port(dev, port) < 0)
+				break;
 		}
 	}
+
+	/* also brings ports queued before an error back to idle */
+	generic_hub_enumerate(dev);
 }
 
 int
@@ -243,9 +316,12 @@ generic_hub_init(UsbDev *const dev, const int num_ports,
 	generic_hub_t *const hub = GEN_HUB(dev);
 	hub->num_ports = num_ports;
 	hub->ports = malloc(sizeof(*hub->ports) * (num_ports + 1));
+	hub->port_state = calloc(num_ports + 1, sizeof(*hub->port_state));
 	hub->ops = ops;
-	if (!hub->ports) {
+	if (!hub->ports || !hub->port_state) {
 		usb_debug("generic_hub: ERROR: Out of memory\n");
+		free(hub->port_state);
+		free(hub->ports);
 		free(dev->data);
 		dev->data = NULL;
 		return -1;
@@ -257,8 +333,11 @@ generic_hub_init(UsbDev *const dev, const int num_ports,
 	if (ops->enable_port) {
 		for (port = 1; port <= num_ports; ++port)
 			ops->enable_port(dev, port);
-		/* wait once for all ports */
-		mdelay(20);
+		/*
+		 * wait once for all ports, but only when they are first
+		 * scanned so that other controllers can come up meanwhile
+		 */
+		hub->ports_ready = time_deadline_ms(20);
 	}
 
 	return 0;
@@ -57,12 +57,28 @@ typedef struct generic_hub_ops {
 	int (*reset_port)(UsbDev *, int port);
 } generic_hub_ops_t;
 
+typedef enum {
+	GEN_HUB_PORT_IDLE,
+	GEN_HUB_PORT_DEBOUNCE,	/* waiting for the connection to settle */
+	GEN_HUB_PORT_ATTACH,	/* settled, waiting for reset and attach */
+} generic_hub_port_state_t;
+
+typedef struct generic_hub_port {
+	generic_hub_port_state_t state;
+	/* raw timer value at which a debouncing port counts as stable */
+	uint64_t stable_at;
+} generic_hub_port_t;
+
 typedef struct generic_hub {
 	int num_ports;
 	/* port numbers are always 1 based,
 	   so we waste one int for convenience */
 	int *ports; /* allocated to sizeof(*ports)*(num_ports+1) */
 #define NO_DEV -1
+	/* enumeration state, indexed like ports[] */
+	generic_hub_port_t *port_state;
+	/* raw timer value at which enabled ports have settled power */
+	uint64_t ports_ready;
 
 	const generic_hub_ops_t *ops;
 
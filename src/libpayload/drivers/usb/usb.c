@@ -83,10 +83,18 @@ void usb_poll(void)
 		return;
 	UsbDevHc *controller = usb_hcs;
 	while (controller != NULL) {
-		for (int i = 0; i < 128; i++) {
-			if (controller->devices[i] != 0) {
-				controller->devices[i]->poll(
-					controller->devices[i]);
+		for (int word = 0; word < ARRAY_SIZE(controller->attached);
+		     word++) {
+			// Devices may come and go while we poll, so reread the
+			// bitmap and check each slot before using it.
+			uint32_t pending = controller->attached[word];
+			while (pending) {
+				int i = word * 32 + __builtin_ctz(pending);
+				pending &= pending - 1;
+				if (controller->devices[i] != 0) {
+					controller->devices[i]->poll(
+						controller->devices[i]);
+				}
 			}
 		}
 		controller = controller->next;
@@ -103,6 +111,7 @@ UsbDev *init_device_entry(UsbDevHc *controller, int i)
 	if (controller->devices[i] != 0)
 		usb_debug("warning: device %d reassigned?\n", i);
 	controller->devices[i] = dev;
+	controller->attached[i / 32] |= 1U << (i % 32);
 	dev->controller = controller;
 	dev->address = -1;
 	dev->hub = -1;
@@ -620,6 +629,7 @@ void usb_detach_device(UsbDevHc *controller, int devno)
 		// has had a chance to interoogate it.
 		free(controller->devices[devno]);
 		controller->devices[devno] = NULL;
+		controller->attached[devno / 32] &= ~(1U << (devno % 32));
 	}
 }
 
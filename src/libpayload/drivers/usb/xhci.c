@@ -132,8 +132,12 @@ xhci_switchback_ppt_ports(pcidev_t addr)
 static long
 xhci_handshake(volatile uint32_t *const reg, uint32_t mask, uint32_t wait_for, long timeout_us)
 {
-	while ((*reg & mask) != wait_for && timeout_us--) udelay(1);
-	return timeout_us;
+	const uint64_t deadline = time_deadline_us(timeout_us);
+	while ((*reg & mask) != wait_for) {
+		if (time_deadline_expired(deadline))
+			return 0;
+	}
+	return 1;
 }
 
 static int
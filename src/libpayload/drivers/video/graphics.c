@@ -3,10 +3,14 @@
  */
 
 #include <cbgfx.h>
+#include <endian.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sysinfo.h>
 #include "bitmap.h"
 
+#include "base/algorithm.h"
 #include "base/cbfs/cbfs.h"
 
 /*
@@ -20,16 +24,37 @@ static struct rect screen;
 
 /*
  * Framebuffer is assumed to assign a higher coordinate (larger x, y) to
- * a higher address
+ * a higher address. fbaddr is where drawing goes: either the framebuffer
+ * itself or, with CONFIG_CBGFX_SHADOW_FRAMEBUFFER, a copy of it in cached
+ * memory which is written out to screen_addr when a frame is flushed.
  */
 static struct cb_framebuffer *fbinfo;
 static uint8_t *fbaddr;
+static uint8_t *screen_addr;
+
+/*
+ * Shadow framebuffer state. The damage rectangle bounds what's been drawn
+ * since the last flush. row_hash remembers what each row looked like when it
+ * was last written out, so rows which were redrawn the same (a screen cleared
+ * and drawn again with only its text changed, say) aren't copied again. Until
+ * row_hash_valid is set, the damage covers the whole screen.
+ */
+static struct {
+	int enabled;
+	int frame_depth;
+	int row_hash_valid;
+	uint64_t *row_hash;
+	struct vector damage_start;
+	struct vector damage_end;
+} shadow;
 
 #define LOG(x...)	printf("CBGFX: " x)
 #define PIVOT_H_MASK	(PIVOT_H_LEFT|PIVOT_H_CENTER|PIVOT_H_RIGHT)
 #define PIVOT_V_MASK	(PIVOT_V_TOP|PIVOT_V_CENTER|PIVOT_V_BOTTOM)
 #define ROUNDUP(x, y)	((((x) + ((y) - 1)) / (y)) * (y))
 #define ABS(x)		((x) < 0 ? -(x) : (x))
+#define FILL_CHUNK	64
+#define ROW_HASH_PRIME	0x100000001b3ULL
 
 static char initialized = 0;
 
@@ -109,6 +134,315 @@ static inline void set_pixel(struct vector *coord, uint32_t color)
 		pixel[i] = (color >> (i * 8));
 }
 
+/*
+ * Whole rows are written at once when every pixel is a whole number of bytes.
+ * A row is built in the framebuffer's own format and goes out with a single
+ * memcpy or memset, so the address math and the byte loop in set_pixel are
+ * only paid for on odd depths.
+ */
+static inline int fb_is_linear(void)
+{
+	const int bpp = fbinfo->bits_per_pixel;
+	return bpp > 0 && bpp <= 32 && bpp % 8 == 0;
+}
+
+static inline uint8_t *pixel_address(const struct vector *coord)
+{
+	return fbaddr + (coord->x + coord->y * fbinfo->x_resolution) *
+			fbinfo->bits_per_pixel / 8;
+}
+
+/* Store one pixel of a known size, in the same byte order as set_pixel. */
+static inline __attribute__((always_inline))
+void store_pixel(uint8_t *dst, uint32_t color, const int bytes)
+{
+	int i;
+
+	switch (bytes) {
+	case 4:
+		*(uint32_t *)dst = htole32(color);
+		break;
+	case 2:
+		*(uint16_t *)dst = htole16(color);
+		break;
+	default:
+		for (i = 0; i < bytes; i++)
+			dst[i] = color >> (i * 8);
+	}
+}
+
+static inline __attribute__((always_inline))
+void pack_pixels(uint8_t *dst, const uint32_t *colors, int count,
+		 const int bytes)
+{
+	for (; count > 0; count--, dst += bytes)
+		store_pixel(dst, *colors++, bytes);
+}
+
+/*
+ * Convert a run of colors into framebuffer pixels. The common depths get
+ * their own copy of the loop with the pixel size known at compile time.
+ */
+static void pack_row(uint8_t *dst, const uint32_t *colors, int count)
+{
+	switch (fbinfo->bits_per_pixel) {
+	case 32:
+		pack_pixels(dst, colors, count, 4);
+		break;
+	case 24:
+		pack_pixels(dst, colors, count, 3);
+		break;
+	case 16:
+		pack_pixels(dst, colors, count, 2);
+		break;
+	default:
+		pack_pixels(dst, colors, count, fbinfo->bits_per_pixel / 8);
+	}
+}
+
+/* Returns 1 if every byte of a pixel of this color is the same. */
+static int is_byte_pattern(uint32_t color, int bytes)
+{
+	const uint32_t mask = bytes == 4 ? ~0U : (1U << (bytes * 8)) - 1;
+	return !((color ^ (color & 0xff) * 0x01010101) & mask);
+}
+
+/*
+ * Fill count pixels starting at start. The run may wrap onto the following
+ * rows, which is how clear_screen covers the whole framebuffer in one go.
+ */
+static void fill_row(const struct vector *start, int count, uint32_t color)
+{
+	const int bytes = fbinfo->bits_per_pixel / 8;
+	uint32_t colors[FILL_CHUNK];
+	uint8_t pattern[FILL_CHUNK * sizeof(uint32_t)]
+		__attribute__((aligned(sizeof(uint32_t))));
+	struct vector p;
+	uint8_t *dst;
+	int i, n;
+
+	if (count <= 0)
+		return;
+
+	if (!fb_is_linear()) {
+		p = *start;
+		for (; count > 0; count--, p.x++)
+			set_pixel(&p, color);
+		return;
+	}
+
+	dst = pixel_address(start);
+	if (is_byte_pattern(color, bytes)) {
+		memset(dst, color & 0xff, count * bytes);
+		return;
+	}
+
+	n = MIN(count, FILL_CHUNK);
+	for (i = 0; i < n; i++)
+		colors[i] = color;
+	pack_row(pattern, colors, n);
+	while (count > 0) {
+		n = MIN(count, FILL_CHUNK);
+		memcpy(dst, pattern, n * bytes);
+		dst += n * bytes;
+		count -= n;
+	}
+}
+
+/*
+ * Write a row of colors starting at start. line is scratch space big enough
+ * for count pixels at the framebuffer's depth.
+ */
+static void write_row(const struct vector *start, const uint32_t *colors,
+		      uint8_t *line, int count)
+{
+	struct vector p;
+	int i;
+
+	if (count <= 0)
+		return;
+
+	if (!fb_is_linear()) {
+		p = *start;
+		for (i = 0; i < count; i++, p.x++)
+			set_pixel(&p, colors[i]);
+		return;
+	}
+
+	pack_row(line, colors, count);
+	memcpy(pixel_address(start), line,
+	       count * fbinfo->bits_per_pixel / 8);
+}
+
+/*
+ * Bytes per pixel of a rendered_bitmap. Framebuffers which write_row can't
+ * copy to directly keep the colors as they are and go through set_pixel.
+ */
+static inline int rendered_bytes(void)
+{
+	return fb_is_linear() ? fbinfo->bits_per_pixel / 8 : sizeof(uint32_t);
+}
+
+/*
+ * Write a row of colors either to the framebuffer or, if rendered is set, to
+ * the row of the image which start points at.
+ */
+static void output_row(struct rendered_bitmap *rendered,
+		       const struct vector *start, const uint32_t *colors,
+		       uint8_t *line, int count)
+{
+	uint8_t *dst;
+
+	if (!rendered) {
+		write_row(start, colors, line, count);
+		return;
+	}
+
+	dst = rendered->pixels +
+		(start->x + start->y * rendered->dim.width) * rendered_bytes();
+	if (fb_is_linear())
+		pack_row(dst, colors, count);
+	else
+		memcpy(dst, colors, count * sizeof(*colors));
+}
+
+static inline size_t fb_size(void)
+{
+	return ((size_t)fbinfo->x_resolution * fbinfo->y_resolution *
+		fbinfo->bits_per_pixel + 7) / 8;
+}
+
+static void mark_damage(const struct vector *top_left,
+			const struct vector *size)
+{
+	if (!shadow.enabled || size->width <= 0 || size->height <= 0)
+		return;
+
+	if (shadow.damage_end.x <= shadow.damage_start.x ||
+	    shadow.damage_end.y <= shadow.damage_start.y) {
+		shadow.damage_start = *top_left;
+		add_vectors(&shadow.damage_end, top_left, size);
+		return;
+	}
+
+	shadow.damage_start.x = MIN(shadow.damage_start.x, top_left->x);
+	shadow.damage_start.y = MIN(shadow.damage_start.y, top_left->y);
+	shadow.damage_end.x = MAX(shadow.damage_end.x,
+				  top_left->x + size->width);
+	shadow.damage_end.y = MAX(shadow.damage_end.y,
+				  top_left->y + size->height);
+}
+
+static void damage_screen(void)
+{
+	mark_damage(&screen.offset, &screen.size);
+}
+
+static uint64_t hash_row(const uint8_t *row, size_t size)
+{
+	const uint32_t *words = (const uint32_t *)row;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	size_t i;
+
+	for (i = 0; i < size / sizeof(*words); i++)
+		hash = (hash ^ words[i]) * ROW_HASH_PRIME;
+	for (i = size & ~(sizeof(*words) - 1); i < size; i++)
+		hash = (hash ^ row[i]) * ROW_HASH_PRIME;
+	return hash;
+}
+
+/*
+ * Copy to the framebuffer. It's uncached or write-combined and never read
+ * back, so on x86 the copy uses non-temporal stores instead of dragging it
+ * through the cache. Elsewhere the architecture's memcpy already does wide
+ * stores.
+ */
+static void copy_to_screen(uint8_t *dst, const uint8_t *src, size_t size)
+{
+#if CONFIG_ARCH_X86
+	/* The shadow has the same layout, so src is aligned along with dst. */
+	for (; size && ((uintptr_t)dst & 3); size--)
+		*dst++ = *src++;
+	for (; size >= 4; size -= 4, dst += 4, src += 4)
+		__asm__ __volatile__("movnti %1, %0"
+				     : "=m"(*(uint32_t *)dst)
+				     : "r"(*(const uint32_t *)src));
+	for (; size; size--)
+		*dst++ = *src++;
+#else
+	memcpy(dst, src, size);
+#endif
+}
+
+/* Write out everything drawn since the last flush which actually changed. */
+static void flush_damage(void)
+{
+	const int bpp = fbinfo->bits_per_pixel;
+	const size_t stride = (size_t)fbinfo->x_resolution * bpp / 8;
+	struct vector start = shadow.damage_start;
+	struct vector end = shadow.damage_end;
+	size_t offset, size;
+	int32_t y;
+
+	if (end.x <= start.x || end.y <= start.y)
+		return;
+	shadow.damage_end = shadow.damage_start;
+
+	if (!fb_is_linear()) {
+		/* Rows don't start on byte boundaries; copy them whole. */
+		offset = (size_t)start.y * fbinfo->x_resolution * bpp / 8;
+		size = ((size_t)end.y * fbinfo->x_resolution * bpp + 7) / 8 -
+			offset;
+		copy_to_screen(screen_addr + offset, fbaddr + offset, size);
+	} else {
+		for (y = start.y; y < end.y; y++) {
+			const uint8_t *row = fbaddr + y * stride;
+			const uint64_t hash = hash_row(row, stride);
+
+			if (shadow.row_hash_valid && shadow.row_hash[y] == hash)
+				continue;
+			shadow.row_hash[y] = hash;
+			offset = y * stride + start.x * bpp / 8;
+			copy_to_screen(screen_addr + offset, fbaddr + offset,
+				       (end.x - start.x) * bpp / 8);
+		}
+		shadow.row_hash_valid = 1;
+	}
+
+#if CONFIG_ARCH_X86
+	/* Make sure the non-temporal stores are out before we go on. */
+	__asm__ __volatile__("sfence" : : : "memory");
+#endif
+}
+
+/* Outside of a frame, every drawing call goes to the screen right away. */
+static void flush_if_idle(void)
+{
+	if (shadow.enabled && !shadow.frame_depth)
+		flush_damage();
+}
+
+static void shadow_init(void)
+{
+	uint8_t *pixels;
+
+	pixels = malloc(fb_size());
+	shadow.row_hash = malloc(fbinfo->y_resolution *
+				 sizeof(*shadow.row_hash));
+	if (!pixels || !shadow.row_hash) {
+		LOG("No memory for a shadow framebuffer, drawing directly\n");
+		free(pixels);
+		free(shadow.row_hash);
+		return;
+	}
+
+	/* Start from what's already on the screen. */
+	memcpy(pixels, screen_addr, fb_size());
+	fbaddr = pixels;
+	shadow.enabled = 1;
+	damage_screen();
+}
+
 /*
  * Initializes the library. Automatically called by APIs. It sets up
  * the canvas and the framebuffer.
@@ -122,9 +456,10 @@ static int cbgfx_init(void)
 	if (!fbinfo)
 		return -1;
 
-	fbaddr = (uint8_t *)(uintptr_t)fbinfo->physical_address;
-	if (!fbaddr)
+	screen_addr = (uint8_t *)(uintptr_t)fbinfo->physical_address;
+	if (!screen_addr)
 		return -1;
+	fbaddr = screen_addr;
 
 	screen.size.width = fbinfo->x_resolution;
 	screen.size.height = fbinfo->y_resolution;
@@ -141,6 +476,9 @@ static int cbgfx_init(void)
 	canvas.offset.x = (screen.size.width - canvas.size.width) / 2;
 	canvas.offset.y = 0;
 
+	if (CONFIG_CBGFX_SHADOW_FRAMEBUFFER)
+		shadow_init();
+
 	initialized = 1;
 	LOG("cbgfx initialized: screen:width=%d, height=%d, offset=%d canvas:width=%d, height=%d, offset=%d\n",
 	    screen.size.width, screen.size.height, screen.offset.x,
@@ -175,9 +513,11 @@ int draw_box(const struct rect *box, const struct rgb_color *rgb)
 		return CBGFX_ERROR_BOUNDARY;
 	}
 
+	mark_damage(&top_left, &size);
+	p.x = top_left.x;
 	for (p.y = top_left.y; p.y < t.y; p.y++)
-		for (p.x = top_left.x; p.x < t.x; p.x++)
-			set_pixel(&p, color);
+		fill_row(&p, t.x - top_left.x, color);
+	flush_if_idle();
 
 	return CBGFX_SUCCESS;
 }
@@ -207,9 +547,10 @@ int clear_screen(const struct rgb_color *rgb)
 		return CBGFX_ERROR_INIT;
 
 	color = calculate_color(rgb);
-	for (p.y = 0; p.y < screen.size.height; p.y++)
-		for (p.x = 0; p.x < screen.size.width; p.x++)
-			set_pixel(&p, color);
+	damage_screen();
+	p = vzero;
+	fill_row(&p, screen.size.width * screen.size.height, color);
+	flush_if_idle();
 
 	return CBGFX_SUCCESS;
 }
@@ -235,7 +576,8 @@ static int draw_bitmap_v3(const struct vector *top_left,
 			  const struct vector *dim_org,
 			  const struct bitmap_header_v3 *header,
 			  const struct bitmap_palette_element_v3 *pal,
-			  const uint8_t *pixel_array)
+			  const uint8_t *pixel_array,
+			  struct rendered_bitmap *rendered)
 {
 	const int bpp = header->bits_per_pixel;
 	int32_t dir;
@@ -257,6 +599,8 @@ static int draw_bitmap_v3(const struct vector *top_left,
 		LOG("Scaling out of range\n");
 		return CBGFX_ERROR_SCALE_OUT_OF_RANGE;
 	}
+	if (dim->width <= 0 || dim->height <= 0)
+		return CBGFX_SUCCESS;
 
 	const int32_t y_stride = ROUNDUP(dim_org->width * bpp / 8, 4);
 	/*
@@ -275,10 +619,55 @@ static int draw_bitmap_v3(const struct vector *top_left,
 		p.y += dim->height - 1;
 		dir = -1;
 	}
+	/*
+	 * Where each column samples the bitmap only depends on d.x, so work it
+	 * out once instead of once per row. The palette is also converted to
+	 * framebuffer colors up front; pixels that land exactly on a source
+	 * pixel (every pixel when drawn unscaled) take their color straight
+	 * from it instead of going through the interpolation.
+	 */
+	struct bitmap_column {
+		int32_t s0;
+		int32_t s1;
+		int32_t tx;
+	} *columns;
+	uint32_t palette_color[256];
+	uint32_t *colors;
+	uint8_t *line;
+	int32_t i;
+
+	columns = malloc(dim->width * (sizeof(*columns) + 2 * sizeof(*colors)));
+	if (!columns) {
+		LOG("Failed to allocate scanline buffers\n");
+		return CBGFX_ERROR_UNKNOWN;
+	}
+	colors = (uint32_t *)(columns + dim->width);
+	line = (uint8_t *)(colors + dim->width);
+
+	for (i = 0; i < dim->width; i++) {
+		columns[i].s0 = i * scale->x.d / scale->x.n;
+		columns[i].s1 = columns[i].s0;
+		if (columns[i].s1 + 1 < dim_org->width)
+			columns[i].s1++;
+		columns[i].tx = (i * scale->x.d) % scale->x.n;
+	}
+
+	const int32_t palette_count = MIN(header->colors_used,
+					  ARRAY_SIZE(palette_color));
+	for (i = 0; i < palette_count; i++) {
+		const struct rgb_color rgb = {
+			.red = pal[i].red,
+			.green = pal[i].green,
+			.blue = pal[i].blue,
+		};
+		palette_color[i] = calculate_color(&rgb);
+	}
+
 	/*
 	 * Plot pixels scaled by the bilinear interpolation. We scan over the
 	 * image on canvas (using d) and find the corresponding pixel in the
-	 * bitmap data (using s0, s1).
+	 * bitmap data (using s0, s1). Each row is rendered into colors and
+	 * then written to the framebuffer in one go.
 	 *
 	 * When d hits the right bottom corner, s0 also hits the right bottom
 	 * corner of the pixel array because that's how scale->x and scale->y
@@ -288,6 +677,8 @@ static int draw_bitmap_v3(const struct vector *top_left,
 	 */
 	struct vector s0, s1, d;
 	struct fraction tx, ty;
+	tx.d = scale->x.n;
+	p.x = top_left->x;
 	for (d.y = 0; d.y < dim->height; d.y++, p.y += dir) {
 		s0.y = d.y * scale->y.d / scale->y.n;
 		s1.y = s0.y;
@@ -297,25 +688,27 @@ static int draw_bitmap_v3(const struct vector *top_left,
 		ty.n = (d.y * scale->y.d) % scale->y.n;
 		const uint8_t *data0 = pixel_array + s0.y * y_stride;
 		const uint8_t *data1 = pixel_array + s1.y * y_stride;
-		p.x = top_left->x;
-		for (d.x = 0; d.x < dim->width; d.x++, p.x++) {
-			s0.x = d.x * scale->x.d / scale->x.n;
-			s1.x = s0.x;
-			if (s1.x + 1 < dim_org->width)
-				s1.x++;
-			tx.d = scale->x.n;
-			tx.n = (d.x * scale->x.d) % scale->x.n;
-			uint8_t c00 = data0[s0.x];
-			uint8_t c10 = data0[s1.x];
-			uint8_t c01 = data1[s0.x];
-			uint8_t c11 = data1[s1.x];
+		for (d.x = 0; d.x < dim->width; d.x++) {
+			const struct bitmap_column *col = &columns[d.x];
+			uint8_t c00 = data0[col->s0];
+			uint8_t c10 = data0[col->s1];
+			uint8_t c01 = data1[col->s0];
+			uint8_t c11 = data1[col->s1];
 			if (c00 >= header->colors_used
 					|| c10 >= header->colors_used
 					|| c01 >= header->colors_used
 					|| c11 >= header->colors_used) {
+				/* Leave the row drawn up to the bad pixel. */
+				output_row(rendered, &p, colors, line, d.x);
+				free(columns);
 				LOG("Color index exceeds palette boundary\n");
 				return CBGFX_ERROR_BITMAP_DATA;
 			}
+			if (!col->tx && !ty.n) {
+				colors[d.x] = palette_color[c00];
+				continue;
+			}
+			tx.n = col->tx;
 			const struct rgb_color rgb = {
 				.red = bli(pal[c00].red, pal[c10].red,
 					   pal[c01].red, pal[c11].red,
@@ -327,10 +720,12 @@ static int draw_bitmap_v3(const struct vector *top_left,
 					    pal[c01].blue, pal[c11].blue,
 					    &tx, &ty),
 			};
-			set_pixel(&p, calculate_color(&rgb));
+			colors[d.x] = calculate_color(&rgb);
 		}
+		output_row(rendered, &p, colors, line, dim->width);
 	}
 
+	free(columns);
 	return CBGFX_SUCCESS;
 }
 
@@ -559,8 +954,12 @@ int draw_bitmap(const void *bitmap, size_t size,
 		return rv;
 	}
 
-	return draw_bitmap_v3(&top_left, &scale, &dim, &dim_org,
-			      &header, palette, pixel_array);
+	mark_damage(&top_left, &dim);
+	rv = draw_bitmap_v3(&top_left, &scale, &dim, &dim_org,
+			    &header, palette, pixel_array, NULL);
+	flush_if_idle();
+
+	return rv;
 }
 
 int draw_bitmap_direct(const void *bitmap, size_t size,
@@ -594,8 +993,12 @@ int draw_bitmap_direct(const void *bitmap, size_t size,
 		return rv;
 	}
 
-	return draw_bitmap_v3(top_left, &scale, &dim, &dim,
-			      &header, palette, pixel_array);
+	mark_damage(top_left, &dim);
+	rv = draw_bitmap_v3(top_left, &scale, &dim, &dim,
+			    &header, palette, pixel_array, NULL);
+	flush_if_idle();
+
+	return rv;
 }
 
 int get_bitmap_dimension(const void *bitmap, size_t sz, struct scale *dim_rel)
@@ -628,3 +1031,142 @@ int get_bitmap_dimension(const void *bitmap, size_t sz, struct scale *dim_rel)
 
 	return CBGFX_SUCCESS;
 }
+
+int render_bitmap(const void *bitmap, size_t size,
+		  const struct scale *dim_rel,
+		  struct rendered_bitmap **rendered)
+{
+	struct bitmap_header_v3 header;
+	const struct bitmap_palette_element_v3 *palette;
+	const uint8_t *pixel_array;
+	struct rendered_bitmap *r;
+	struct vector dim, dim_org;
+	struct scale scale;
+	size_t pixels_size;
+	int rv;
+
+	if (cbgfx_init())
+		return CBGFX_ERROR_INIT;
+
+	/* Only v3 is supported now */
+	rv = parse_bitmap_header_v3(bitmap, size,
+				    &header, &palette, &pixel_array, &dim_org);
+	if (rv)
+		return rv;
+
+	/* Calculate height and width of the image */
+	rv = calculate_dimension(&dim_org, dim_rel, &dim);
+	if (rv)
+		return rv;
+	if (dim.width < 0 || dim.height < 0)
+		return CBGFX_ERROR_INVALID_PARAMETER;
+
+	/* Calculate self scale */
+	scale.x.n = dim.width;
+	scale.x.d = dim_org.width;
+	scale.y.n = dim.height;
+	scale.y.d = dim_org.height;
+
+	pixels_size = (size_t)dim.width * dim.height * rendered_bytes();
+	r = malloc(sizeof(*r) + pixels_size);
+	if (!r) {
+		LOG("Failed to allocate rendered bitmap\n");
+		return CBGFX_ERROR_UNKNOWN;
+	}
+	r->dim = dim;
+	r->size = sizeof(*r) + pixels_size;
+
+	rv = draw_bitmap_v3(&vzero, &scale, &dim, &dim_org,
+			    &header, palette, pixel_array, r);
+	if (rv) {
+		free(r);
+		return rv;
+	}
+
+	*rendered = r;
+	return CBGFX_SUCCESS;
+}
+
+int draw_rendered_bitmap(const struct rendered_bitmap *rendered,
+			 const struct scale *pos_rel, uint8_t pivot)
+{
+	const int bytes = rendered_bytes();
+	const int32_t stride = rendered->dim.width * bytes;
+	const uint8_t *row = rendered->pixels;
+	struct vector top_left, p;
+	int rv;
+
+	if (cbgfx_init())
+		return CBGFX_ERROR_INIT;
+
+	/* Calculate coordinate */
+	rv = caclcuate_position(&rendered->dim, pos_rel, pivot, &top_left);
+	if (rv)
+		return rv;
+
+	rv = check_boundary(&top_left, &rendered->dim, &canvas);
+	if (rv) {
+		LOG("Bitmap image exceeds canvas boundary\n");
+		return rv;
+	}
+
+	mark_damage(&top_left, &rendered->dim);
+	p = top_left;
+	for (; p.y < top_left.y + rendered->dim.height; p.y++, row += stride) {
+		if (fb_is_linear())
+			memcpy(pixel_address(&p), row, stride);
+		else
+			write_row(&p, (const uint32_t *)row, NULL,
+				  rendered->dim.width);
+	}
+	flush_if_idle();
+
+	return CBGFX_SUCCESS;
+}
+
+int get_rendered_dimension(const struct rendered_bitmap *rendered,
+			   struct scale *dim_rel)
+{
+	if (cbgfx_init())
+		return CBGFX_ERROR_INIT;
+
+	/* Calculate size relative to the canvas */
+	dim_rel->x.n = rendered->dim.width;
+	dim_rel->x.d = canvas.size.width;
+	dim_rel->y.n = rendered->dim.height;
+	dim_rel->y.d = canvas.size.height;
+
+	return CBGFX_SUCCESS;
+}
+
+int begin_frame(void)
+{
+	if (cbgfx_init())
+		return CBGFX_ERROR_INIT;
+
+	shadow.frame_depth++;
+	return CBGFX_SUCCESS;
+}
+
+int end_frame(void)
+{
+	if (cbgfx_init())
+		return CBGFX_ERROR_INIT;
+
+	if (shadow.frame_depth > 0)
+		shadow.frame_depth--;
+	flush_if_idle();
+	return CBGFX_SUCCESS;
+}
+
+void invalidate_screen(void)
+{
+	/*
+	 * Whatever was written underneath us isn't in the shadow, so nothing
+	 * on the screen can be trusted to match it any more.
+	 */
+	if (!shadow.enabled)
+		return;
+	shadow.row_hash_valid = 0;
+	damage_screen();
+}
@@ -25,6 +25,7 @@
  * SUCH DAMAGE.
  */
 
+#include <cbgfx.h>
 #include <libpayload.h>
 #include <stdio.h>
 #include <video_console.h>
@@ -91,8 +92,10 @@ void video_console_cursor_enable(int state)
 
 void video_console_clear(void)
 {
-	if (console)
+	if (console) {
 		console->clear();
+		invalidate_screen();
+	}
 
 	cursorx = 0;
 	cursory = 0;
@@ -103,8 +106,10 @@ void video_console_clear(void)
 
 void video_console_putc(uint8_t row, uint8_t col, unsigned int ch)
 {
-	if (console)
+	if (console) {
 		console->putc(row, col, ch);
+		invalidate_screen();
+	}
 }
 
 void video_console_putchar(unsigned int ch)
@@ -112,6 +117,8 @@ void video_console_putchar(unsigned int ch)
 	if (!console)
 		return;
 
+	invalidate_screen();
+
 	/* replace black-on-black with light-gray-on-black.
 	 * do it here, instead of in libc/console.c
 	 */
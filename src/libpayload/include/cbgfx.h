@@ -153,3 +153,86 @@ int draw_bitmap_direct(const void *bitmap, size_t size,
  * in the original size are returned.
  */
 int get_bitmap_dimension(const void *bitmap, size_t sz, struct scale *dim_rel);
+
+/*
+ * A bitmap which has already been scaled and converted to the framebuffer's
+ * pixel format. Drawing it again only copies rows, so callers can keep these
+ * around for images they draw repeatedly. It's a single allocation which is
+ * released with free().
+ */
+struct rendered_bitmap {
+	struct vector dim;	/* width and height in pixels */
+	size_t size;		/* size of the whole allocation in bytes */
+	uint8_t pixels[];	/* rows from top to bottom */
+};
+
+/**
+ * Scale a bitmap and convert it to framebuffer pixels without drawing it
+ *
+ * @param[in] bitmap	Pointer to the bitmap data, starting from file header
+ * @param[in] size	Size of the bitmap data
+ * @param[in] dim_rel	Width and height of the image relative to the canvas,
+ *                      as with draw_bitmap.
+ * @param[out] rendered	On success, points to the newly allocated image.
+ *
+ * @return CBGFX_* error codes
+ */
+int render_bitmap(const void *bitmap, size_t size,
+		  const struct scale *dim_rel,
+		  struct rendered_bitmap **rendered);
+
+/**
+ * Draw an image prepared by render_bitmap
+ *
+ * @param[in] rendered	Image returned by render_bitmap
+ * @param[in] pos_rel	Coordinate of the pivot relative to the canvas
+ * @param[in] pivot	Pivot position. Use PIVOT_H_* and PIVOT_V_* flags.
+ *
+ * @return CBGFX_* error codes
+ *
+ * The result is the same as calling draw_bitmap with the bitmap and dim_rel
+ * the image was rendered from.
+ */
+int draw_rendered_bitmap(const struct rendered_bitmap *rendered,
+			 const struct scale *pos_rel, uint8_t pivot);
+
+/**
+ * Get width and height of an image prepared by render_bitmap
+ *
+ * @param[in] rendered	Image returned by render_bitmap
+ * @param[out] dim_rel	Width and height of the image relative to the canvas
+ *                      width and height, as returned by get_bitmap_dimension.
+ *
+ * @return CBGFX_* error codes
+ */
+int get_rendered_dimension(const struct rendered_bitmap *rendered,
+			   struct scale *dim_rel);
+
+/**
+ * Start a frame
+ *
+ * @return CBGFX_* error codes
+ *
+ * With CONFIG_CBGFX_SHADOW_FRAMEBUFFER, drawing goes to a copy of the
+ * framebuffer in cached memory. Outside of a frame every call is written out
+ * to the screen when it returns. Inside one, nothing is written out until the
+ * matching end_frame, and then only the rows which changed, so a screen is
+ * never seen half drawn. Frames may nest. Without a shadow framebuffer, these
+ * have no effect.
+ */
+int begin_frame(void);
+
+/**
+ * End a frame started with begin_frame and write out what changed
+ *
+ * @return CBGFX_* error codes
+ */
+int end_frame(void);
+
+/**
+ * Tell cbgfx something else has drawn on the framebuffer
+ *
+ * The next time the shadow framebuffer is written out, all of it is, which
+ * replaces whatever was drawn around cbgfx (the video console, for instance).
+ */
+void invalidate_screen(void);
@@ -245,6 +245,9 @@ struct UsbDevHc {
 	UsbHcType type;
 	int latest_address;
 	UsbDev *devices[128];	// dev 0 is root hub, 127 is last addressable
+	// Which entries of devices[] are in use, so polling can skip the
+	// empty ones.
+	uint32_t attached[128 / 32];
 
 	/* start():     Resume operation. */
 	void (*start)(UsbDevHc *controller);
@@ -0,0 +1,72 @@
+#!/usr/bin/python
+#
+# Copyright 2016 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+import os
+import struct
+import subprocess
+import sys
+
+# The tag at the start of every compressed module, matching the
+# ModuleCompression values in module/compression.h.
+TAGS = {
+    'lzma': 'LZMA',
+    'lz4': 'LZ4F',
+    'none': 'NONE',
+}
+
+def run(args):
+    p = subprocess.Popen(args, stdout=subprocess.PIPE)
+    out, _ = p.communicate()
+    if p.returncode:
+        sys.exit('{} failed'.format(args[0]))
+    return out
+
+def compress_lzma(name, size):
+    # Run the system's lzma utility.
+    new = run([os.environ.get('LZMA', 'lzma'), '--stdout', name])
+
+    # When lzma is a symlink to xz, it always sets the original size to
+    # "unknown", even if the source file was a regular file and it actually
+    # knew what the size was. To cover that case, we'll manually overwrite the
+    # appropriate field in the LZMA header with the correct uncompressed size.
+    return new[:5] + struct.pack('<Q', size) + new[13:]
+
+def compress_lz4(name, size):
+    # Use the frame format with independent blocks, which is what the
+    # decompressor in base/lz4 supports.
+    return run([os.environ.get('LZ4', 'lz4'), '-9', '-c', '-BI', name])
+
+def compress_none(name, size):
+    with open(name, 'rb') as f:
+        return f.read()
+
+def main():
+    fmt = sys.argv[1]
+    old_name = sys.argv[2]
+    new_name = sys.argv[3]
+
+    if fmt not in TAGS:
+        sys.exit('Unknown compression format "{}"'.format(fmt))
+
+    size = os.stat(old_name).st_size
+    data = globals()['compress_' + fmt](old_name, size)
+
+    with open(new_name, 'wb') as f:
+        f.write(struct.pack('<4sI', TAGS[fmt].encode('ascii'), size))
+        f.write(data)
+
+if __name__ == '__main__':
+    main()
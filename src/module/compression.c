@@ -0,0 +1,95 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <endian.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "base/lz4/lz4.h"
+#include "base/lzma/lzma.h"
+#include "module/compression.h"
+
+static const ModuleCompressionHeader *module_header(const void *image,
+						    uint32_t size)
+{
+	if (size < sizeof(ModuleCompressionHeader)) {
+		printf("Module image is too small.\n");
+		return NULL;
+	}
+	return image;
+}
+
+ssize_t module_expanded_size(const void *image, uint32_t size)
+{
+	const ModuleCompressionHeader *header = module_header(image, size);
+	if (!header)
+		return -1;
+	return le32toh(header->size);
+}
+
+uint32_t module_decompress(const void *image, uint32_t size,
+			   void *dest, uint32_t dest_size)
+{
+	const ModuleCompressionHeader *header = module_header(image, size);
+	if (!header)
+		return 0;
+
+	const void *data = header + 1;
+	uint32_t data_size = size - sizeof(*header);
+	uint32_t expanded = le32toh(header->size);
+	uint32_t out_size;
+
+	if (expanded > dest_size) {
+		printf("Module doesn't fit in %u bytes.\n", dest_size);
+		return 0;
+	}
+
+	switch (le32toh(header->format)) {
+	case ModuleCompressionLzma:
+		// The decoder stops once it fills dest, so a header which
+		// claims less than the stream holds has to be caught here.
+		if (ulzma_expanded_size(data, data_size) != expanded)
+			out_size = 0;
+		else
+			out_size = ulzman(data, data_size, dest, expanded);
+		break;
+	case ModuleCompressionLz4:
+		out_size = ulz4fn(data, data_size, dest, expanded);
+		break;
+	case ModuleCompressionNone:
+		out_size = data_size;
+		if (out_size == expanded)
+			memcpy(dest, data, out_size);
+		break;
+	default:
+		printf("Unrecognized module compression %#x.\n",
+		       le32toh(header->format));
+		return 0;
+	}
+
+	if (out_size != expanded) {
+		printf("Module decompressed to %u bytes, expected %u.\n",
+		       out_size, expanded);
+		return 0;
+	}
+	return out_size;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef __MODULE_COMPRESSION_H__
+#define __MODULE_COMPRESSION_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Every compressed module starts with this header, written by
+// module/compress.py. The format is a four character tag stored little
+// endian so it's readable in a hex dump of the image.
+typedef enum ModuleCompression {
+	ModuleCompressionLzma = 0x414d5a4c,	// "LZMA"
+	ModuleCompressionLz4 = 0x46345a4c,	// "LZ4F"
+	ModuleCompressionNone = 0x454e4f4e	// "NONE"
+} ModuleCompression;
+
+typedef struct __attribute__((packed)) ModuleCompressionHeader {
+	uint32_t format;
+	// The size of the module once it's decompressed.
+	uint32_t size;
+} ModuleCompressionHeader;
+
+// Returns the decompressed size of a module image, or -1 if the header
+// isn't valid.
+ssize_t module_expanded_size(const void *image, uint32_t size);
+
+// Decompresses a module image into dest, which must not overlap it. Returns
+// the decompressed size, or 0 on error.
+uint32_t module_decompress(const void *image, uint32_t size,
+			   void *dest, uint32_t dest_size);
+
+#endif /* __MODULE_COMPRESSION_H__ */
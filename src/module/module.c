@@ -22,51 +22,123 @@
 
 #include <elf.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "base/container_of.h"
-#include "base/lzma/lzma.h"
+#include "base/timestamp.h"
 #include "base/xalloc.h"
+#include "module/compression.h"
 #include "module/module.h"
 #include "module/symbols.h"
 #include "module/trampoline/trampoline.h"
 
-int start_module(const void *compressed_image, uint32_t size)
+// The region the trampoline and the staged module are unpacked into.
+static uint8_t *staging_start(void)
 {
-	// Put the decompressed module at the end of the trampoline.
-	Elf32_Ehdr *elf = (Elf32_Ehdr *)&_tramp_end;
+	return _tramp_end;
+}
 
+static uint8_t *staging_end(void)
+{
 	//XXX This is a hack for now which assumes the decompression area
 	// ends at the end of the kernel area. Once some sort of global
 	// memory allocator exists which can keep track of these things
 	// explicitly (as opposed to by convention) then this can go away.
-	uint8_t *decomp_end = (uint8_t *)(uintptr_t)(CONFIG_KERNEL_START +
-						     CONFIG_KERNEL_SIZE);
+	return (uint8_t *)(uintptr_t)(CONFIG_KERNEL_START +
+				      CONFIG_KERNEL_SIZE);
+}
+
+static int ranges_overlap(uintptr_t a, uint32_t a_size,
+			  uintptr_t b, uint32_t b_size)
+{
+	return a < b + b_size && b < a + a_size;
+}
+
+// The trampoline can't report errors, so make sure every segment it will
+// copy is actually in the image and won't land on the trampoline itself or
+// on the image it's still copying from.
+static int check_segments(Elf32_Ehdr *elf, uint32_t elf_size)
+{
+	uintptr_t tramp = (uintptr_t)_tramp_start;
+	uint32_t tramp_size = _tramp_end - _tramp_start;
+
+	if (elf->e_phoff > elf_size ||
+	    (uint64_t)elf->e_phnum * elf->e_phentsize >
+	    elf_size - elf->e_phoff) {
+		printf("Module program headers are truncated.\n");
+		return -1;
+	}
+
+	uint8_t *addr = (uint8_t *)elf + elf->e_phoff;
+	for (int num = elf->e_phnum; num; num--, addr += elf->e_phentsize) {
+		Elf32_Phdr *phdr = (Elf32_Phdr *)addr;
+
+		if (phdr->p_type != ElfPTypeLoad)
+			continue;
+
+		if (phdr->p_offset > elf_size ||
+		    phdr->p_filesz > elf_size - phdr->p_offset) {
+			printf("Module segment is truncated.\n");
+			return -1;
+		}
+		if (ranges_overlap(phdr->p_paddr, phdr->p_memsz,
+				   tramp, tramp_size) ||
+		    ranges_overlap(phdr->p_paddr, phdr->p_memsz,
+				   (uintptr_t)elf, elf_size)) {
+			printf("Module segment overlaps the trampoline.\n");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Unpack the trampoline and decompress the module after it, leaving an ELF
+// which is ready for the trampoline to load. The compressed image may itself
+// sit at the top of the staging area, in which case the module has to fit
+// below it.
+static Elf32_Ehdr *stage_module(const void *compressed_image, uint32_t size)
+{
+	// Put the decompressed module at the end of the trampoline.
+	Elf32_Ehdr *elf = (Elf32_Ehdr *)staging_start();
+	uint8_t *decomp_end = staging_end();
+	const uint8_t *image = compressed_image;
+
+	if (image > staging_start() && image < decomp_end)
+		decomp_end = (uint8_t *)image;
 
 	// Decompress the trampoline itself.
-	uint32_t out_size = ulzman(&_binary_trampoline_start,
-				   (uintptr_t)&_binary_trampoline_size,
-				   (unsigned char *)elf,
-				   decomp_end - &_tramp_end);
+	uint32_t out_size = module_decompress(&_binary_trampoline_start,
+					      (uintptr_t)&_binary_trampoline_size,
+					      elf, decomp_end - staging_start());
 	if (!out_size) {
 		printf("Error decompressing trampoline.\n");
-		return -1;
+		return NULL;
 	}
 
 	// Expand the trampoline into place.
 	if (elf_check_header(elf))
-		return -1;
+		return NULL;
 	elf_load(elf);
 
 	// Decompress the target image.
-	out_size = ulzman(compressed_image, size, (unsigned char *)elf,
-			  decomp_end - &_tramp_end);
+	out_size = module_decompress(compressed_image, size, elf,
+				     decomp_end - staging_start());
 	if (!out_size) {
 		printf("Error decompressing module.\n");
-		return -1;
+		return NULL;
 	}
 
 	// Do some basic checks on the headers.
-	if (elf_check_header(elf))
+	if (elf_check_header(elf) || check_segments(elf, out_size))
+		return NULL;
+
+	return elf;
+}
+
+int start_module(const void *compressed_image, uint32_t size)
+{
+	Elf32_Ehdr *elf = stage_module(compressed_image, size);
+	if (!elf)
 		return -1;
 
 	enter_trampoline(elf);
@@ -79,18 +151,32 @@ static int dc_module_default_start(DcModuleOps *me)
 {
 	DcModule *module = container_of(me, DcModule, ops);
 
+	timestamp_add_now(TS_MODULE_LOAD_START);
+
 	int size = storage_size(module->storage);
 	if (size < 0)
 		return 1;
 
-	void *image = xmalloc(size);
-	if (storage_read(module->storage, image, 0, size)) {
-		free(image);
+	// Read the compressed image straight into the top of the staging
+	// area rather than into the heap. The module is decompressed below
+	// it, and nothing else is using that memory until we hand off.
+	uint8_t *image = (uint8_t *)ALIGN_DOWN(
+		(uintptr_t)(staging_end() - size), sizeof(uint64_t));
+	if (size > staging_end() - staging_start() ||
+	    image < staging_start()) {
+		printf("Module is too big to stage.\n");
 		return 1;
 	}
+	if (storage_read(module->storage, image, 0, size))
+		return 1;
+	timestamp_add_now(TS_MODULE_READ_DONE);
+
+	Elf32_Ehdr *elf = stage_module(image, size);
+	if (!elf)
+		return 1;
+	timestamp_add_now(TS_MODULE_STAGED);
 
-	start_module(image, size);
-	free(image);
+	enter_trampoline(elf);
 	// If we ever get back to this function, something didn't work.
 	return 1;
 }
@@ -29,8 +29,8 @@
 
 extern uint8_t _start;
 extern uint8_t _end;
-extern uint8_t _tramp_start;
-extern uint8_t _tramp_end;
+extern uint8_t _tramp_start[];
+extern uint8_t _tramp_end[];
 extern uint8_t _init_funcs_start;
 extern uint8_t _init_funcs_end;
 
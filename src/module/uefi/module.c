@@ -27,9 +27,9 @@
 #include "base/container_of.h"
 #include "base/die.h"
 #include "base/fwdb.h"
-#include "base/lzma/lzma.h"
 #include "base/xalloc.h"
 #include "drivers/storage/storage.h"
+#include "module/compression.h"
 #include "module/module.h"
 #include "module/uefi/module.h"
 #include "uefi/uefi.h"
@@ -68,11 +68,12 @@ static EntryFunc uefi_load_segment(Elf64_Ehdr *ehdr, Elf64_Phdr *phdr)
 static void __attribute__((noreturn)) start_uefi_module(
 	void *compressed_image, uint32_t compressed_size)
 {
-	ssize_t size = ulzma_expanded_size(compressed_image, compressed_size);
+	ssize_t size = module_expanded_size(compressed_image, compressed_size);
 	assert(size > 0);
 
 	void *image = xmalloc(size);
-	assert(ulzman(compressed_image, compressed_size, image, size) == size);
+	assert(module_decompress(compressed_image, compressed_size,
+				 image, size) == size);
 
 	Elf64_Ehdr *ehdr = image;
 	EntryFunc entry = NULL;
@@ -74,6 +74,7 @@
 #include <string.h>
 
 #include "base/algorithm.h"
+#include "base/ipchecksum.h"
 #include "net/uip.h"
 #include "net/uipopt.h"
 #include "net/uip_arp.h"
@@ -139,6 +140,17 @@ static uint16_t ipid;           /* Ths ipid variable is an increasing
 
 void uip_setipid(uint16_t id) { ipid = id; }
 
+static uint16_t rx_sum;         /* The one's complement sum of the
+				first rx_sum_len bytes of the incoming
+				frame, in host byte order. */
+static uint16_t rx_sum_len;
+
+void uip_set_rx_sum(uint16_t sum, uint16_t len)
+{
+  rx_sum = sum;
+  rx_sum_len = len;
+}
+
 static uint8_t iss[4];          /* The iss variable is used for the TCP
 				initial sequence number. */
 
@@ -233,32 +245,9 @@ uip_add32(uint8_t *op32, uint16_t op16)
 static uint16_t
 chksum(uint16_t sum, const uint8_t *data, uint16_t len)
 {
-  uint16_t t;
-  const uint8_t *dataptr;
-  const uint8_t *last_byte;
-
-  dataptr = data;
-  last_byte = data + len - 1;
-  
-  while(dataptr < last_byte) {	/* At least two more bytes */
-    t = (dataptr[0] << 8) + dataptr[1];
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-    dataptr += 2;
-  }
-  
-  if(dataptr == last_byte) {
-    t = (dataptr[0] << 8) + 0;
-    sum += t;
-    if(sum < t) {
-      sum++;		/* carry */
-    }
-  }
-
-  /* Return sum in host byte order. */
-  return sum;
+  /* The shared routine sums in host byte order, which only swaps the
+     bytes of the result. Return sum in host byte order. */
+  return uip_ntohs(ipchecksum_add(uip_htons(sum), data, len));
 }
 /*---------------------------------------------------------------------------*/
 uint16_t
@@ -301,6 +290,32 @@ upper_layer_chksum(uint8_t proto)
   return (sum == 0) ? 0xffff : uip_htons(sum);
 }
 /*---------------------------------------------------------------------------*/
+/* Checksum an incoming TCP or UDP packet. If the driver summed the
+   frame while copying it in, only the link and IP headers have to be
+   taken back out of that sum instead of reading the payload again. */
+static uint16_t
+upper_layer_rx_chksum(uint8_t proto)
+{
+  uint16_t ip_len;
+  uint32_t sum;
+
+  ip_len = ((uint16_t)(BUF->len[0]) << 8) + BUF->len[1];
+  if(rx_sum_len != CONFIG_UIP_LLH_LEN + ip_len) {
+    return upper_layer_chksum(proto);
+  }
+  rx_sum_len = 0;
+
+  sum = rx_sum;
+  sum += (uint16_t)~ipchecksum_add(0, uip_buf,
+				   CONFIG_UIP_LLH_LEN + UIP_IPH_LEN);
+  sum += uip_htons(ip_len - UIP_IPH_LEN + proto);
+  sum = (sum >> 16) + (sum & 0xffff);
+  sum = (sum >> 16) + (sum & 0xffff);
+  sum = ipchecksum_add(sum, &BUF->srcipaddr, 2 * sizeof(uip_ipaddr_t));
+
+  return (sum == 0) ? 0xffff : sum;
+}
+/*---------------------------------------------------------------------------*/
 uint16_t
 uip_tcpchksum(void)
 {
@@ -908,7 +923,8 @@ uip_process(uint8_t flag)
     if(CONFIG_UIP_UDP_CHECKSUMS) {
       uip_len = uip_len - UIP_IPUDPH_LEN;
       uip_appdata = &uip_buf[CONFIG_UIP_LLH_LEN + UIP_IPUDPH_LEN];
-      if(UDPBUF->udpchksum != 0 && uip_udpchksum() != 0xffff) {
+      if(UDPBUF->udpchksum != 0 &&
+         upper_layer_rx_chksum(UIP_PROTO_UDP) != 0xffff) {
         UIP_STAT(++uip_stat.udp.drop);
         UIP_STAT(++uip_stat.udp.chkerr);
         UIP_LOG("udp: bad checksum.");
@@ -995,7 +1011,8 @@ uip_process(uint8_t flag)
 
   /* Start of TCP input header processing code. */
   
-  if(uip_tcpchksum() != 0xffff) {   /* Compute and check the TCP
+  if(upper_layer_rx_chksum(UIP_PROTO_TCP) != 0xffff) {
+                                    /* Compute and check the TCP
 				       checksum. */
     UIP_STAT(++uip_stat.tcp.drop);
     UIP_STAT(++uip_stat.tcp.chkerr);
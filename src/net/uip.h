@@ -235,6 +235,22 @@ void uip_init(void);
  */
 void uip_setipid(uint16_t id);
 
+/**
+ * Provide the one's complement sum of an incoming frame.
+ *
+ * A device driver which summed the frame while copying it into
+ * uip_buf, for instance with ipchecksum_copy(), can pass that sum
+ * here before calling uip_input() so uIP doesn't need to read the
+ * TCP or UDP payload again to verify its checksum. The sum is only
+ * used if len matches the length of the IP packet plus the link
+ * level header, and is discarded once it has been used.
+ *
+ * \param sum The sum in host byte order, not complemented.
+ *
+ * \param len The number of bytes covered by the sum, or 0.
+ */
+void uip_set_rx_sum(uint16_t sum, uint16_t len);
+
 /** @} */
 
 /**
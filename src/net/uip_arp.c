@@ -99,18 +99,33 @@ struct arp_entry {
   uip_ipaddr_t ipaddr;
   struct uip_eth_addr ethaddr;
   uint8_t time;
+  uint16_t used;
 };
 
+/* The table is split into sets of ARP_WAYS entries. An address can
+   only live in the set its hash selects, so a lookup checks at most
+   ARP_WAYS entries no matter how large the table is. */
+#define ARP_WAYS 4
+#define ARP_SETS (CONFIG_UIP_ARPTAB_SIZE / ARP_WAYS)
+_Static_assert(ARP_SETS > 0 && CONFIG_UIP_ARPTAB_SIZE % ARP_WAYS == 0,
+	       "UIP_ARPTAB_SIZE must be a multiple of 4");
+
 static const struct uip_eth_addr broadcast_ethaddr =
   {{0xff,0xff,0xff,0xff,0xff,0xff}};
-static const uint16_t broadcast_ipaddr[2] = {0xffff,0xffff};
 
 static struct arp_entry arp_table[CONFIG_UIP_ARPTAB_SIZE];
 static uip_ipaddr_t ipaddr;
-static uint8_t i, c;
+static uint8_t i;
 
 static uint8_t arptime;
-static uint8_t tmpage;
+/* Ticks on every insertion and use, for least recently used eviction. */
+static uint16_t arpclock;
+
+/* The last IP packet which had to wait for address resolution, complete
+   with its Ethernet header except for the destination. */
+static uint8_t arp_pending[CONFIG_UIP_BUFSIZE];
+static uint16_t arp_pending_len;
+static uip_ipaddr_t arp_pending_ipaddr;
 
 #define BUF   ((struct arp_hdr *)&uip_buf[0])
 #define IPBUF ((struct ethip_hdr *)&uip_buf[0])
@@ -135,6 +150,7 @@ uip_arp_init(void)
   for(i = 0; i < CONFIG_UIP_ARPTAB_SIZE; ++i) {
     memset(&arp_table[i].ipaddr, 0, 4);
   }
+  arp_pending_len = 0;
 }
 /*-----------------------------------------------------------------------------------*/
 /**
@@ -154,8 +170,8 @@ uip_arp_timer(void)
   ++arptime;
   for(i = 0; i < CONFIG_UIP_ARPTAB_SIZE; ++i) {
     tabptr = &arp_table[i];
-    if(uip_ipaddr_cmp(&tabptr->ipaddr, &uip_all_zeroes_addr) &&
-       arptime - tabptr->time >= CONFIG_UIP_ARP_MAXAGE) {
+    if(!uip_ipaddr_cmp(&tabptr->ipaddr, &uip_all_zeroes_addr) &&
+       (uint8_t)(arptime - tabptr->time) >= CONFIG_UIP_ARP_MAXAGE) {
       memset(&tabptr->ipaddr, 0, 4);
     }
   }
@@ -163,66 +179,122 @@ uip_arp_timer(void)
 }
 
 /*-----------------------------------------------------------------------------------*/
-static void
-uip_arp_update(uip_ipaddr_t *ipaddr, struct uip_eth_addr *ethaddr)
+static struct arp_entry *
+arp_set(const uip_ipaddr_t *addr)
 {
-  register struct arp_entry *tabptr = arp_table;
-
-  /* Walk through the ARP mapping table and try to find an entry to
-     update. If none is found, the IP -> MAC address mapping is
-     inserted in the ARP table. */
-  for(i = 0; i < CONFIG_UIP_ARPTAB_SIZE; ++i) {
-    tabptr = &arp_table[i];
-
-    /* Only check those entries that are actually in use. */
-    if(!uip_ipaddr_cmp(&tabptr->ipaddr, &uip_all_zeroes_addr)) {
-
-      /* Check if the source IP address of the incoming packet matches
-         the IP address in this ARP table entry. */
-      if(uip_ipaddr_cmp(ipaddr, &tabptr->ipaddr)) {
-	 
-	/* An old entry found, update this and return. */
-	memcpy(tabptr->ethaddr.addr, ethaddr->addr, 6);
-	tabptr->time = arptime;
+  /* Fold the address so hosts on the same subnet, which only differ in
+     their low octets, spread across the sets. */
+  uint16_t hash = addr->u16[0] ^ addr->u16[1];
+  hash ^= hash >> 8;
+  return &arp_table[(hash % ARP_SETS) * ARP_WAYS];
+}
+/*-----------------------------------------------------------------------------------*/
+static struct arp_entry *
+arp_lookup(const uip_ipaddr_t *addr)
+{
+  struct arp_entry *tabptr = arp_set(addr);
 
-	return;
-      }
-    }
-	tabptr++;
+  if(uip_ipaddr_cmp(addr, &uip_all_zeroes_addr)) {
+    return NULL;
   }
-
-  /* If we get here, no existing ARP table entry was found, so we
-     create one. */
-
-  /* First, we try to find an unused entry in the ARP table. */
-  for(i = 0; i < CONFIG_UIP_ARPTAB_SIZE; ++i) {
-    tabptr = &arp_table[i];
-    if(uip_ipaddr_cmp(&tabptr->ipaddr, &uip_all_zeroes_addr)) {
-      break;
+  for(i = 0; i < ARP_WAYS; ++i, ++tabptr) {
+    if(uip_ipaddr_cmp(addr, &tabptr->ipaddr)) {
+      return tabptr;
     }
   }
-
-  /* If no unused entry is found, we try to find the oldest entry and
-     throw it away. */
-  if(i == CONFIG_UIP_ARPTAB_SIZE) {
-    tmpage = 0;
-    c = 0;
-    for(i = 0; i < CONFIG_UIP_ARPTAB_SIZE; ++i) {
-      tabptr = &arp_table[i];
-      if(arptime - tabptr->time > tmpage) {
-	tmpage = arptime - tabptr->time;
-	c = i;
+  return NULL;
+}
+/*-----------------------------------------------------------------------------------*/
+/**
+ * Insert or refresh an IP -> MAC address mapping in the ARP table.
+ *
+ * This is called for mappings learned from ARP traffic, and can be
+ * used to prime the table with mappings learned some other way, for
+ * instance from the Ethernet header of a DHCP reply.
+ */
+/*-----------------------------------------------------------------------------------*/
+void
+uip_arp_update(const uip_ipaddr_t *ipaddr, const struct uip_eth_addr *ethaddr)
+{
+  struct arp_entry *set, *tabptr;
+
+  tabptr = arp_lookup(ipaddr);
+  if(tabptr == NULL) {
+    /* No existing entry, so use a free one in the address's set or
+       throw away the one in it which was used longest ago. */
+    set = arp_set(ipaddr);
+    tabptr = set;
+    for(i = 0; i < ARP_WAYS; ++i) {
+      if(uip_ipaddr_cmp(&set[i].ipaddr, &uip_all_zeroes_addr)) {
+	tabptr = &set[i];
+	break;
+      }
+      if((uint16_t)(arpclock - set[i].used) >
+	 (uint16_t)(arpclock - tabptr->used)) {
+	tabptr = &set[i];
       }
     }
-    i = c;
-    tabptr = &arp_table[i];
+    uip_ipaddr_copy(&tabptr->ipaddr, ipaddr);
   }
 
-  /* Now, i is the ARP table entry which we will fill with the new
-     information. */
-  uip_ipaddr_copy(&tabptr->ipaddr, ipaddr);
   memcpy(tabptr->ethaddr.addr, ethaddr->addr, 6);
   tabptr->time = arptime;
+  tabptr->used = ++arpclock;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Replace whatever is in uip_buf with an ARP request for addr, sent from
+   our current address. */
+static void
+arp_request(const uip_ipaddr_t *addr)
+{
+  memset(BUF->ethhdr.dest.addr, 0xff, 6);
+  memset(BUF->dhwaddr.addr, 0x00, 6);
+  memcpy(BUF->ethhdr.src.addr, uip_ethaddr.addr, 6);
+  memcpy(BUF->shwaddr.addr, uip_ethaddr.addr, 6);
+
+  uip_ipaddr_copy(&BUF->dipaddr, addr);
+  uip_ipaddr_copy(&BUF->sipaddr, &uip_hostaddr);
+  BUF->opcode = UIP_HTONS(ARP_REQUEST); /* ARP request. */
+  BUF->hwtype = UIP_HTONS(ARP_HWTYPE_ETH);
+  BUF->protocol = UIP_HTONS(UIP_ETHTYPE_IP);
+  BUF->hwlen = 6;
+  BUF->protolen = 4;
+  BUF->ethhdr.type = UIP_HTONS(UIP_ETHTYPE_ARP);
+
+  uip_appdata = &uip_buf[UIP_TCPIP_HLEN + CONFIG_UIP_LLH_LEN];
+
+  uip_len = sizeof(struct arp_hdr);
+}
+/*-----------------------------------------------------------------------------------*/
+/**
+ * Start resolving an address before there's any traffic for it.
+ *
+ * If addr isn't in the ARP table, an ARP request for it is put into
+ * uip_buf and uip_len is set, otherwise uip_len is set to zero. The
+ * reply is handled by uip_arp_arpin() like any other.
+ */
+/*-----------------------------------------------------------------------------------*/
+void
+uip_arp_prefetch(const uip_ipaddr_t *addr)
+{
+  uip_len = 0;
+  if(!uip_ipaddr_cmp(addr, &uip_all_zeroes_addr) &&
+     arp_lookup(addr) == NULL) {
+    arp_request(addr);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/**
+ * Build a gratuitous ARP announcing our address in uip_buf.
+ *
+ * Hosts which already know about us update their caches, and ones we
+ * talk to next don't have to ask for our MAC address first.
+ */
+/*-----------------------------------------------------------------------------------*/
+void
+uip_arp_announce(void)
+{
+  arp_request(&uip_hostaddr);
 }
 /*-----------------------------------------------------------------------------------*/
 /**
@@ -328,6 +400,16 @@ uip_arp_arpin(void)
        for us. */
     if(uip_ipaddr_cmp(&BUF->dipaddr, &uip_hostaddr)) {
       uip_arp_update(&BUF->sipaddr, &BUF->shwaddr);
+
+      /* If a packet was waiting on this reply, send it now. */
+      if(arp_pending_len != 0 &&
+	 uip_ipaddr_cmp(&BUF->sipaddr, &arp_pending_ipaddr)) {
+	struct uip_eth_addr dest = BUF->shwaddr;
+	memcpy(uip_buf, arp_pending, arp_pending_len);
+	memcpy(IPBUF->ethhdr.dest.addr, dest.addr, 6);
+	uip_len = arp_pending_len;
+	arp_pending_len = 0;
+      }
     }
     break;
   }
@@ -349,10 +431,11 @@ uip_arp_arpin(void)
  * checks the ARP cache to see if an entry for the destination IP
  * address is found. If so, an Ethernet header is prepended and the
  * function returns. If no ARP cache entry is found for the
- * destination IP address, the packet in the uip_buf[] is replaced by
- * an ARP request packet for the IP address. The IP packet is dropped
- * and it is assumed that they higher level protocols (e.g., TCP)
- * eventually will retransmit the dropped packet.
+ * destination IP address, the IP packet is set aside and the packet
+ * in the uip_buf[] is replaced by an ARP request for the IP address.
+ * When the reply arrives, uip_arp_arpin() sends the packet which was
+ * set aside. Only the most recent such packet is kept, and any older
+ * one is left to the higher level protocols to retransmit.
  *
  * If the destination IP address is not on the local network, the IP
  * address of the default router is used instead.
@@ -365,7 +448,7 @@ uip_arp_arpin(void)
 void
 uip_arp_out(void)
 {
-  struct arp_entry *tabptr = arp_table;
+  struct arp_entry *tabptr;
   
   /* Find the destination IP address in the ARP table and construct
      the Ethernet header. If the destination IP addres isn't on the
@@ -396,39 +479,34 @@ uip_arp_out(void)
       /* Else, we use the destination IP address. */
       uip_ipaddr_copy(&ipaddr, &IPBUF->destipaddr);
     }
-    for(i = 0; i < CONFIG_UIP_ARPTAB_SIZE; ++i) {
-      if(uip_ipaddr_cmp(&ipaddr, &tabptr->ipaddr)) {
-	break;
+    tabptr = arp_lookup(&ipaddr);
+
+    if(tabptr == NULL) {
+      /* The destination address was not in our ARP table, so we set
+	 the IP packet aside and overwrite it with an ARP request. */
+      memcpy(IPBUF->ethhdr.src.addr, uip_ethaddr.addr, 6);
+      IPBUF->ethhdr.type = UIP_HTONS(UIP_ETHTYPE_IP);
+      arp_pending_len = uip_len + sizeof(struct uip_eth_hdr);
+      if(arp_pending_len > sizeof(arp_pending)) {
+	arp_pending_len = 0;
       }
-	  tabptr++;
-    }
-
-    if(i == CONFIG_UIP_ARPTAB_SIZE) {
-      /* The destination address was not in our ARP table, so we
-	 overwrite the IP packet with an ARP request. */
+      memcpy(arp_pending, uip_buf, arp_pending_len);
+      uip_ipaddr_copy(&arp_pending_ipaddr, &ipaddr);
 
-      memset(BUF->ethhdr.dest.addr, 0xff, 6);
-      memset(BUF->dhwaddr.addr, 0x00, 6);
-      memcpy(BUF->ethhdr.src.addr, uip_ethaddr.addr, 6);
-      memcpy(BUF->shwaddr.addr, uip_ethaddr.addr, 6);
-    
-      uip_ipaddr_copy(&BUF->dipaddr, &ipaddr);
-      uip_ipaddr_copy(&BUF->sipaddr, &uip_hostaddr);
-      BUF->opcode = UIP_HTONS(ARP_REQUEST); /* ARP request. */
-      BUF->hwtype = UIP_HTONS(ARP_HWTYPE_ETH);
-      BUF->protocol = UIP_HTONS(UIP_ETHTYPE_IP);
-      BUF->hwlen = 6;
-      BUF->protolen = 4;
-      BUF->ethhdr.type = UIP_HTONS(UIP_ETHTYPE_ARP);
-
-      uip_appdata = &uip_buf[UIP_TCPIP_HLEN + CONFIG_UIP_LLH_LEN];
-    
-      uip_len = sizeof(struct arp_hdr);
+      arp_request(&ipaddr);
       return;
     }
 
+    /* The destination was resolved some other way since a packet was
+       set aside for it, and its sender has moved on. */
+    if(arp_pending_len != 0 &&
+       uip_ipaddr_cmp(&ipaddr, &arp_pending_ipaddr)) {
+      arp_pending_len = 0;
+    }
+
     /* Build an ethernet header. */
     memcpy(IPBUF->ethhdr.dest.addr, tabptr->ethaddr.addr, 6);
+    tabptr->used = ++arpclock;
   }
   memcpy(IPBUF->ethhdr.src.addr, uip_ethaddr.addr, 6);
   
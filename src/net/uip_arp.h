@@ -106,6 +106,22 @@ void uip_arp_out(void);
    is responsible for flushing old entries in the ARP table. */
 void uip_arp_timer(void);
 
+/* The uip_arp_update() function inserts or refreshes a mapping in the
+   ARP table. Besides the ARP code itself, it can be used to prime the
+   table with mappings learned from other traffic. */
+void uip_arp_update(const uip_ipaddr_t *ipaddr,
+		    const struct uip_eth_addr *ethaddr);
+
+/* The uip_arp_prefetch() function puts an ARP request for the address
+   in uip_buf if it isn't already in the ARP table, so it can be
+   resolved before it's needed. uip_len is zero if there's nothing to
+   send. */
+void uip_arp_prefetch(const uip_ipaddr_t *addr);
+
+/* The uip_arp_announce() function puts a gratuitous ARP for our own
+   address in uip_buf, ready to be sent. */
+void uip_arp_announce(void);
+
 /** @} */
 
 /**
@@ -22,8 +22,10 @@
 
 #include <assert.h>
 #include <endian.h>
+#include <inttypes.h>
 #include <stdint.h>
 
+#include "base/algorithm.h"
 #include "base/time.h"
 #include "base/xalloc.h"
 #include "drivers/net/net.h"
@@ -47,8 +49,12 @@ typedef enum DhcpHardwareType
 static const uint16_t DhcpServerPort = 67;
 static const uint16_t DhcpClientPort = 68;
 
-// Wait for a response for 3 seconds before resending a request.
-static const uint64_t DhcpRespTimeoutUs = 3 * 1000 * 1000;
+// Resend requests with exponential backoff, starting quickly so a dropped
+// packet doesn't cost much and randomizing each wait so a room full of
+// machines booting at once doesn't retry in lockstep (RFC 2131 4.1).
+static const uint64_t DhcpInitialTimeoutUs = 1000 * 1000;
+static const uint64_t DhcpMaxTimeoutUs = 16 * 1000 * 1000;
+static const int DhcpMaxTransmissions = 6;
 
 typedef struct __attribute__((packed)) DhcpPacket
 {
@@ -152,6 +158,8 @@ typedef enum DhcpTags {
 	DhcpTagClassIdentifier = 60,
 	DhcpTagClientIdentifier = 61,
 
+	DhcpTagRapidCommit = 80,
+
 	DhcpTagEndOfList = 255
 } DhcpTags;
 
@@ -187,6 +195,13 @@ static DhcpPacket *dhcp_in;
 static int dhcp_in_ready;
 static DhcpPacket *dhcp_out;
 
+// Packets sent during the current dhcp_request(), for reporting.
+static int dhcp_transmissions;
+
+// Where the last accepted reply came from, to prime the ARP table with.
+static uip_ipaddr_t dhcp_reply_ip;
+static uip_eth_addr dhcp_reply_mac;
+
 typedef int (*DhcpOptionFunc)(uint8_t tag, uint8_t length, uint8_t *value,
 			      void *data);
 
@@ -282,6 +297,14 @@ static int dhcp_get_server(uint8_t tag, uint8_t length, uint8_t *value,
 	return 0;
 }
 
+static int dhcp_get_rapid_commit(uint8_t tag, uint8_t length,
+				 uint8_t *value, void *data)
+{
+	if (tag == DhcpTagRapidCommit)
+		*(int *)data = 1;
+	return 0;
+}
+
 static int dhcp_apply_options(uint8_t tag, uint8_t length, uint8_t *value,
 			      void *data)
 {
@@ -347,8 +370,17 @@ static void dhcp_callback(void)
 				 &type))
 		return;
 
+	int rapid_commit = 0;
 	switch (dhcp_state) {
 	case DhcpInit:
+		// A server which supports rapid commit may skip the offer and
+		// acknowledge our discover straight away.
+		if (type == DhcpAck &&
+		    !dhcp_process_options(dhcp_in, OptionOverloadNone,
+					  &dhcp_get_rapid_commit,
+					  &rapid_commit) &&
+		    rapid_commit)
+			break;
 		if (type != DhcpOffer)
 			return;
 		break;
@@ -362,38 +394,51 @@ static void dhcp_callback(void)
 	}
 
 	// Everything checks out. We have a valid reply.
+	struct uip_eth_hdr *eth_hdr = (struct uip_eth_hdr *)uip_buf;
+	struct uip_udpip_hdr *ip_hdr =
+		(struct uip_udpip_hdr *)&uip_buf[CONFIG_UIP_LLH_LEN];
+	dhcp_reply_mac = eth_hdr->src;
+	uip_ipaddr_copy(&dhcp_reply_ip, &ip_hdr->srcipaddr);
 	dhcp_in_ready = 1;
 }
 
-static void dhcp_send_packet(struct uip_udp_conn *conn, const char *name,
-			     DhcpPacket *out, DhcpPacket *in)
+// Wait somewhere between three quarters and five quarters of the timeout.
+static uint64_t dhcp_jitter(uint64_t timeout_us)
+{
+	return timeout_us - timeout_us / 4 + rand() % (timeout_us / 2);
+}
+
+static int dhcp_send_packet(struct uip_udp_conn *conn, const char *name,
+			    DhcpPacket *out, DhcpPacket *in, int tries)
 {
-	// Send the outbound packet.
 	printf("Sending %s... ", name);
-	uip_udp_packet_send(conn, out, sizeof(*out));
-	printf("done.\n");
 
 	// Prepare for the reply.
-	printf("Waiting for reply... ");
 	dhcp_in = in;
 	dhcp_out = out;
 	dhcp_in_ready = 0;
 
-	// Poll network driver until we get a reply. Resend periodically.
+	// Poll network driver until we get a reply. Resend with backoff.
 	net_set_callback(&dhcp_callback);
-	for (;;) {
-		uint64_t start = time_us(0);
+	uint64_t timeout = DhcpInitialTimeoutUs;
+	for (int sent = 0; sent < tries && !dhcp_in_ready; sent++) {
+		uip_udp_packet_send(conn, out, sizeof(*out));
+		dhcp_transmissions++;
+
+		uint64_t deadline = time_deadline_us(dhcp_jitter(timeout));
 		do {
 			net_poll();
-		} while (!dhcp_in_ready &&
-			 time_us(start) < DhcpRespTimeoutUs);
-		if (dhcp_in_ready)
-			break;
-		// No response, try again.
-		uip_udp_packet_send(conn, out, sizeof(*out));
+		} while (!dhcp_in_ready && !time_deadline_expired(deadline));
+		timeout = MIN(timeout * 2, DhcpMaxTimeoutUs);
 	}
 	net_set_callback(NULL);
+
+	if (!dhcp_in_ready) {
+		printf("no reply.\n");
+		return 1;
+	}
 	printf("done.\n");
+	return 0;
 }
 
 static void dhcp_prep_packet(DhcpPacket *packet, uint32_t transaction_id)
@@ -424,13 +469,10 @@ static void dhcp_add_option(uint8_t **options, uint8_t tag, void *value,
 	*options += length + 2;
 }
 
-int dhcp_request(uip_ipaddr_t *next_ip, uip_ipaddr_t *server_ip,
-		 const char **bootfile)
+// Options sent with every discover and request.
+static void dhcp_add_common_options(uint8_t **options, uint8_t type,
+				    int *remaining)
 {
-	DhcpPacket out, in;
-	uint8_t byte;
-	uint8_t *options;
-	int remaining;
 	uint8_t requested[] = { DhcpTagSubnetMask, DhcpTagDefaultRouter };
 	assert(DhcpMaxPacketSize >= DhcpMinPacketSize);
 	uint16_t max_size = htonw(DhcpMaxPacketSize);
@@ -438,104 +480,184 @@ int dhcp_request(uip_ipaddr_t *next_ip, uip_ipaddr_t *server_ip,
 	client_id[0] = DhcpEthernet;
 	memcpy(client_id + 1, &uip_ethaddr, sizeof(uip_ethaddr));
 
-	// Set up the UDP connection.
-	uip_ipaddr_t addr;
-	uip_ipaddr(&addr, 255,255,255,255);
-	struct uip_udp_conn *conn = uip_udp_new(&addr, htonw(DhcpServerPort));
-	if (!conn) {
-		printf("Failed to set up UDP connection.\n");
-		return 1;
-	}
-	uip_udp_bind(conn, htonw(DhcpClientPort));
+	dhcp_add_option(options, DhcpTagMessageType, &type, sizeof(type),
+			remaining);
+	dhcp_add_option(options, DhcpTagClientIdentifier, client_id,
+			sizeof(client_id), remaining);
+	dhcp_add_option(options, DhcpTagParameterRequestList, requested,
+			sizeof(requested), remaining);
+	dhcp_add_option(options, DhcpTagMaximumDhcpMessageSize,
+			&max_size, sizeof(max_size), remaining);
+}
+
+static DhcpMessageType dhcp_message_type(DhcpPacket *packet)
+{
+	DhcpMessageType type = DhcpNoMessageType;
+	if (dhcp_process_options(packet, OptionOverloadNone, &dhcp_get_type,
+				 &type))
+		return DhcpNoMessageType;
+	return type;
+}
+
+// Get an acknowledgement from a server for some address, leaving it in "in".
+static int dhcp_exchange(struct uip_udp_conn *conn, DhcpPacket *in)
+{
+	DhcpPacket out;
+	uint8_t *options;
+	int remaining;
 
 	// Send a DHCP discover packet.
 	dhcp_prep_packet(&out, rand());
 	options = out.options;
 	remaining = sizeof(out.options);
-	byte = DhcpDiscover;
-	dhcp_add_option(&options, DhcpTagMessageType, &byte, sizeof(byte),
-			&remaining);
-	dhcp_add_option(&options, DhcpTagClientIdentifier, client_id,
-			sizeof(client_id), &remaining);
-	dhcp_add_option(&options, DhcpTagParameterRequestList, requested,
-			sizeof(requested), &remaining);
-	dhcp_add_option(&options, DhcpTagMaximumDhcpMessageSize,
-			&max_size, sizeof(max_size), &remaining);
+	dhcp_add_common_options(&options, DhcpDiscover, &remaining);
+	dhcp_add_option(&options, DhcpTagRapidCommit, NULL, 0, &remaining);
 	dhcp_add_option(&options, DhcpTagEndOfList, NULL, 0, &remaining);
-	dhcp_send_packet(conn, "DHCP discover", &out, &in);
+	if (dhcp_send_packet(conn, "DHCP discover", &out, in,
+			     DhcpMaxTransmissions))
+		return 1;
+
+	// The callback only accepts an ack here if it's a rapid commit.
+	if (dhcp_message_type(in) == DhcpAck)
+		return 0;
 
 	// Extract the DHCP server id.
 	uint32_t server_id;
-	if (dhcp_process_options(&in, OptionOverloadNone, &dhcp_get_server,
+	if (dhcp_process_options(in, OptionOverloadNone, &dhcp_get_server,
 				 &server_id)) {
 		printf("Failed to extract server id.\n");
 		return 1;
 	}
 
 	// We got an offer. Request it.
+	uint32_t offered_ip = in->your_ip;
 	dhcp_state = DhcpRequesting;
 	dhcp_prep_packet(&out, rand());
 	options = out.options;
 	remaining = sizeof(out.options);
-	byte = DhcpRequest;
-	dhcp_add_option(&options, DhcpTagMessageType, &byte, sizeof(byte),
-			&remaining);
-	dhcp_add_option(&options, DhcpTagClientIdentifier, client_id,
-			sizeof(client_id), &remaining);
-	dhcp_add_option(&options, DhcpTagRequestedIpAddress, &in.your_ip,
-			sizeof(in.your_ip), &remaining);
-	dhcp_add_option(&options, DhcpTagParameterRequestList, requested,
-			sizeof(requested), &remaining);
-	dhcp_add_option(&options, DhcpTagMaximumDhcpMessageSize,
-			&max_size, sizeof(max_size), &remaining);
+	dhcp_add_common_options(&options, DhcpRequest, &remaining);
+	dhcp_add_option(&options, DhcpTagRequestedIpAddress, &offered_ip,
+			sizeof(offered_ip), &remaining);
 	dhcp_add_option(&options, DhcpTagServerIdentifier,
 			&server_id, sizeof(server_id), &remaining);
 	dhcp_add_option(&options, DhcpTagEndOfList, NULL, 0, &remaining);
-	dhcp_send_packet(conn, "DHCP request", &out, &in);
+	if (dhcp_send_packet(conn, "DHCP request", &out, in,
+			     DhcpMaxTransmissions))
+		return 1;
 
-	DhcpMessageType type;
-	if (dhcp_process_options(&in, OptionOverloadNone, &dhcp_get_type,
-				 &type)) {
+	DhcpMessageType type = dhcp_message_type(in);
+	if (type == DhcpNoMessageType) {
 		printf("Failed to extract message type.\n");
-		dhcp_state = DhcpInit;
 		return 1;
 	}
 	if (type == DhcpNak) {
 		printf("DHCP request nak-ed by the server.\n");
-		dhcp_state = DhcpInit;
 		return 1;
 	}
+	return 0;
+}
 
-	// The server acked, completing the transaction.
-	dhcp_state = DhcpBound;
-	uip_udp_remove(conn);
+static void dhcp_send_arp(void)
+{
+	if (uip_len)
+		net_send(uip_buf, uip_len);
+	uip_len = 0;
+}
 
-	// Apply the settings.
-	if (dhcp_process_options(&in, OptionOverloadNone,
-				 &dhcp_apply_options, NULL)) {
-		dhcp_state = DhcpInit;
+// Announce our new address, and resolve the hosts we're about to talk to so
+// the first packets to them don't wait on ARP.
+static void dhcp_prime_arp(uip_ipaddr_t *next_ip)
+{
+	uip_ipaddr_t my_ip, netmask, router;
+	uip_gethostaddr(&my_ip);
+	uip_getnetmask(&netmask);
+	uip_getdraddr(&router);
+
+	// The ack came from the server itself or from the router which relayed
+	// it, so if it's on our subnet we already know its MAC address.
+	if (uip_ipaddr_maskcmp(&dhcp_reply_ip, &my_ip, &netmask))
+		uip_arp_update(&dhcp_reply_ip, &dhcp_reply_mac);
+
+	uip_arp_announce();
+	dhcp_send_arp();
+
+	uip_arp_prefetch(&router);
+	dhcp_send_arp();
+	if (uip_ipaddr_maskcmp(next_ip, &my_ip, &netmask)) {
+		uip_arp_prefetch(next_ip);
+		dhcp_send_arp();
+	}
+}
+
+// Apply the settings from the server's ack.
+static int dhcp_bind(DhcpPacket *in, uip_ipaddr_t *next_ip,
+		     uip_ipaddr_t *server_ip, const char **bootfile)
+{
+	uint32_t server_id;
+	if (dhcp_process_options(in, OptionOverloadNone, &dhcp_get_server,
+				 &server_id)) {
+		printf("Failed to extract server id.\n");
 		return 1;
 	}
 
-	int bootfile_size = sizeof(in.bootfile_name) + 1;
+	if (dhcp_process_options(in, OptionOverloadNone,
+				 &dhcp_apply_options, NULL))
+		return 1;
+
+	int bootfile_size = sizeof(in->bootfile_name) + 1;
 	char *file = xmalloc(bootfile_size);
 	file[bootfile_size - 1] = 0;
-	memcpy(file, in.bootfile_name, sizeof(in.bootfile_name));
+	memcpy(file, in->bootfile_name, sizeof(in->bootfile_name));
 	*bootfile = file;
-	uip_ipaddr(next_ip, in.server_ip >> 0, in.server_ip >> 8,
-			    in.server_ip >> 16, in.server_ip >> 24);
+	uip_ipaddr(next_ip, in->server_ip >> 0, in->server_ip >> 8,
+			    in->server_ip >> 16, in->server_ip >> 24);
 
 	uip_ipaddr(server_ip, server_id >> 0, server_id >> 8,
 			      server_id >> 16, server_id >> 24);
 
 	uip_ipaddr_t my_ip;
-	uip_ipaddr(&my_ip, in.your_ip >> 0, in.your_ip >> 8,
-			   in.your_ip >> 16, in.your_ip >> 24);
+	uip_ipaddr(&my_ip, in->your_ip >> 0, in->your_ip >> 8,
+			   in->your_ip >> 16, in->your_ip >> 24);
 	uip_sethostaddr(&my_ip);
 
+	dhcp_prime_arp(next_ip);
 	return 0;
 }
 
+int dhcp_request(uip_ipaddr_t *next_ip, uip_ipaddr_t *server_ip,
+		 const char **bootfile)
+{
+	DhcpPacket in;
+	uint64_t start = time_us(0);
+
+	// Set up the UDP connection.
+	uip_ipaddr_t addr;
+	uip_ipaddr(&addr, 255,255,255,255);
+	struct uip_udp_conn *conn = uip_udp_new(&addr, htonw(DhcpServerPort));
+	if (!conn) {
+		printf("Failed to set up UDP connection.\n");
+		return 1;
+	}
+	uip_udp_bind(conn, htonw(DhcpClientPort));
+
+	dhcp_transmissions = 0;
+	int ret = dhcp_exchange(conn, &in);
+	uip_udp_remove(conn);
+
+	if (!ret) {
+		// The server acked, completing the transaction.
+		dhcp_state = DhcpBound;
+		ret = dhcp_bind(&in, next_ip, server_ip, bootfile);
+	}
+	if (ret)
+		dhcp_state = DhcpInit;
+
+	printf("DHCP %s after %d packets in %" PRIu64 " ms.\n",
+	       ret ? "failed" : "bound", dhcp_transmissions,
+	       time_us(start) / 1000);
+	return ret;
+}
+
 int dhcp_release(uip_ipaddr_t server_ip)
 {
 	DhcpPacket release;
@@ -0,0 +1,336 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#include <assert.h>
+#include <endian.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base/algorithm.h"
+#include "base/time.h"
+#include "drivers/net/net.h"
+#include "net/net.h"
+#include "net/uip.h"
+#include "net/uip_arp.h"
+#include "net/uiplib.h"
+#include "netboot/http.h"
+
+// How often to run uIP's TCP timers, which count retransmission timeouts in
+// these ticks.
+static const uint64_t HttpTimerUs = 500 * 1000;
+// Give up if the server goes quiet for this long.
+static const uint64_t HttpIdleTimeoutUs = 10 * 1000 * 1000;
+
+typedef enum HttpStatus
+{
+	HttpPending = 0,
+	HttpSuccess = 1,
+	HttpFailure = 2
+} HttpStatus;
+
+static HttpStatus http_status;
+static int http_got_data;
+
+static char http_request[512];
+static int http_request_len;
+
+// The response header is collected here before the body starts.
+static char http_header[2048];
+static int http_header_len;
+static int http_header_done;
+
+static uint8_t *http_dest;
+static uint32_t http_total_size;
+static uint32_t http_max_size;
+static uint32_t http_content_length;
+
+static int http_parse_url(const char *url, uip_ipaddr_t *ip, uint16_t *port,
+			  char *host, int host_size, const char **path)
+{
+	if (strncmp(url, HttpScheme, sizeof(HttpScheme) - 1))
+		return 1;
+	url += sizeof(HttpScheme) - 1;
+
+	int host_len = strcspn(url, "/");
+	if (!host_len || host_len >= host_size) {
+		printf("Bad host in URL.\n");
+		return 1;
+	}
+	memcpy(host, url, host_len);
+	host[host_len] = 0;
+	*path = url[host_len] ? url + host_len : "/";
+
+	*port = HttpPort;
+	char *colon = strchr(host, ':');
+	if (colon) {
+		char *end;
+		unsigned long val = strtoul(colon + 1, &end, 10);
+		if (end == colon + 1 || *end || !val || val > 0xffff) {
+			printf("Bad port in URL.\n");
+			return 1;
+		}
+		*port = val;
+		*colon = 0;
+	}
+
+	if (!uiplib_ipaddrconv(host, ip)) {
+		printf("URL host %s isn't an IP address.\n", host);
+		return 1;
+	}
+	if (colon)
+		*colon = ':';
+	return 0;
+}
+
+static int http_parse_header(void)
+{
+	int version, code;
+	char *line = http_header;
+	if (strncmp(line, "HTTP/1.", 7)) {
+		printf("Malformed HTTP status line.\n");
+		return 1;
+	}
+	version = line[7] - '0';
+	code = strtoul(line + 8, NULL, 10);
+	if (code != 200) {
+		printf("HTTP/1.%d server returned status %d.\n", version,
+		       code);
+		return 1;
+	}
+
+	int have_length = 0;
+	while ((line = strstr(line, "\r\n")) && line[2] != '\r') {
+		line += 2;
+		static const char length[] = "Content-Length:";
+		static const char encoding[] = "Transfer-Encoding:";
+		if (!strncasecmp(line, length, sizeof(length) - 1)) {
+			http_content_length =
+				strtoul(line + sizeof(length) - 1, NULL, 10);
+			have_length = 1;
+		} else if (!strncasecmp(line, encoding,
+					sizeof(encoding) - 1)) {
+			// We only ask for plain files, so anything other
+			// than the identity encoding isn't worth supporting.
+			printf("Unsupported HTTP transfer encoding.\n");
+			return 1;
+		}
+	}
+
+	if (!have_length) {
+		printf("HTTP response has no Content-Length.\n");
+		return 1;
+	}
+	if (http_content_length > http_max_size) {
+		printf("HTTP transfer too large.\n");
+		return 1;
+	}
+	return 0;
+}
+
+static void http_body(const uint8_t *data, int len)
+{
+	if (len > http_content_length - http_total_size) {
+		printf("HTTP server sent more than Content-Length.\n");
+		http_status = HttpFailure;
+		uip_abort();
+		return;
+	}
+
+	// Stream the data straight to its final home.
+	memcpy(http_dest, data, len);
+	http_dest += len;
+
+	// Give some feedback that something is happening.
+	const uint32_t progress = 512 * 1024;
+	if ((http_total_size + len) / progress != http_total_size / progress)
+		printf("#");
+	http_total_size += len;
+
+	if (http_total_size == http_content_length) {
+		http_status = HttpSuccess;
+		uip_close();
+	}
+}
+
+static void http_data(void)
+{
+	const uint8_t *data = uip_appdata;
+	int len = uip_datalen();
+
+	if (!http_header_done) {
+		// Keep the header null terminated so it can be searched.
+		int space = sizeof(http_header) - 1 - http_header_len;
+		int copy = MIN(len, space);
+		memcpy(http_header + http_header_len, data, copy);
+		http_header[http_header_len + copy] = 0;
+
+		char *end = strstr(http_header, "\r\n\r\n");
+		if (!end) {
+			if (copy == space) {
+				printf("HTTP response header too large.\n");
+				http_status = HttpFailure;
+				uip_abort();
+			}
+			http_header_len += copy;
+			return;
+		}
+
+		// Whatever follows the header is the start of the body.
+		int used = end + 4 - http_header - http_header_len;
+		http_header_done = 1;
+		if (http_parse_header()) {
+			http_status = HttpFailure;
+			uip_abort();
+			return;
+		}
+		data += used;
+		len -= used;
+		if (!http_content_length) {
+			http_status = HttpSuccess;
+			uip_close();
+			return;
+		}
+	}
+
+	if (len)
+		http_body(data, len);
+}
+
+static void http_callback(void)
+{
+	if (uip_aborted() || uip_timedout()) {
+		if (http_status == HttpPending) {
+			printf("HTTP connection %s.\n",
+			       uip_aborted() ? "reset" : "timed out");
+			http_status = HttpFailure;
+		}
+		return;
+	}
+
+	// Tear the connection down if we've given up on it.
+	if (http_status == HttpFailure) {
+		uip_abort();
+		return;
+	}
+
+	// Send the request once we're connected, and again if it was lost.
+	if (uip_connected() || uip_rexmit()) {
+		uip_send(http_request, http_request_len);
+		return;
+	}
+
+	if (uip_newdata() && http_status == HttpPending) {
+		http_got_data = 1;
+		http_data();
+	}
+
+	if (uip_closed() && http_status == HttpPending) {
+		printf("HTTP connection closed after %u of %u bytes.\n",
+		       http_total_size, http_content_length);
+		http_status = HttpFailure;
+	}
+}
+
+static void http_send_pending(void)
+{
+	if (uip_len > 0) {
+		uip_arp_out();
+		net_send(uip_buf, uip_len);
+	}
+}
+
+int http_read(void *dest, const char *url, uint32_t *size, uint32_t max_size)
+{
+	uip_ipaddr_t server_ip;
+	uint16_t port;
+	char host[64];
+	const char *path;
+	if (http_parse_url(url, &server_ip, &port, host, sizeof(host), &path))
+		return -1;
+
+	http_request_len = snprintf(http_request, sizeof(http_request),
+		"GET %s HTTP/1.1\r\n"
+		"Host: %s\r\n"
+		"Connection: close\r\n"
+		"\r\n", path, host);
+	if (http_request_len >= sizeof(http_request) ||
+	    http_request_len > CONFIG_UIP_TCP_MSS) {
+		printf("HTTP request too long.\n");
+		return -1;
+	}
+
+	// Prepare for the transfer.
+	http_status = HttpPending;
+	http_header_len = 0;
+	http_header_done = 0;
+	http_dest = dest;
+	http_total_size = 0;
+	http_max_size = max_size;
+	http_content_length = 0;
+
+	printf("Connecting to HTTP server... ");
+	struct uip_conn *conn = uip_connect(&server_ip, htonw(port));
+	if (!conn) {
+		printf("failed to set up TCP connection.\n");
+		return -1;
+	}
+	printf("done.\n");
+
+	// Poll the network driver until the transfer is done. uIP sends its
+	// SYN and any retransmissions from its periodic timer.
+	printf("Waiting for the transfer... ");
+	net_set_callback(&http_callback);
+	uint64_t timer = 0;
+	uint64_t idle = time_us(0);
+	while (http_status == HttpPending) {
+		if (time_us(timer) >= HttpTimerUs) {
+			timer = time_us(0);
+			uip_periodic_conn(conn);
+			http_send_pending();
+		}
+
+		http_got_data = 0;
+		net_poll();
+		if (http_got_data)
+			idle = time_us(0);
+		else if (time_us(idle) >= HttpIdleTimeoutUs)
+			break;
+	}
+
+	if (http_status == HttpPending) {
+		printf("HTTP server stopped responding.\n");
+		http_status = HttpFailure;
+		uip_poll_conn(conn);
+		http_send_pending();
+	}
+	net_set_callback(NULL);
+
+	if (http_status == HttpFailure)
+		return -1;
+
+	if (size)
+		*size = http_total_size;
+	printf(" done.\n");
+	return 0;
+}
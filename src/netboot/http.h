@@ -0,0 +1,37 @@
+/*
+ * Copyright 2016 Google Inc.
+ *
+ * See file CREDITS for list of people who contributed to this
+ * project.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but without any warranty; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston,
+ * MA 02111-1307 USA
+ */
+
+#ifndef __NETBOOT_HTTP_H__
+#define __NETBOOT_HTTP_H__
+
+#include <stdint.h>
+
+#include "net/uip.h"
+
+static const char HttpScheme[] = "http://";
+static const uint16_t HttpPort = 80;
+
+// Fetch a file named by an "http://a.b.c.d[:port]/path" URL. The host has to
+// be an IP address since there's no DNS resolver.
+int http_read(void *dest, const char *url, uint32_t *size, uint32_t max_size);
+
+#endif /* __NETBOOT_HTTP_H__ */
@@ -24,6 +24,7 @@
 #include <stdint.h>
 #include <vboot_api.h>
 
+#include "base/profile.h"
 #include "base/xalloc.h"
 #include "drivers/blockdev/blockdev.h"
 #include "drivers/blockdev/bdev_stream.h"
@@ -56,7 +57,9 @@ VbError_t VbExDiskGetInfo(VbDiskInfo **info_ptr, uint32_t *count,
 		ctrlrs = &removable_block_dev_controllers;
 	}
 
-	// Update any controllers that need it.
+	// Let any background bring-up finish, then update any controllers
+	// that still need it.
+	block_dev_wait_prewarm(ctrlrs);
 	BlockDevCtrlr *ctrlr;
 	list_for_each(ctrlr, *ctrlrs, list_node) {
 		if (ctrlr->ops.update && ctrlr->need_update &&
@@ -95,8 +98,12 @@ VbError_t VbExDiskFreeInfo(VbDiskInfo *infos,
 VbError_t VbExDiskRead(VbExDiskHandle_t handle, uint64_t lba_start,
 		       uint64_t lba_count, void *buffer)
 {
-	BlockDevOps *ops = &((BlockDev *)handle)->ops;
-	if (ops->read(ops, lba_start, lba_count, buffer) != lba_count) {
+	BlockDev *bdev = (BlockDev *)handle;
+	BlockDevOps *ops = &bdev->ops;
+	profile_begin(&profile_storage);
+	lba_t read = ops->read(ops, lba_start, lba_count, buffer);
+	profile_end(&profile_storage, read * bdev->block_size);
+	if (read != lba_count) {
 		printf("Read failed.\n");
 		return VBERROR_UNKNOWN;
 	}
@@ -125,7 +132,9 @@ VbError_t VbExStreamOpen(VbExDiskHandle_t handle, uint64_t lba_start,
 VbError_t VbExStreamRead(VbExStream_t stream, uint32_t bytes, void *buffer)
 {
 	StreamOps *ops = (StreamOps *)stream;
+	profile_begin(&profile_storage);
 	int ret = ops->read(ops, bytes, buffer);
+	profile_end(&profile_storage, ret > 0 ? ret : 0);
 	if (ret != bytes) {
 		printf("Stream read failed.\n");
 		return VBERROR_UNKNOWN;
@@ -27,6 +27,7 @@
 #include <vboot_api.h>
 #include <vboot_struct.h>
 
+#include "base/profile.h"
 #include "drivers/video/coreboot_fb.h"
 #include "drivers/video/display.h"
 #include "vboot/firmware_id.h"
@@ -87,7 +88,10 @@ VbError_t VbExDisplayScreen(uint32_t screen_type, uint32_t locale)
 {
 	const char *msg = NULL;
 
-	if (vboot_draw_screen(screen_type, locale) == CBGFX_SUCCESS)
+	profile_begin(&profile_display);
+	int ret = vboot_draw_screen(screen_type, locale);
+	profile_end(&profile_display, 0);
+	if (ret == CBGFX_SUCCESS)
 		return VBERROR_SUCCESS;
 
 	/*
@@ -25,6 +25,7 @@
 #include <vboot_api.h>
 
 #include "base/algorithm.h"
+#include "base/init_funcs.h"
 #include "base/time.h"
 #include "base/timestamp.h"
 #include "base/xalloc.h"
@@ -90,6 +91,19 @@ VbError_t VbExEcDisableJump(int devidx)
 	return VBERROR_SUCCESS;
 }
 
+/*
+ * Hashing the RW image takes the EC a while, so get it started as soon as
+ * the board has set up the EC, and collect the result in VbExEcHashRW().
+ */
+static int ec_start_hash(void)
+{
+	if (cros_ec_start_hash(0))
+		printf("Failed to start the EC hash early.\n");
+	return 0;
+}
+
+INIT_FUNC_EC(ec_start_hash);
+
 VbError_t VbExEcHashRW(int devidx, const uint8_t **hash, int *hash_size)
 {
 	static struct ec_response_vboot_hash resp;
@@ -23,7 +23,6 @@
 #include <stdio.h>
 #include <vboot_api.h>
 
-#include "base/time.h"
 #include "debug/gdb/gdb.h"
 #include "debug/netboot.h"
 
@@ -39,7 +38,6 @@
 
 uint32_t VbExKeyboardReadWithFlags(uint32_t *flags_ptr)
 {
-	uint64_t timer_start;
 	uint32_t ch;
 	uint32_t flags = 0;
 
@@ -63,11 +61,8 @@ uint32_t VbExKeyboardReadWithFlags(uint32_t *flags_ptr)
 	case KEY_RIGHT: return VB_KEY_RIGHT;
 	case KEY_LEFT: return VB_KEY_LEFT;
 	case CSI_0:
-		timer_start = time_us(0);
-		while (!havekey()) {
-			if (time_us(timer_start) >= TIMEOUT_US)
-				return CSI_0;
-		}
+		if (!havekey_wait(TIMEOUT_US))
+			return CSI_0;
 
 		// Ignore non escape [ sequences.
 		if (getchar() != CSI_1)
@@ -64,6 +64,7 @@ int VbExLegacy(void)
 
 	if (payload == NULL) {
 		printf("Could not find payload in legacy cbfs.\n");
+		cbfs_invalidate_index(&media);
 		free(legacy_buf);
 		return VBERROR_UNKNOWN;
 	}
@@ -71,6 +72,7 @@ int VbExLegacy(void)
 	load_payload_and_run(payload);
 
 	// Should never return unless there is an error.
+	cbfs_invalidate_index(&media);
 	free(legacy_buf);
 	return VBERROR_UNKNOWN;
 }
@@ -26,6 +26,7 @@
 #include <vboot_api.h>
 
 #include "base/algorithm.h"
+#include "base/profile.h"
 #include "base/xalloc.h"
 #include "drivers/board/board.h"
 #include "drivers/storage/storage.h"
@@ -51,9 +52,11 @@ VbError_t VbExHashFirmwareBody(VbCommonParams *cparams,
 	size_t chunk_size = MIN(64 * 1024, size);
 	void *data = xmalloc(chunk_size);
 
+	profile_begin(&profile_hash);
 	uint64_t offset = 0;
 	while (size) {
 		if (storage_read(fw, data, offset, chunk_size)) {
+			profile_end(&profile_hash, offset);
 			free(data);
 			return VBERROR_UNKNOWN;
 		}
@@ -65,6 +68,7 @@ VbError_t VbExHashFirmwareBody(VbCommonParams *cparams,
 		// Process as much as we did last time, or whatever is left.
 		chunk_size = MIN(chunk_size, size);
 	}
+	profile_end(&profile_hash, offset);
 
 	free(data);
 	return VBERROR_SUCCESS;
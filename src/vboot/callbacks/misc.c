@@ -25,6 +25,7 @@
 
 #include "base/die.h"
 #include "base/lzma/lzma.h"
+#include "base/profile.h"
 #include "drivers/board/board.h"
 #include "drivers/storage/storage.h"
 
@@ -67,7 +68,9 @@ VbError_t VbExDecompress(void *inbuf, uint32_t in_size,
 		printf("EFIv1 compression not supported.\n");
 		return VBERROR_UNKNOWN;
 	case COMPRESS_LZMA1:
+		profile_begin(&profile_decompress);
 		*out_size = ulzman(inbuf, in_size, outbuf, *out_size);
+		profile_end(&profile_decompress, *out_size);
 		if (!*out_size) {
 			printf("Error doing LZMA decompression.\n");
 			return VBERROR_UNKNOWN;
@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <vboot_api.h>
 
+#include "base/task.h"
 #include "base/time.h"
 #include "drivers/sound/sound.h"
 
@@ -36,7 +37,7 @@ uint64_t VbExGetTimer(void)
 
 void VbExSleepMs(uint32_t msec)
 {
-	mdelay(msec);
+	task_mdelay(msec);
 }
 
 VbError_t VbExBeep(uint32_t msec, uint32_t frequency)
@@ -29,6 +29,7 @@
 #include "base/algorithm.h"
 #include "base/cbfs/cbfs.h"
 #include "base/graphics.h"
+#include "base/list.h"
 #include "drivers/video/display.h"
 #include "vboot/util/gbb.h"
 
@@ -61,22 +62,136 @@
 			return rv;					\
 	} while (0)
 
+/* Locale of images which are the same in every locale */
+#define NO_LOCALE	(~(uint32_t)0)
+
 static char initialized = 0;
 static uint32_t locale_count;
 static char *supported_locales[256];
 
-static VbError_t draw_image(const char *image_name,
-			    int32_t x, int32_t y, int32_t width, int32_t height,
-			    char pivot)
-{
-	uint8_t *image;
+/*
+ * Screens are redrawn on every key press and locale change in the developer
+ * and recovery UIs, and most of the images on them (fonts, arrows, dividers,
+ * the footer) are the same every time. Images are kept already scaled and in
+ * the framebuffer's pixel format so that drawing them again is just a copy.
+ * They're keyed by what determines their pixels: the file, the locale and the
+ * requested size. Asking for an image's size only records its dimensions, and
+ * the pixels are filled in the first time it's drawn. The least recently used
+ * entries are dropped to keep the cache within CONFIG_SCREEN_CACHE_SIZE bytes.
+ */
+typedef struct {
+	uint32_t locale;
+	int32_t width;
+	int32_t height;
 	size_t size;
-	VbError_t rv = VBERROR_SUCCESS;
+	int cached;
+	struct scale dim;
+	struct rendered_bitmap *image;
+	ListNode list_node;
+	char name[];
+} CachedImage;
+
+/* Most recently used first */
+static ListNode image_cache;
+static size_t image_cache_used;
+
+static void free_cached_image(CachedImage *entry)
+{
+	free(entry->image);
+	free(entry);
+}
 
-	image = cbfs_get_file_content(CBFS_DEFAULT_MEDIA, image_name,
-				      CBFS_TYPE_RAW, &size);
-	if (!image)
-		return VBERROR_NO_IMAGE_PRESENT;
+static void image_cache_add(CachedImage *entry)
+{
+	CachedImage *victim, *last;
+
+	if (entry->size > CONFIG_SCREEN_CACHE_SIZE)
+		return;
+
+	while (image_cache_used + entry->size > CONFIG_SCREEN_CACHE_SIZE) {
+		last = NULL;
+		list_for_each(victim, image_cache, list_node)
+			last = victim;
+		list_remove(&last->list_node);
+		image_cache_used -= last->size;
+		free_cached_image(last);
+	}
+
+	list_insert_after(&entry->list_node, &image_cache);
+	image_cache_used += entry->size;
+	entry->cached = 1;
+}
+
+static void image_cache_remove(CachedImage *entry)
+{
+	list_remove(&entry->list_node);
+	image_cache_used -= entry->size;
+	entry->cached = 0;
+}
+
+/* Look an image up in the cache, and mark it as the most recently used. */
+static CachedImage *find_image(const char *image_name, uint32_t locale,
+			       int32_t width, int32_t height)
+{
+	CachedImage *entry;
+
+	list_for_each(entry, image_cache, list_node) {
+		if (entry->locale != locale || entry->width != width ||
+		    entry->height != height || strcmp(entry->name, image_name))
+			continue;
+		list_remove(&entry->list_node);
+		list_insert_after(&entry->list_node, &image_cache);
+		return entry;
+	}
+	return NULL;
+}
+
+static CachedImage *new_image(const char *image_name, uint32_t locale,
+			      int32_t width, int32_t height)
+{
+	CachedImage *entry = malloc(sizeof(*entry) + strlen(image_name) + 1);
+	if (!entry)
+		return NULL;
+
+	entry->locale = locale;
+	entry->width = width;
+	entry->height = height;
+	entry->size = sizeof(*entry) + strlen(image_name) + 1;
+	entry->cached = 0;
+	entry->image = NULL;
+	strcpy(entry->name, image_name);
+	return entry;
+}
+
+static void put_image(CachedImage *image)
+{
+	/* Images too big for the cache only live for one use. */
+	if (!image->cached)
+		free_cached_image(image);
+}
+
+static void *load_image(const char *image_name, uint32_t locale, size_t *size)
+{
+	char str[256];
+
+	if (locale == NO_LOCALE)
+		snprintf(str, sizeof(str), "%s", image_name);
+	else
+		snprintf(str, sizeof(str), "locale/%s/%s",
+			 supported_locales[locale], image_name);
+
+	return cbfs_get_file_content(CBFS_DEFAULT_MEDIA, str,
+				     CBFS_TYPE_RAW, size);
+}
+
+static int draw_image_locale(const char *image_name, uint32_t locale,
+			     int32_t x, int32_t y,
+			     int32_t width, int32_t height, char pivot)
+{
+	CachedImage *image;
+	uint8_t *file;
+	size_t size;
+	int rv;
 
 	struct scale pos = {
 		.x = { .n = x, .d = VB_SCALE, },
@@ -87,45 +202,85 @@ static VbError_t draw_image(const char *image_name,
 		.y = { .n = height, .d = VB_SCALE, },
 	};
 
-	rv = draw_bitmap(image, size, &pos, pivot, &dim);
-	if (rv)
-		rv = VBERROR_UNKNOWN;
-	free(image);
+	image = find_image(image_name, locale, width, height);
+	if (image && image->image) {
+		rv = draw_rendered_bitmap(image->image, &pos, pivot);
+		return rv ? VBERROR_UNKNOWN : VBERROR_SUCCESS;
+	}
 
-	return rv;
+	file = load_image(image_name, locale, &size);
+	if (!file)
+		return VBERROR_NO_IMAGE_PRESENT;
+
+	/* An entry which only has dimensions so far is re-added with pixels. */
+	if (image)
+		image_cache_remove(image);
+	else
+		image = new_image(image_name, locale, width, height);
+
+	if (image && !render_bitmap(file, size, &dim, &image->image)) {
+		free(file);
+		get_rendered_dimension(image->image, &image->dim);
+		image->size += image->image->size;
+		image_cache_add(image);
+		rv = draw_rendered_bitmap(image->image, &pos, pivot);
+		put_image(image);
+		return rv ? VBERROR_UNKNOWN : VBERROR_SUCCESS;
+	}
+
+	/*
+	 * There isn't enough memory to keep a rendered copy, so draw straight
+	 * from the file to the framebuffer like an uncached draw would.
+	 */
+	if (image)
+		free_cached_image(image);
+	rv = draw_bitmap(file, size, &pos, pivot, &dim);
+	free(file);
+	return rv ? VBERROR_UNKNOWN : VBERROR_SUCCESS;
 }
 
-static int draw_image_locale(const char *image_name, uint32_t locale,
-			     int32_t x, int32_t y,
-			     int32_t width, int32_t height, char pivot)
+static VbError_t draw_image(const char *image_name,
+			    int32_t x, int32_t y, int32_t width, int32_t height,
+			    char pivot)
 {
-	char str[256];
-	snprintf(str, sizeof(str), "locale/%s/%s",
-		 supported_locales[locale], image_name);
-	return draw_image(str, x, y, width, height, pivot);
+	return draw_image_locale(image_name, NO_LOCALE,
+				 x, y, width, height, pivot);
 }
 
-static VbError_t get_image_size(const char *image_name,
-				int32_t *width, int32_t *height)
+static VbError_t get_image_size_locale(const char *image_name, uint32_t locale,
+				       int32_t *width, int32_t *height)
 {
-	uint8_t *image;
+	CachedImage *image;
+	struct scale dim;
+	uint8_t *file;
 	size_t size;
-	VbError_t rv;
-
-	image = cbfs_get_file_content(CBFS_DEFAULT_MEDIA, image_name,
-				      CBFS_TYPE_RAW, &size);
-	if (!image)
-		return VBERROR_NO_IMAGE_PRESENT;
-
-	struct scale dim = {
-		.x = { .n = *width, .d = VB_SCALE, },
-		.y = { .n = *height, .d = VB_SCALE, },
-	};
+	int rv;
+
+	image = find_image(image_name, locale, *width, *height);
+	if (image) {
+		dim = image->dim;
+	} else {
+		file = load_image(image_name, locale, &size);
+		if (!file)
+			return VBERROR_NO_IMAGE_PRESENT;
+
+		dim.x.n = *width;
+		dim.x.d = VB_SCALE;
+		dim.y.n = *height;
+		dim.y.d = VB_SCALE;
+		rv = get_bitmap_dimension(file, size, &dim);
+		free(file);
+		if (rv)
+			return VBERROR_UNKNOWN;
 
-	rv = get_bitmap_dimension(image, size, &dim);
-	free(image);
-	if (rv)
-		return VBERROR_UNKNOWN;
+		/* Remember the size so the draw which follows can use it. */
+		image = new_image(image_name, locale, *width, *height);
+		if (image) {
+			image->dim = dim;
+			image_cache_add(image);
+			put_image(image);
+		}
+	}
 
 	*width = dim.x.n * VB_SCALE / dim.x.d;
 	*height = dim.y.n * VB_SCALE / dim.y.d;
@@ -133,13 +288,10 @@ static VbError_t get_image_size(const char *image_name,
 	return VBERROR_SUCCESS;
 }
 
-static VbError_t get_image_size_locale(const char *image_name, uint32_t locale,
-				       int32_t *width, int32_t *height)
+static VbError_t get_image_size(const char *image_name,
+				int32_t *width, int32_t *height)
 {
-	char str[256];
-	snprintf(str, sizeof(str), "locale/%s/%s",
-		 supported_locales[locale], image_name);
-	return get_image_size(str, width, height);
+	return get_image_size_locale(image_name, NO_LOCALE, width, height);
 }
 
 static int draw_icon(const char *image_name)
@@ -544,9 +696,15 @@ static VbError_t draw_screen(uint32_t screen_type, uint32_t locale)
 		return VBERROR_INVALID_PARAMETER;
 	}
 
+	/*
+	 * Draw the whole screen off screen and then put it up at once, so only
+	 * what actually changed gets written to the framebuffer.
+	 */
+	begin_frame();
 	/* if no drawing function is registered, fallback msg will be printed */
 	if (desc->draw)
 		rv = desc->draw(locale);
+	end_frame();
 	if (rv)
 		print_fallback_message(desc);
 
@@ -0,0 +1,258 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "base/die.h"
+#include "drivers/timer/timer.h"
+#include "hosttest.h"
+
+typedef struct {
+	const char *name;
+	void (*test)(void);
+	void (*bench)(void);
+} HostTestSuite;
+
+static const HostTestSuite suites[] = {
+	{ "ranges", &test_ranges, &bench_ranges },
+	{ "ipchecksum", &test_ipchecksum, &bench_ipchecksum },
+	{ "dcdir", &test_dcdir, &bench_dcdir },
+	{ "compression", &test_compression, &bench_compression },
+	{ "arp", &test_arp, &bench_arp },
+	{ "cros_ec", &test_cros_ec, &bench_cros_ec },
+	{ "lpc_tpm", &test_lpc_tpm, &bench_lpc_tpm },
+	{ "time", &test_time, &bench_time },
+	{ "malloc", &test_malloc, &bench_malloc },
+	{ "qsort", &test_qsort, &bench_qsort },
+	{ "printf", &test_printf, &bench_printf },
+	{ "fwdb", &test_fwdb, &bench_fwdb },
+	{ "state_machine", &test_state_machine, &bench_state_machine },
+	{ "device_tree", &test_device_tree, &bench_device_tree },
+};
+
+static int failures;
+static const char *data_dir = ".";
+
+void hosttest_fail(const char *file, int line, const char *cond)
+{
+	printf("FAIL: %s:%d: %s\n", file, line, cond);
+	failures++;
+}
+
+// Firmware code calls this when it can't go on, which on the host is a
+// test failure that can't be recovered from either.
+void die_work(const char *file, const char *func, const int line,
+	      const char *fmt, ...)
+{
+	va_list args;
+
+	printf("DIE: %s:%d %s(): ", file, line, func);
+	va_start(args, fmt);
+	vprintf(fmt, args);
+	va_end(args);
+	exit(1);
+}
+
+HostTimer hosttest_timer = { .step = 1, .mask = 0xffffffff };
+
+uint64_t timer_hz(void)
+{
+	return HostTimerHz;
+}
+
+uint64_t timer_raw_value(void)
+{
+	uint64_t value = hosttest_timer.raw;
+	hosttest_timer.raw = (value + hosttest_timer.step) &
+			     hosttest_timer.mask;
+	return value;
+}
+
+int timer_raw_bits(void)
+{
+	return 32;
+}
+
+void halt(void)
+{
+	printf("HALT\n");
+	exit(1);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void hosttest_bench(const char *name, int iterations, size_t bytes,
+		    HostBenchFunc func, void *data)
+{
+	// Drivers log as they go, which would bury the results and time the
+	// terminal as much as the code.
+	fflush(stdout);
+	int saved_stdout = dup(STDOUT_FILENO);
+	int null = open("/dev/null", O_WRONLY);
+	dup2(null, STDOUT_FILENO);
+	close(null);
+
+	// One untimed call to fault in memory and warm up the caches.
+	func(data);
+
+	uint64_t start = now_ns();
+	for (int i = 0; i < iterations; i++)
+		func(data);
+	uint64_t elapsed = now_ns() - start;
+
+	fflush(stdout);
+	dup2(saved_stdout, STDOUT_FILENO);
+	close(saved_stdout);
+
+	double ns_per_op = (double)elapsed / iterations;
+	printf("bench: %-28s %8d iters %12.1f ns/op", name, iterations,
+	       ns_per_op);
+	if (bytes)
+		printf(" %10.1f MB/s", bytes * 1000.0 / ns_per_op);
+	printf("\n");
+}
+
+void *hosttest_read_data(const char *name, size_t *size)
+{
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/%s", data_dir, name);
+
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		printf("Failed to open %s.\n", path);
+		exit(1);
+	}
+	fseek(file, 0, SEEK_END);
+	long len = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	void *buf = malloc(len ? len : 1);
+	if (!buf || fread(buf, 1, len, file) != len) {
+		printf("Failed to read %s.\n", path);
+		exit(1);
+	}
+	fclose(file);
+
+	*size = len;
+	return buf;
+}
+
+void hosttest_fill_corpus(void *buf, size_t size)
+{
+	static const char *const words[] = {
+		"kernel", "depthcharge", "vboot", "firmware", "the", "of",
+		"memory", "region", "\n", "0x00000000", "return", "struct",
+		"static", "int", "uint32_t", "{", "}", ";", "\t", "if",
+	};
+	uint32_t seed = 0x12345678;
+	uint8_t *pos = buf, *end = pos + size;
+
+	while (pos < end) {
+		// A fixed linear congruential generator keeps the data
+		// identical everywhere.
+		seed = seed * 1103515245 + 12345;
+		const char *word = words[(seed >> 16) % 20];
+		size_t len = strlen(word);
+		if (len > end - pos)
+			len = end - pos;
+		memcpy(pos, word, len);
+		pos += len;
+		if (pos < end)
+			*pos++ = ' ';
+	}
+}
+
+static int write_corpus(const char *name, size_t size)
+{
+	void *buf = malloc(size);
+	hosttest_fill_corpus(buf, size);
+
+	FILE *file = fopen(name, "wb");
+	if (!file || fwrite(buf, 1, size, file) != size) {
+		printf("Failed to write %s.\n", name);
+		return 1;
+	}
+	fclose(file);
+	free(buf);
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	printf("Usage: %s test|bench [data dir] [suite...]\n"
+	       "       %s corpus <file> <size>\n", name, name);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc < 2) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!strcmp(argv[1], "corpus")) {
+		if (argc != 4) {
+			usage(argv[0]);
+			return 1;
+		}
+		return write_corpus(argv[2], strtoul(argv[3], NULL, 0));
+	}
+
+	int bench = !strcmp(argv[1], "bench");
+	if (!bench && strcmp(argv[1], "test")) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (argc > 2)
+		data_dir = argv[2];
+
+	for (int i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+		const HostTestSuite *suite = &suites[i];
+
+		// Optionally only run the suites named on the command line.
+		int selected = argc <= 3;
+		for (int j = 3; j < argc; j++)
+			if (!strcmp(argv[j], suite->name))
+				selected = 1;
+		if (!selected)
+			continue;
+
+		if (bench) {
+			suite->bench();
+		} else {
+			int before = failures;
+			suite->test();
+			printf("%s: %s\n", suite->name,
+			       failures == before ? "PASS" : "FAIL");
+		}
+	}
+
+	if (failures) {
+		printf("%d check(s) failed.\n", failures);
+		return 1;
+	}
+	return 0;
+}
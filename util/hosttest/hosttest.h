@@ -0,0 +1,92 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOSTTEST_HOSTTEST_H__
+#define __HOSTTEST_HOSTTEST_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Record a failed check without stopping, so one run reports every problem.
+void hosttest_fail(const char *file, int line, const char *cond);
+#define CHECK(cond) do { \
+	if (!(cond)) \
+		hosttest_fail(__FILE__, __LINE__, #cond); \
+} while (0)
+
+typedef void (*HostBenchFunc)(void *data);
+
+// Run func a fixed number of times and report ns/op, and MB/s if each call
+// processes a known number of bytes. The counts are fixed rather than
+// calibrated so results from different runs and machines line up.
+void hosttest_bench(const char *name, int iterations, size_t bytes,
+		    HostBenchFunc func, void *data);
+
+// Read a whole file from the data directory, exiting if that fails.
+void *hosttest_read_data(const char *name, size_t *size);
+
+// Fill buf with deterministic text-like data which compresses about as well
+// as a kernel image does.
+void hosttest_fill_corpus(void *buf, size_t size);
+
+// The timer driver seen by code under test. It's a 32 bit counter like
+// Tegra's, at the 19.2MHz of many ARM boards so conversions aren't whole
+// numbers, and every read moves it on by "step" so busy waits make progress.
+enum { HostTimerHz = 19200000 };
+
+typedef struct {
+	uint64_t raw;
+	uint64_t step;
+	uint64_t mask;
+} HostTimer;
+
+extern HostTimer hosttest_timer;
+
+// Keep the compiler from discarding work whose result is otherwise unused.
+static inline void hosttest_use(uintptr_t value)
+{
+	__asm__ __volatile__("" : : "r"(value) : "memory");
+}
+
+void test_ranges(void);
+void bench_ranges(void);
+void test_ipchecksum(void);
+void bench_ipchecksum(void);
+void test_dcdir(void);
+void bench_dcdir(void);
+void test_compression(void);
+void bench_compression(void);
+void test_arp(void);
+void bench_arp(void);
+void test_cros_ec(void);
+void bench_cros_ec(void);
+void test_lpc_tpm(void);
+void bench_lpc_tpm(void);
+void test_time(void);
+void bench_time(void);
+void test_malloc(void);
+void bench_malloc(void);
+void test_qsort(void);
+void bench_qsort(void);
+void test_printf(void);
+void bench_printf(void);
+void test_fwdb(void);
+void bench_fwdb(void);
+void test_state_machine(void);
+void bench_state_machine(void);
+void test_device_tree(void);
+void bench_device_tree(void);
+
+#endif /* __HOSTTEST_HOSTTEST_H__ */
@@ -0,0 +1,41 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __HOSTTEST_LIBC_H__
+#define __HOSTTEST_LIBC_H__
+
+#include <stdarg.h>
+#include <stddef.h>
+
+// depthcharge's libc functions, which the Makefile builds under these names
+// so they can run next to the host's.
+
+void *dc_malloc(size_t size);
+void dc_free(void *ptr);
+void *dc_calloc(size_t nmemb, size_t size);
+void *dc_realloc(void *ptr, size_t size);
+void *dc_memalign(size_t align, size_t size);
+
+int dc_printf(const char *fmt, ...);
+int dc_sprintf(char *str, const char *fmt, ...);
+int dc_snprintf(char *str, size_t size, const char *fmt, ...);
+int dc_vprintf(const char *fmt, va_list ap);
+int dc_vsprintf(char *str, const char *fmt, va_list ap);
+int dc_vsnprintf(char *str, size_t size, const char *fmt, va_list ap);
+
+void dc_qsort(void *base, size_t n, size_t size,
+	      int (*cmp)(const void *, const void *));
+
+#endif /* __HOSTTEST_LIBC_H__ */
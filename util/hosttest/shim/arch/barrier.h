@@ -0,0 +1,23 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Busy wait loops only need cpu_relax() on the host.
+
+#ifndef __HOSTTEST_SHIM_ARCH_BARRIER_H__
+#define __HOSTTEST_SHIM_ARCH_BARRIER_H__
+
+#define cpu_relax() __asm__ __volatile__("" : : : "memory")
+
+#endif /* __HOSTTEST_SHIM_ARCH_BARRIER_H__ */
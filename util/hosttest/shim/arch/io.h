@@ -0,0 +1,30 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Register accessors for drivers under test. There's no hardware behind them
+// on the host, so each test which builds a driver implements them against a
+// fake device.
+
+#ifndef __HOSTTEST_SHIM_ARCH_IO_H__
+#define __HOSTTEST_SHIM_ARCH_IO_H__
+
+#include <stdint.h>
+
+uint8_t read8(const volatile void *addr);
+uint32_t read32(const volatile void *addr);
+void write8(volatile void *addr, uint8_t value);
+void write32(volatile void *addr, uint32_t value);
+
+#endif /* __HOSTTEST_SHIM_ARCH_IO_H__ */
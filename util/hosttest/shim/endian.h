@@ -0,0 +1,40 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The host's endian.h, plus the byte swapping helpers depthcharge's libc
+// provides on top of it.
+
+#ifndef __HOSTTEST_SHIM_ENDIAN_H__
+#define __HOSTTEST_SHIM_ENDIAN_H__
+
+#include_next <endian.h>
+#include <stdint.h>
+
+static inline uint16_t swap_bytes16(uint16_t in)
+{
+	return __builtin_bswap16(in);
+}
+
+static inline uint32_t swap_bytes32(uint32_t in)
+{
+	return __builtin_bswap32(in);
+}
+
+static inline uint64_t swap_bytes64(uint64_t in)
+{
+	return __builtin_bswap64(in);
+}
+
+#endif /* __HOSTTEST_SHIM_ENDIAN_H__ */
@@ -0,0 +1,29 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The host's stddef.h, plus the size constants from depthcharge's libc.
+// System headers include stddef.h several times asking for different parts
+// of it, so only the additions are guarded.
+
+#include_next <stddef.h>
+
+#ifndef __HOSTTEST_SHIM_STDDEF_H__
+#define __HOSTTEST_SHIM_STDDEF_H__
+
+#define KiB (1<<10)
+#define MiB (1<<20)
+#define GiB (1<<30)
+
+#endif /* __HOSTTEST_SHIM_STDDEF_H__ */
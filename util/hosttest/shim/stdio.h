@@ -0,0 +1,26 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The host's stdio.h, plus stdarg.h, which depthcharge's stdio.h includes
+// for the va_list printing functions.
+
+#include_next <stdio.h>
+
+#ifndef __HOSTTEST_SHIM_STDIO_H__
+#define __HOSTTEST_SHIM_STDIO_H__
+
+#include <stdarg.h>
+
+#endif /* __HOSTTEST_SHIM_STDIO_H__ */
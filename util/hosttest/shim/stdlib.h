@@ -0,0 +1,43 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// The host's stdlib.h, plus what depthcharge's libc declares here on top of
+// it: memalign(), which glibc keeps in malloc.h, string.h, the alignment
+// macros, the DMA allocator and halt().
+
+#include_next <stdlib.h>
+
+#ifndef __HOSTTEST_SHIM_STDLIB_H__
+#define __HOSTTEST_SHIM_STDLIB_H__
+
+#include <malloc.h>
+#include <stdint.h>
+#include <string.h>
+
+#define ALIGN(x,a)              __ALIGN_MASK(x,(typeof(x))(a)-1UL)
+#define __ALIGN_MASK(x,mask)    (((x)+(mask))&~(mask))
+#define ALIGN_UP(x,a)           ALIGN((x),(a))
+#define ALIGN_DOWN(x,a)         ((x) & ~((typeof(x))(a)-1UL))
+#define IS_ALIGNED(x,a)         (((x) & ((typeof(x))(a)-1UL)) == 0)
+
+void *dma_malloc(size_t size);
+void *dma_memalign(size_t align, size_t size);
+void init_dma_memory(void *start, uint32_t size);
+int dma_initialized(void);
+int dma_coherent(void *ptr);
+
+void halt(void) __attribute__((noreturn));
+
+#endif /* __HOSTTEST_SHIM_STDLIB_H__ */
@@ -0,0 +1,321 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "net/uip.h"
+#include "net/uip_arp.h"
+#include "hosttest.h"
+
+// The parts of uIP's state uip_arp.c uses, which normally live in uip.c.
+uip_buf_t uip_aligned_buf;
+uint16_t uip_len;
+void *uip_appdata;
+uip_ipaddr_t uip_hostaddr, uip_netmask, uip_draddr;
+struct uip_eth_addr uip_ethaddr = {{ 0x02, 0, 0, 0, 0, 0x02 }};
+const uip_ipaddr_t uip_broadcast_addr = {{ 0xff, 0xff, 0xff, 0xff }};
+const uip_ipaddr_t uip_all_zeroes_addr = {{ 0 }};
+
+typedef struct __attribute__((packed)) {
+	struct uip_eth_hdr eth;
+	uint8_t vhl, tos, len[2], ipid[2], ipoffset[2], ttl, proto;
+	uint16_t ipchksum;
+	uip_ipaddr_t src, dest;
+	uint8_t payload[32];
+} EthIpPacket;
+
+typedef struct __attribute__((packed)) {
+	struct uip_eth_hdr eth;
+	uint16_t hwtype, protocol;
+	uint8_t hwlen, protolen;
+	uint16_t opcode;
+	struct uip_eth_addr shwaddr;
+	uip_ipaddr_t sipaddr;
+	struct uip_eth_addr dhwaddr;
+	uip_ipaddr_t dipaddr;
+} ArpPacket;
+
+static EthIpPacket *const ip_packet = (EthIpPacket *)uip_aligned_buf.u8;
+static ArpPacket *const arp_packet = (ArpPacket *)uip_aligned_buf.u8;
+
+static void host_ip(uip_ipaddr_t *addr, int index)
+{
+	uip_ipaddr(addr, 10, 0, index >> 8, index);
+}
+
+static void host_mac(struct uip_eth_addr *mac, int index)
+{
+	struct uip_eth_addr value = {{ 0x02, 0, 0, 1, index >> 8, index }};
+	*mac = value;
+}
+
+// Queue an IP packet for a host in uip_buf, as uIP would before calling
+// uip_arp_out(), with a marker in the payload.
+static void make_ip(const uip_ipaddr_t *dest, uint8_t marker)
+{
+	memset(ip_packet, 0, sizeof(*ip_packet));
+	ip_packet->vhl = 0x45;
+	uip_ipaddr_copy(&ip_packet->src, &uip_hostaddr);
+	uip_ipaddr_copy(&ip_packet->dest, dest);
+	memset(ip_packet->payload, marker, sizeof(ip_packet->payload));
+	uip_len = sizeof(*ip_packet) - sizeof(struct uip_eth_hdr);
+}
+
+// Feed an ARP packet from a host to uip_arp_arpin().
+static void arp_in(int opcode, int index, const uip_ipaddr_t *target)
+{
+	memset(arp_packet, 0, sizeof(*arp_packet));
+	arp_packet->eth.type = UIP_HTONS(UIP_ETHTYPE_ARP);
+	arp_packet->hwtype = UIP_HTONS(1);
+	arp_packet->protocol = UIP_HTONS(UIP_ETHTYPE_IP);
+	arp_packet->hwlen = 6;
+	arp_packet->protolen = 4;
+	arp_packet->opcode = UIP_HTONS(opcode);
+	host_mac(&arp_packet->shwaddr, index);
+	host_ip(&arp_packet->sipaddr, index);
+	uip_ipaddr_copy(&arp_packet->dipaddr, target);
+	uip_len = sizeof(*arp_packet);
+	uip_arp_arpin();
+}
+
+static void arp_reply(int index)
+{
+	arp_in(2, index, &uip_hostaddr);
+}
+
+// Whether uip_buf holds an ARP request for addr from us.
+static int is_request_for(const uip_ipaddr_t *addr)
+{
+	static const uint8_t broadcast[6] = {
+		0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+	};
+
+	return uip_len == sizeof(ArpPacket) &&
+	       arp_packet->eth.type == UIP_HTONS(UIP_ETHTYPE_ARP) &&
+	       arp_packet->opcode == UIP_HTONS(1) &&
+	       !memcmp(arp_packet->eth.dest.addr, broadcast, 6) &&
+	       !memcmp(&arp_packet->shwaddr, &uip_ethaddr, 6) &&
+	       uip_ipaddr_cmp(&arp_packet->sipaddr, &uip_hostaddr) &&
+	       uip_ipaddr_cmp(&arp_packet->dipaddr, addr);
+}
+
+// Send a packet to a host, and report whether its address was known.
+static int resolves(int index)
+{
+	uip_ipaddr_t addr;
+	struct uip_eth_addr mac;
+
+	host_ip(&addr, index);
+	host_mac(&mac, index);
+	make_ip(&addr, index);
+	uip_arp_out();
+	return uip_len == sizeof(EthIpPacket) &&
+	       ip_packet->eth.type == UIP_HTONS(UIP_ETHTYPE_IP) &&
+	       !memcmp(&ip_packet->eth.dest, &mac, 6);
+}
+
+// The set an address lands in, worked out the same way uip_arp.c does.
+static int arp_set_of(int index)
+{
+	uip_ipaddr_t addr;
+	host_ip(&addr, index);
+	uint16_t hash = addr.u16[0] ^ addr.u16[1];
+	hash ^= hash >> 8;
+	return hash % (CONFIG_UIP_ARPTAB_SIZE / 4);
+}
+
+static void arp_reset(void)
+{
+	uip_ipaddr(&uip_hostaddr, 10, 0, 0, 2);
+	uip_ipaddr(&uip_netmask, 255, 255, 0, 0);
+	uip_ipaddr(&uip_draddr, 10, 0, 0, 1);
+	uip_arp_init();
+}
+
+static void test_arp_pending(void)
+{
+	uip_ipaddr_t addr, outside;
+
+	arp_reset();
+
+	// A miss sets the packet aside and asks for the address instead.
+	host_ip(&addr, 5);
+	make_ip(&addr, 0x55);
+	uip_arp_out();
+	CHECK(is_request_for(&addr));
+
+	// Replies from someone else, or meant for someone else, don't
+	// release it.
+	arp_reply(6);
+	CHECK(uip_len == 0);
+	host_ip(&outside, 7);
+	arp_in(2, 5, &outside);
+	CHECK(uip_len == 0);
+
+	// The reply sends it, addressed to the MAC in the reply.
+	struct uip_eth_addr mac;
+	host_mac(&mac, 5);
+	arp_reply(5);
+	CHECK(uip_len == sizeof(EthIpPacket));
+	CHECK(ip_packet->eth.type == UIP_HTONS(UIP_ETHTYPE_IP));
+	CHECK(!memcmp(&ip_packet->eth.dest, &mac, 6));
+	CHECK(!memcmp(&ip_packet->eth.src, &uip_ethaddr, 6));
+	CHECK(uip_ipaddr_cmp(&ip_packet->dest, &addr));
+	CHECK(ip_packet->payload[0] == 0x55 &&
+	      ip_packet->payload[sizeof(ip_packet->payload) - 1] == 0x55);
+
+	// Only once.
+	arp_reply(5);
+	CHECK(uip_len == 0);
+	CHECK(resolves(5));
+
+	// Only the latest packet waits. An older one is left to be resent.
+	CHECK(!resolves(8));
+	CHECK(!resolves(9));
+	arp_reply(8);
+	CHECK(uip_len == 0);
+	arp_reply(9);
+	CHECK(uip_len == sizeof(EthIpPacket) && ip_packet->payload[0] == 9);
+
+	// Packets off the subnet go through the router.
+	uip_ipaddr(&outside, 192, 168, 1, 1);
+	make_ip(&outside, 0x77);
+	uip_arp_out();
+	CHECK(is_request_for(&uip_draddr));
+	arp_reply(1);
+	CHECK(uip_len == sizeof(EthIpPacket) && ip_packet->payload[0] == 0x77);
+
+	// Requests for our address are answered, and teach us the asker.
+	arp_in(1, 20, &uip_hostaddr);
+	CHECK(uip_len == sizeof(ArpPacket));
+	CHECK(arp_packet->opcode == UIP_HTONS(2));
+	CHECK(!memcmp(&arp_packet->shwaddr, &uip_ethaddr, 6));
+	CHECK(resolves(20));
+
+	// Entries age out.
+	for (int i = 0; i < CONFIG_UIP_ARP_MAXAGE; i++)
+		uip_arp_timer();
+	CHECK(!resolves(20));
+}
+
+static void test_arp_table(void)
+{
+	arp_reset();
+
+	// A subnet's worth of hosts, fewer than the table holds, spread out
+	// well enough to all stay resolved.
+	int hosts = CONFIG_UIP_ARPTAB_SIZE * 3 / 4;
+	for (int i = 0; i < hosts; i++)
+		arp_reply(10 + i);
+	int hits = 0;
+	for (int i = 0; i < hosts; i++)
+		hits += resolves(10 + i);
+	CHECK(hits == hosts);
+
+	// Find five hosts which share a set.
+	arp_reset();
+	int same[5], count = 0;
+	for (int i = 1; count < 5 && i < 0x10000; i++)
+		if (arp_set_of(i) == arp_set_of(1))
+			same[count++] = i;
+	CHECK(count == 5);
+	if (count < 5)
+		return;
+
+	// Filling a set and then adding one more throws out the entry
+	// which was used longest ago, which isn't the oldest one once
+	// it's been used again.
+	for (int i = 0; i < 4; i++)
+		arp_reply(same[i]);
+	CHECK(resolves(same[0]));
+	arp_reply(same[4]);
+	CHECK(resolves(same[0]));
+	CHECK(!resolves(same[1]));
+	CHECK(resolves(same[2]));
+	CHECK(resolves(same[3]));
+	CHECK(resolves(same[4]));
+
+	// Other sets aren't touched.
+	arp_reply(same[1]);
+	for (int i = 1; i < 0x100; i++) {
+		if (arp_set_of(i) != arp_set_of(1))
+			arp_reply(i);
+	}
+	int still = 0;
+	for (int i = 0; i < 5; i++)
+		still += resolves(same[i]);
+	CHECK(still == 4);
+}
+
+static void test_arp_prefetch(void)
+{
+	uip_ipaddr_t addr;
+
+	arp_reset();
+
+	// Prefetching an unknown address asks for it.
+	host_ip(&addr, 30);
+	uip_arp_prefetch(&addr);
+	CHECK(is_request_for(&addr));
+	arp_reply(30);
+	CHECK(uip_len == 0);
+	CHECK(resolves(30));
+
+	// Known and unset addresses don't need anything sent.
+	uip_arp_prefetch(&addr);
+	CHECK(uip_len == 0);
+	uip_arp_prefetch(&uip_all_zeroes_addr);
+	CHECK(uip_len == 0);
+
+	// Mappings can be added directly.
+	struct uip_eth_addr mac;
+	host_ip(&addr, 31);
+	host_mac(&mac, 31);
+	uip_arp_update(&addr, &mac);
+	CHECK(resolves(31));
+
+	// A gratuitous ARP asks for our own address.
+	uip_arp_announce();
+	CHECK(is_request_for(&uip_hostaddr));
+}
+
+void test_arp(void)
+{
+	test_arp_pending();
+	test_arp_table();
+	test_arp_prefetch();
+}
+
+static void bench_arp_out(void *data)
+{
+	for (int i = 0; i < 48; i++)
+		hosttest_use(resolves(10 + i));
+}
+
+static void bench_arp_reply(void *data)
+{
+	for (int i = 0; i < 48; i++)
+		arp_reply(10 + i);
+}
+
+void bench_arp(void)
+{
+	arp_reset();
+	for (int i = 0; i < 48; i++)
+		arp_reply(10 + i);
+	hosttest_bench("arp out, 48 hosts", 100000, 0, &bench_arp_out, NULL);
+	hosttest_bench("arp reply, 48 hosts", 100000, 0, &bench_arp_reply,
+		       NULL);
+}
@@ -0,0 +1,195 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "base/lz4/lz4.h"
+#include "base/lzma/lzma.h"
+#include "module/compression.h"
+#include "hosttest.h"
+
+// The compressed files are made by module/compress.py, which puts a
+// ModuleCompressionHeader in front of the data.
+typedef struct {
+	// The whole image, header included.
+	const uint8_t *image;
+	size_t image_size;
+	// Just the compressed data after the header.
+	const uint8_t *data;
+	size_t size;
+	uint8_t *dest;
+	size_t dest_size;
+} Compressed;
+
+static void *corpus;
+static size_t corpus_size;
+static Compressed lz4, lzma, none;
+
+static void load(Compressed *compressed, const char *name, const char *tag)
+{
+	size_t size;
+	uint8_t *file = hosttest_read_data(name, &size);
+	ModuleCompressionHeader header;
+
+	CHECK(size >= sizeof(header));
+	memcpy(&header, file, sizeof(header));
+	CHECK(!memcmp(&header.format, tag, sizeof(header.format)));
+	CHECK(header.size == corpus_size);
+
+	compressed->image = file;
+	compressed->image_size = size;
+	compressed->data = file + sizeof(header);
+	compressed->size = size - sizeof(header);
+	compressed->dest_size = corpus_size;
+	compressed->dest = malloc(corpus_size);
+}
+
+static void load_all(void)
+{
+	if (corpus)
+		return;
+	corpus = hosttest_read_data("corpus", &corpus_size);
+	load(&lz4, "corpus.lz4", "LZ4F");
+	load(&lzma, "corpus.lzma", "LZMA");
+	load(&none, "corpus.none", "NONE");
+}
+
+static void test_decompressors(void)
+{
+	memset(lz4.dest, 0, lz4.dest_size);
+	CHECK(ulz4fn(lz4.data, lz4.size, lz4.dest, lz4.dest_size) ==
+	      corpus_size);
+	CHECK(!memcmp(lz4.dest, corpus, corpus_size));
+	// Running out of input or output is an error, not a short result.
+	CHECK(ulz4fn(lz4.data, lz4.size / 2, lz4.dest, lz4.dest_size) == 0);
+	CHECK(ulz4fn(lz4.data, lz4.size, lz4.dest, corpus_size / 2) == 0);
+
+	CHECK(ulzma_expanded_size(lzma.data, lzma.size) == corpus_size);
+	memset(lzma.dest, 0, lzma.dest_size);
+	CHECK(ulzman(lzma.data, lzma.size, lzma.dest, lzma.dest_size) ==
+	      corpus_size);
+	CHECK(!memcmp(lzma.dest, corpus, corpus_size));
+	CHECK(ulzman(lzma.data, 4, lzma.dest, lzma.dest_size) == 0);
+}
+
+// Decompress a copy of an image with its header changed.
+static uint32_t decompress_modified(const Compressed *c, uint32_t format,
+				    uint32_t size, uint32_t dest_size)
+{
+	uint8_t *image = malloc(c->image_size);
+	ModuleCompressionHeader header = { format, size };
+
+	memcpy(image, c->image, c->image_size);
+	memcpy(image, &header, sizeof(header));
+	uint32_t ret = module_decompress(image, c->image_size, c->dest,
+					 dest_size);
+	free(image);
+	return ret;
+}
+
+static void test_module_decompress(void)
+{
+	Compressed *all[] = { &lz4, &lzma, &none };
+	const uint32_t formats[] = {
+		ModuleCompressionLz4, ModuleCompressionLzma,
+		ModuleCompressionNone,
+	};
+
+	for (int i = 0; i < 3; i++) {
+		Compressed *c = all[i];
+
+		CHECK(module_expanded_size(c->image, c->image_size) ==
+		      corpus_size);
+		memset(c->dest, 0, c->dest_size);
+		CHECK(module_decompress(c->image, c->image_size, c->dest,
+					c->dest_size) == corpus_size);
+		CHECK(!memcmp(c->dest, corpus, corpus_size));
+
+		// Truncated data.
+		CHECK(module_decompress(c->image, c->image_size / 2, c->dest,
+					c->dest_size) == 0);
+
+		// A header claiming a different size than the data has.
+		CHECK(decompress_modified(c, formats[i], corpus_size - 1,
+					  c->dest_size) == 0);
+
+		// A destination too small for the claimed size is refused
+		// before anything is written to it.
+		memset(c->dest, 0xa5, c->dest_size);
+		CHECK(module_decompress(c->image, c->image_size, c->dest,
+					corpus_size - 1) == 0);
+		CHECK(c->dest[0] == 0xa5 && c->dest[corpus_size / 2] == 0xa5);
+	}
+
+	// An unknown tag, or the right tag on the wrong kind of data.
+	CHECK(decompress_modified(&lz4, 0x4b4e554a, corpus_size,
+				  lz4.dest_size) == 0);
+	CHECK(decompress_modified(&lz4, ModuleCompressionLzma, corpus_size,
+				  lz4.dest_size) == 0);
+	CHECK(decompress_modified(&lzma, ModuleCompressionLz4, corpus_size,
+				  lzma.dest_size) == 0);
+
+	// A header which is cut short.
+	for (uint32_t size = 0; size < sizeof(ModuleCompressionHeader);
+	     size++) {
+		CHECK(module_expanded_size(lz4.image, size) == -1);
+		CHECK(module_decompress(lz4.image, size, lz4.dest,
+					lz4.dest_size) == 0);
+	}
+}
+
+void test_compression(void)
+{
+	load_all();
+	test_decompressors();
+	test_module_decompress();
+}
+
+static void bench_lz4(void *data)
+{
+	Compressed *c = data;
+	hosttest_use(ulz4fn(c->data, c->size, c->dest, c->dest_size));
+}
+
+static void bench_lzma(void *data)
+{
+	Compressed *c = data;
+	hosttest_use(ulzman(c->data, c->size, c->dest, c->dest_size));
+}
+
+// What a module handoff does with the image once it's been read.
+static void bench_module(void *data)
+{
+	Compressed *c = data;
+	hosttest_use(module_decompress(c->image, c->image_size, c->dest,
+				       c->dest_size));
+}
+
+void bench_compression(void)
+{
+	load_all();
+
+	// Throughput is measured in uncompressed bytes.
+	hosttest_bench("lz4 decompress", 200, corpus_size, &bench_lz4, &lz4);
+	hosttest_bench("lzma decompress", 20, corpus_size, &bench_lzma, &lzma);
+
+	hosttest_bench("module handoff none", 200, corpus_size, &bench_module,
+		       &none);
+	hosttest_bench("module handoff lz4", 200, corpus_size, &bench_module,
+		       &lz4);
+	hosttest_bench("module handoff lzma", 20, corpus_size, &bench_module,
+		       &lzma);
+}
@@ -0,0 +1,462 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base/task.h"
+#include "base/time.h"
+#include "drivers/ec/cros/ec.h"
+#include "hosttest.h"
+
+// A fake EC on the other end of a protocol 3 bus, with enough of the flash
+// commands to update its RW image. It refuses what real flash would: erases
+// and writes which aren't aligned to their block sizes, and writes to bytes
+// which haven't been erased since they were last written.
+enum {
+	FlashSize = 0x40000,
+	RwOffset = 0x20000,
+	RwSize = 0x20000,
+	EraseBlock = 0x800,
+	WriteBlock = 16,
+	// Leaves 284 bytes of flash write data, so write bursts are 272
+	// bytes, which doesn't divide the erase block size.
+	PacketSize = 300,
+	Burst = 272,
+};
+
+typedef struct {
+	CrosEcBusOps ops;
+
+	uint8_t flash[FlashSize];
+	uint32_t rw_offset;
+	uint32_t rw_size;
+	int fail_erase;
+	// Act like an old EC without flash info or version 1 writes.
+	int old;
+
+	// Commands seen, and problems with them, since the last reset.
+	int commands;
+	int erases;
+	int writes;
+	uint32_t bytes_written;
+	uint32_t last_write_size;
+	// The lowest and highest flash offsets written.
+	uint32_t write_start;
+	uint32_t write_end;
+	int bad_packets;
+	int bad_erases;
+	int bad_writes;
+} FakeEc;
+
+static FakeEc fake;
+
+static void fake_reset_counts(void)
+{
+	fake.commands = fake.erases = fake.writes = 0;
+	fake.bytes_written = fake.last_write_size = 0;
+	fake.write_start = ~0;
+	fake.write_end = 0;
+	fake.bad_packets = fake.bad_erases = fake.bad_writes = 0;
+}
+
+static uint8_t fake_checksum(const void *data, int size)
+{
+	const uint8_t *bytes = data;
+	uint8_t sum = 0;
+	while (size--)
+		sum += *bytes++;
+	return sum;
+}
+
+static int fake_range_ok(uint32_t offset, uint32_t size)
+{
+	return offset <= FlashSize && size <= FlashSize - offset;
+}
+
+static int fake_erase(const struct ec_params_flash_erase *p)
+{
+	fake.erases++;
+	if (fake.fail_erase)
+		return EC_RES_ERROR;
+	if (p->offset % EraseBlock || p->size % EraseBlock ||
+	    !fake_range_ok(p->offset, p->size)) {
+		fake.bad_erases++;
+		return EC_RES_INVALID_PARAM;
+	}
+	memset(fake.flash + p->offset, 0xff, p->size);
+	return EC_RES_SUCCESS;
+}
+
+static int fake_write(const struct ec_params_flash_write *p, int len)
+{
+	const uint8_t *data = (const uint8_t *)(p + 1);
+
+	fake.writes++;
+	if (p->size != len - sizeof(*p) || p->offset % WriteBlock ||
+	    p->size % WriteBlock || !fake_range_ok(p->offset, p->size)) {
+		fake.bad_writes++;
+		return EC_RES_INVALID_PARAM;
+	}
+	for (uint32_t i = 0; i < p->size; i++) {
+		if (fake.flash[p->offset + i] != 0xff) {
+			fake.bad_writes++;
+			return EC_RES_ERROR;
+		}
+	}
+	memcpy(fake.flash + p->offset, data, p->size);
+
+	fake.bytes_written += p->size;
+	fake.last_write_size = p->size;
+	if (p->offset < fake.write_start)
+		fake.write_start = p->offset;
+	if (p->offset + p->size > fake.write_end)
+		fake.write_end = p->offset + p->size;
+	return EC_RES_SUCCESS;
+}
+
+// Run one command, leaving any response data in out and its size in len.
+static int fake_command(int cmd, const void *in, int in_len, void *out,
+			int *len)
+{
+	switch (cmd) {
+	case EC_CMD_GET_PROTOCOL_INFO: {
+		struct ec_response_get_protocol_info *r = out;
+		memset(r, 0, sizeof(*r));
+		r->protocol_versions = 1 << 3;
+		r->max_request_packet_size = PacketSize;
+		r->max_response_packet_size = PacketSize;
+		*len = sizeof(*r);
+		return EC_RES_SUCCESS;
+	}
+	case EC_CMD_GET_VERSION: {
+		struct ec_response_get_version *r = out;
+		memset(r, 0, sizeof(*r));
+		strcpy(r->version_string_ro, "fake_ec_ro");
+		strcpy(r->version_string_rw, "fake_ec_rw");
+		r->current_image = EC_IMAGE_RO;
+		*len = sizeof(*r);
+		return EC_RES_SUCCESS;
+	}
+	case EC_CMD_HOST_EVENT_CLEAR_B:
+	case EC_CMD_REBOOT_EC:
+		return EC_RES_SUCCESS;
+	case EC_CMD_GET_CMD_VERSIONS: {
+		const struct ec_params_get_cmd_versions *p = in;
+		struct ec_response_get_cmd_versions *r = out;
+		r->version_mask = EC_VER_MASK(0);
+		if (p->cmd == EC_CMD_FLASH_WRITE && !fake.old)
+			r->version_mask |= EC_VER_MASK(EC_VER_FLASH_WRITE);
+		*len = sizeof(*r);
+		return EC_RES_SUCCESS;
+	}
+	case EC_CMD_FLASH_INFO: {
+		struct ec_response_flash_info *r = out;
+		if (fake.old)
+			return EC_RES_INVALID_COMMAND;
+		r->flash_size = FlashSize;
+		r->write_block_size = WriteBlock;
+		r->erase_block_size = EraseBlock;
+		r->protect_block_size = EraseBlock;
+		*len = sizeof(*r);
+		return EC_RES_SUCCESS;
+	}
+	case EC_CMD_FLASH_REGION_INFO: {
+		const struct ec_params_flash_region_info *p = in;
+		struct ec_response_flash_region_info *r = out;
+		if (p->region != EC_FLASH_REGION_RW)
+			return EC_RES_INVALID_PARAM;
+		r->offset = fake.rw_offset;
+		r->size = fake.rw_size;
+		*len = sizeof(*r);
+		return EC_RES_SUCCESS;
+	}
+	case EC_CMD_FLASH_READ: {
+		const struct ec_params_flash_read *p = in;
+		if (!fake_range_ok(p->offset, p->size) ||
+		    p->size > PacketSize - sizeof(struct ec_host_response))
+			return EC_RES_INVALID_PARAM;
+		memcpy(out, fake.flash + p->offset, p->size);
+		*len = p->size;
+		return EC_RES_SUCCESS;
+	}
+	case EC_CMD_FLASH_ERASE:
+		return fake_erase(in);
+	case EC_CMD_FLASH_WRITE:
+		return fake_write(in, in_len);
+	}
+	return EC_RES_INVALID_COMMAND;
+}
+
+static int fake_send_packet(CrosEcBusOps *me, const void *dout,
+			    uint32_t dout_len, void *din, uint32_t din_len)
+{
+	const struct ec_host_request *rq = dout;
+	struct ec_host_response *rs = din;
+	uint8_t data[PacketSize];
+	int len = 0;
+
+	fake.commands++;
+	if (dout_len > PacketSize || dout_len < sizeof(*rq) ||
+	    rq->struct_version != EC_HOST_REQUEST_VERSION ||
+	    rq->data_len != dout_len - sizeof(*rq) ||
+	    fake_checksum(dout, dout_len)) {
+		fake.bad_packets++;
+		return -1;
+	}
+
+	memset(data, 0, sizeof(data));
+	int result = fake_command(rq->command, rq + 1, rq->data_len, data,
+				  &len);
+	if (sizeof(*rs) + len > din_len) {
+		fake.bad_packets++;
+		return -1;
+	}
+
+	memset(rs, 0, sizeof(*rs));
+	rs->struct_version = EC_HOST_RESPONSE_VERSION;
+	rs->result = result;
+	rs->data_len = len;
+	memcpy(rs + 1, data, len);
+	rs->checksum = -fake_checksum(rs, sizeof(*rs) + len);
+	return 0;
+}
+
+// The driver caches what it learns about the EC until it reboots, so pretend
+// it did whenever that changes.
+static void fake_reboot(int old)
+{
+	fake.old = old;
+	CHECK(!cros_ec_reboot(0, EC_REBOOT_CANCEL,
+			      EC_REBOOT_FLAG_ON_AP_SHUTDOWN));
+}
+
+// There are no other tasks to run while the driver waits.
+void task_mdelay(uint64_t ms)
+{
+	mdelay(ms);
+}
+
+static void fake_init(void)
+{
+	static int bus_set;
+
+	memset(fake.flash, 0xff, sizeof(fake.flash));
+	if (!bus_set) {
+		fake.ops.send_packet = &fake_send_packet;
+		CHECK(!cros_ec_set_bus(&fake.ops));
+		bus_set = 1;
+	}
+	fake.rw_offset = RwOffset;
+	fake.rw_size = RwSize;
+	fake_reboot(0);
+}
+
+static void make_image(uint8_t *image, int size, uint32_t seed)
+{
+	for (int i = 0; i < size; i++) {
+		seed = seed * 1103515245 + 12345;
+		image[i] = seed >> 16;
+	}
+}
+
+// Update the RW image and check the region holds it followed by erased
+// flash, and that the driver didn't ask for anything the flash refuses.
+static int update(const uint8_t *image, int size)
+{
+	fake_reset_counts();
+	if (cros_ec_flash_update_rw(0, image, size))
+		return 0;
+
+	const uint8_t *rw = fake.flash + fake.rw_offset;
+	int ok = !memcmp(rw, image, size) && !fake.bad_packets &&
+		 !fake.bad_erases && !fake.bad_writes;
+	for (int i = size; i < fake.rw_size; i++)
+		ok = ok && rw[i] == 0xff;
+	return ok;
+}
+
+static void test_cros_ec_update_rw(void)
+{
+	static uint8_t image[RwSize];
+	// Three and a bit erase blocks.
+	const int size = 3 * EraseBlock + 5;
+
+	fake_init();
+	make_image(image, RwSize, 1);
+
+	// Blank flash only needs the blocks the image covers.
+	CHECK(update(image, size));
+	CHECK(fake.erases == 4);
+	CHECK(fake.bytes_written == 3 * EraseBlock + WriteBlock);
+
+	// Nothing to do when the image is already there.
+	CHECK(update(image, size));
+	CHECK(fake.erases == 0 && fake.writes == 0);
+
+	// One changed byte only rewrites its block, and the write bursts for
+	// it stay inside that block even though they don't divide it.
+	image[EraseBlock + 100] ^= 1;
+	CHECK(update(image, size));
+	CHECK(fake.erases == 1);
+	CHECK(fake.write_start == RwOffset + EraseBlock &&
+	      fake.write_end == RwOffset + 2 * EraseBlock);
+	image[0] ^= 1;
+	CHECK(update(image, size));
+	CHECK(fake.erases == 1);
+	CHECK(fake.write_start == RwOffset &&
+	      fake.write_end == RwOffset + EraseBlock);
+
+	// Every block changed.
+	for (int i = 0; i < size; i++)
+		image[i] ^= 0x5a;
+	CHECK(update(image, size));
+	CHECK(fake.erases == 4);
+
+	// A smaller image erases what's left of the old one past its end.
+	CHECK(update(image, EraseBlock / 2 + 3));
+	CHECK(fake.erases == 4);
+	CHECK(fake.write_end == RwOffset + EraseBlock / 2 + WriteBlock);
+
+	// Trailing erased bytes in a block aren't written.
+	memset(image + EraseBlock + 7, 0xff, EraseBlock - 7);
+	CHECK(update(image, 2 * EraseBlock));
+	CHECK(fake.write_end == RwOffset + EraseBlock + WriteBlock);
+
+	// Sizes around write block, burst and erase block boundaries, each
+	// on top of whatever the last one left behind.
+	static const int sizes[] = {
+		1, WriteBlock - 1, WriteBlock, WriteBlock + 1, Burst - 1,
+		Burst, Burst + 1, EraseBlock - 1, EraseBlock, EraseBlock + 1,
+		7 * Burst, 8 * Burst + 3, RwSize - 1, RwSize, 0,
+	};
+	for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		make_image(image, sizes[i], i + 2);
+		CHECK(update(image, sizes[i]));
+	}
+
+	// Too big for the region.
+	fake_reset_counts();
+	CHECK(cros_ec_flash_update_rw(0, image, RwSize + 1));
+	CHECK(fake.erases == 0 && fake.writes == 0);
+
+	// Erase failures are passed on.
+	make_image(image, size, 99);
+	fake.fail_erase = 1;
+	fake_reset_counts();
+	CHECK(cros_ec_flash_update_rw(0, image, size));
+	CHECK(fake.erases == 1 && fake.writes == 0);
+	fake.fail_erase = 0;
+
+	// Without the erase block size the whole region is erased and
+	// written in one go, in version 0 write bursts.
+	fake_reboot(1);
+	CHECK(update(image, size));
+	CHECK(fake.erases == 1);
+	CHECK(fake.last_write_size == EC_FLASH_WRITE_VER0_SIZE);
+	fake_reboot(0);
+}
+
+static void test_cros_ec_write_padding(void)
+{
+	uint8_t data[2 * Burst], expected[3 * Burst];
+
+	fake_init();
+	make_image(data, sizeof(data), 7);
+
+	// A short final burst is padded out to a whole burst of 0xff.
+	fake_reset_counts();
+	CHECK(!cros_ec_flash_write(0, data, RwOffset, Burst + 100));
+	CHECK(fake.writes == 2 && fake.last_write_size == Burst);
+	memcpy(expected, data, Burst + 100);
+	memset(expected + Burst + 100, 0xff, sizeof(expected) - Burst - 100);
+	CHECK(!memcmp(fake.flash + RwOffset, expected, sizeof(expected)));
+	CHECK(!fake.bad_writes);
+
+	// Whole bursts aren't.
+	fake_reset_counts();
+	CHECK(!cros_ec_flash_write(0, data, RwOffset + EraseBlock,
+				   2 * Burst));
+	CHECK(fake.writes == 2 && fake.bytes_written == 2 * Burst);
+	CHECK(!fake.bad_writes);
+
+	// Reading back goes in bursts too.
+	uint8_t back[2 * Burst];
+	CHECK(!cros_ec_flash_read(0, back, RwOffset + EraseBlock,
+				  sizeof(back)));
+	CHECK(!memcmp(back, data, sizeof(back)));
+}
+
+void test_cros_ec(void)
+{
+	test_cros_ec_update_rw();
+	test_cros_ec_write_padding();
+}
+
+enum {
+	FlipNone = -1,
+	FlipAll = -2,
+};
+
+typedef struct {
+	uint8_t image[RwSize];
+	// Byte to flip before each run, or FlipNone or FlipAll.
+	int flip;
+} CrosEcBench;
+
+static void bench_cros_ec_update(void *data)
+{
+	CrosEcBench *bench = data;
+
+	if (bench->flip >= 0) {
+		bench->image[bench->flip] ^= 1;
+	} else if (bench->flip == FlipAll) {
+		for (int i = 0; i < RwSize; i++)
+			bench->image[i] ^= 0xff;
+	}
+	cros_ec_flash_update_rw(0, bench->image, RwSize);
+}
+
+void bench_cros_ec(void)
+{
+	static const struct {
+		const char *name;
+		int flip;
+		int runs;
+	} cases[] = {
+		{ "cros_ec update_rw same", FlipNone, 100 },
+		{ "cros_ec update_rw 1 block", 5 * EraseBlock + 9, 100 },
+		{ "cros_ec update_rw all", FlipAll, 20 },
+	};
+	static CrosEcBench bench;
+
+	fake_init();
+	make_image(bench.image, RwSize, 1);
+	cros_ec_flash_update_rw(0, bench.image, RwSize);
+
+	for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		bench.flip = cases[i].flip;
+
+		// Host commands are what cost time on a real EC.
+		fake_reset_counts();
+		bench_cros_ec_update(&bench);
+		printf("bench: %-28s %8d commands/op %6d erases/op\n",
+		       cases[i].name, fake.commands, fake.erases);
+
+		hosttest_bench(cases[i].name, cases[i].runs, RwSize,
+			       &bench_cros_ec_update, &bench);
+	}
+}
@@ -0,0 +1,200 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "base/dcdir.h"
+#include "base/dcdir_structs.h"
+#include "hosttest.h"
+
+// An image laid out like a real one: an anchor with the root directory
+// right after it, and a sub directory further in.
+enum {
+	DcDirImageSize = 64 * 1024,
+	DcDirAnchorOffset = 0x100,
+	DcDirSubOffset = 0x8000,
+	DcDirRootRegions = 200,
+};
+
+typedef struct {
+	StorageOps ops;
+	uint8_t *image;
+	int reads;
+} MemStorage;
+
+static int mem_read(StorageOps *me, void *buffer, uint64_t offset,
+		    size_t size)
+{
+	MemStorage *storage = (MemStorage *)me;
+	if (offset > DcDirImageSize || size > DcDirImageSize - offset)
+		return 1;
+	memcpy(buffer, storage->image + offset, size);
+	storage->reads++;
+	return 0;
+}
+
+static uint8_t *put_label(uint8_t *pos, const char *name)
+{
+	memset(pos, 0, 8);
+	memcpy(pos, name, strlen(name));
+	return pos + 8;
+}
+
+static uint8_t *put_small(uint8_t *pos, const char *name, int directory,
+			  uint32_t offset, uint32_t length)
+{
+	pos = put_label(pos, name);
+	DcDirPointerOffset24Length24 ptr = {
+		.type = (DcDirOffset24Length24 << 1) | directory,
+		.size = 0,
+		.offset = { offset, offset >> 8, offset >> 16 },
+		.length = { length - 1, (length - 1) >> 8,
+			    (length - 1) >> 16 },
+	};
+	memcpy(pos, &ptr, sizeof(ptr));
+	return pos + sizeof(ptr);
+}
+
+static uint8_t *put_large(uint8_t *pos, const char *name, uint32_t offset,
+			  uint32_t length)
+{
+	pos = put_label(pos, name);
+	DcDirPointerBase32Offset32Length32 ptr = {
+		.type = DcDirBase32Offset32Length32 << 1,
+		.size = sizeof(ptr) / 8 - 1,
+		.offset = offset,
+		.length = length - 1,
+	};
+	memcpy(pos, &ptr, sizeof(ptr));
+	return pos + sizeof(ptr);
+}
+
+// Write a directory header at start for a table ending at end.
+static void put_header(uint8_t *start, uint8_t *end)
+{
+	uint32_t size = (end - start) / 8 - 1;
+	DcDirDirectoryHeader header = {
+		.signature = { 'D', 'C', 'D', 'R' },
+		.size = { size, size >> 8, size >> 16 },
+	};
+	memcpy(start, &header, sizeof(header));
+}
+
+static void build_image(uint8_t *image)
+{
+	memset(image, 0xff, DcDirImageSize);
+
+	DcDirAnchor anchor = {
+		.signature = { 'D', 'C', ' ', 'D', 'I', 'R' },
+		.major_version = 1,
+		.anchor_offset = DcDirAnchorOffset,
+		// Make the root region start at the beginning of the image.
+		.root_base = DcDirAnchorOffset + sizeof(DcDirAnchor),
+	};
+	memcpy(image + DcDirAnchorOffset, &anchor, sizeof(anchor));
+
+	uint8_t *root = image + DcDirAnchorOffset + sizeof(anchor);
+	uint8_t *pos = root + sizeof(DcDirDirectoryHeader);
+	for (int i = 0; i < DcDirRootRegions; i++) {
+		char name[9];
+		snprintf(name, sizeof(name), "R%03d", i);
+		pos = put_small(pos, name, 0, 0x1000 + i * 16, 16);
+	}
+	// A duplicate label, which should never be found over the first.
+	pos = put_small(pos, "R000", 0, 0x4000, 16);
+	pos = put_large(pos, "LARGE", 0x5000, 0x100);
+	pos = put_small(pos, "SUB", 1, DcDirSubOffset, 0x1000);
+	put_header(root, pos);
+
+	uint8_t *sub = image + DcDirSubOffset;
+	pos = sub + sizeof(DcDirDirectoryHeader);
+	pos = put_small(pos, "A", 0, 0x10, 0x20);
+	put_header(sub, pos);
+}
+
+void test_dcdir(void)
+{
+	static uint8_t image[DcDirImageSize];
+	MemStorage storage = { { .read = &mem_read }, image, 0 };
+	DcDir root = { 0 }, sub = { 0 };
+	DcDirRegion region;
+
+	build_image(image);
+	CHECK(!dcdir_open_root(&root, &storage.ops, DcDirAnchorOffset));
+
+	for (int i = 0; i < DcDirRootRegions; i++) {
+		char name[9];
+		snprintf(name, sizeof(name), "R%03d", i);
+		CHECK(!dcdir_open_region(&region, &storage.ops, &root, name));
+		CHECK(region.offset == 0x1000 + i * 16);
+		CHECK(region.size == 16);
+	}
+
+	CHECK(!dcdir_open_region(&region, &storage.ops, &root, "LARGE"));
+	CHECK(region.offset == 0x5000 && region.size == 0x100);
+
+	CHECK(dcdir_open_region(&region, &storage.ops, &root, "MISSING"));
+	CHECK(dcdir_open_region(&region, &storage.ops, &root, "SUB"));
+	CHECK(dcdir_open_dir(&sub, &storage.ops, &root, "R001"));
+
+	CHECK(!dcdir_open_dir(&sub, &storage.ops, &root, "SUB"));
+	CHECK(!dcdir_open_region(&region, &storage.ops, &sub, "A"));
+	CHECK(region.offset == DcDirSubOffset + 0x10 && region.size == 0x20);
+
+	// One read for the anchor, then a header and a table read for each
+	// of the two directories however many lookups there were.
+	CHECK(storage.reads == 5);
+
+	// Reopening a handle drops its old table, so it's read again.
+	CHECK(!dcdir_open_dir(&sub, &storage.ops, &root, "SUB"));
+	CHECK(root.cache && !sub.cache);
+	CHECK(!dcdir_open_region(&region, &storage.ops, &sub, "A"));
+	CHECK(storage.reads == 7);
+	CHECK(!dcdir_open_root(&root, &storage.ops, DcDirAnchorOffset));
+	CHECK(!root.cache);
+}
+
+typedef struct {
+	MemStorage *storage;
+	DcDir *root;
+} DcDirBench;
+
+static void bench_lookups(void *data)
+{
+	DcDirBench *bench = data;
+	DcDirRegion region;
+
+	for (int i = 0; i < DcDirRootRegions; i++) {
+		char name[9] = { 'R', '0' + i / 100, '0' + i / 10 % 10,
+				 '0' + i % 10 };
+		dcdir_open_region(&region, &bench->storage->ops, bench->root,
+				  name);
+		hosttest_use(region.offset);
+	}
+}
+
+void bench_dcdir(void)
+{
+	static uint8_t image[DcDirImageSize];
+	MemStorage storage = { { .read = &mem_read }, image, 0 };
+	DcDir root = { 0 };
+
+	build_image(image);
+	dcdir_open_root(&root, &storage.ops, DcDirAnchorOffset);
+
+	DcDirBench bench = { &storage, &root };
+	hosttest_bench("dcdir 200 lookups", 20000, 0, &bench_lookups, &bench);
+}
@@ -0,0 +1,525 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <endian.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base/device_tree.h"
+#include "hosttest.h"
+
+// Builds flattened trees the way dtc lays them out: the header, the reserve
+// map, the structure block ending in TokenEnd, then the strings, which
+// properties with the same name share.
+typedef struct {
+	uint8_t structure[64 * 1024];
+	uint32_t struct_size;
+	char strings[4096];
+	uint32_t strings_size;
+	uint64_t reserve[8][2];
+	int reserve_count;
+} FdtBuilder;
+
+enum { FdtHeaderSize = 40 };
+
+static void fdt_put32(FdtBuilder *b, uint32_t val)
+{
+	uint32_t be = htobe32(val);
+	memcpy(b->structure + b->struct_size, &be, sizeof(be));
+	b->struct_size += sizeof(be);
+}
+
+static void fdt_put_padded(FdtBuilder *b, const void *data, uint32_t size)
+{
+	uint32_t padded = ALIGN_UP(size, sizeof(uint32_t));
+	memset(b->structure + b->struct_size, 0, padded);
+	memcpy(b->structure + b->struct_size, data, size);
+	b->struct_size += padded;
+}
+
+static void fdt_begin_node(FdtBuilder *b, const char *name)
+{
+	fdt_put32(b, TokenBeginNode);
+	fdt_put_padded(b, name, strlen(name) + 1);
+}
+
+static void fdt_end_node(FdtBuilder *b)
+{
+	fdt_put32(b, TokenEndNode);
+}
+
+static uint32_t fdt_string(FdtBuilder *b, const char *name)
+{
+	uint32_t offset = 0;
+
+	while (offset < b->strings_size) {
+		if (!strcmp(b->strings + offset, name))
+			return offset;
+		offset += strlen(b->strings + offset) + 1;
+	}
+	strcpy(b->strings + offset, name);
+	b->strings_size += strlen(name) + 1;
+	return offset;
+}
+
+static void fdt_prop(FdtBuilder *b, const char *name, const void *data,
+		     uint32_t size)
+{
+	fdt_put32(b, TokenProperty);
+	fdt_put32(b, size);
+	fdt_put32(b, fdt_string(b, name));
+	fdt_put_padded(b, data, size);
+}
+
+static void fdt_prop_u32(FdtBuilder *b, const char *name, uint32_t val)
+{
+	uint32_t be = htobe32(val);
+	fdt_prop(b, name, &be, sizeof(be));
+}
+
+static void fdt_prop_string(FdtBuilder *b, const char *name, const char *str)
+{
+	fdt_prop(b, name, str, strlen(str) + 1);
+}
+
+static void fdt_reserve(FdtBuilder *b, uint64_t start, uint64_t size)
+{
+	b->reserve[b->reserve_count][0] = htobe64(start);
+	b->reserve[b->reserve_count][1] = htobe64(size);
+	b->reserve_count++;
+}
+
+static uint32_t fdt_finish(FdtBuilder *b, void *blob)
+{
+	uint8_t *dest = blob;
+	uint32_t reserve_size = (b->reserve_count + 1) * 2 * sizeof(uint64_t);
+	uint32_t struct_offset = FdtHeaderSize + reserve_size;
+
+	fdt_put32(b, TokenEnd);
+	uint32_t strings_offset = struct_offset + b->struct_size;
+	uint32_t total = strings_offset + b->strings_size;
+
+	FdtHeader header = {
+		.magic = htobe32(FdtMagic),
+		.totalsize = htobe32(total),
+		.structure_offset = htobe32(struct_offset),
+		.strings_offset = htobe32(strings_offset),
+		.reserve_map_offset = htobe32(FdtHeaderSize),
+		.version = htobe32(17),
+		.last_compatible_version = htobe32(16),
+		.strings_size = htobe32(b->strings_size),
+		.structure_size = htobe32(b->struct_size),
+	};
+	memcpy(dest, &header, sizeof(header));
+	memset(dest + FdtHeaderSize, 0, reserve_size);
+	memcpy(dest + FdtHeaderSize, b->reserve,
+	       b->reserve_count * 2 * sizeof(uint64_t));
+	memcpy(dest + struct_offset, b->structure, b->struct_size);
+	memcpy(dest + strings_offset, b->strings, b->strings_size);
+	return total;
+}
+
+static uint32_t fdt_be32(const void *blob, uint32_t offset)
+{
+	uint32_t be;
+	memcpy(&be, (const uint8_t *)blob + offset, sizeof(be));
+	return be32toh(be);
+}
+
+// A board-like tree with nested address spaces, a compatible list, a
+// property whose size isn't a whole number of cells and an empty one.
+static uint32_t build_test_fdt(void *blob)
+{
+	static FdtBuilder b;
+	static const uint8_t memory_reg[] = {
+		0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x00, 0x00,
+		0x40, 0x00, 0x00, 0x00,
+	};
+	static const char board_compat[] = "vendor,board\0vendor,family";
+	static const char uart2_compat[] = "vendor,uart-v2\0vendor,uart";
+	static const uint8_t odd[] = { 1, 2, 3, 4, 5 };
+
+	memset(&b, 0, sizeof(b));
+	fdt_reserve(&b, 0x1000, 0x2000);
+	fdt_reserve(&b, 0x90000000, 0x100000);
+
+	fdt_begin_node(&b, "");
+	fdt_prop_u32(&b, "#address-cells", 2);
+	fdt_prop_u32(&b, "#size-cells", 1);
+	fdt_prop_string(&b, "model", "Test board");
+	fdt_prop(&b, "compatible", board_compat, sizeof(board_compat));
+
+	fdt_begin_node(&b, "memory");
+	fdt_prop_string(&b, "device_type", "memory");
+	fdt_prop(&b, "reg", memory_reg, sizeof(memory_reg));
+	fdt_end_node(&b);
+
+	fdt_begin_node(&b, "soc");
+	fdt_prop_u32(&b, "#address-cells", 1);
+	fdt_prop_u32(&b, "#size-cells", 1);
+	fdt_prop_string(&b, "compatible", "simple-bus");
+	fdt_prop(&b, "ranges", NULL, 0);
+
+	fdt_begin_node(&b, "uart@1000");
+	fdt_prop_string(&b, "compatible", "vendor,uart");
+	fdt_prop_string(&b, "status", "okay");
+	fdt_end_node(&b);
+
+	fdt_begin_node(&b, "uart@2000");
+	fdt_prop(&b, "compatible", uart2_compat, sizeof(uart2_compat));
+	fdt_prop_string(&b, "status", "disabled");
+	fdt_end_node(&b);
+
+	fdt_begin_node(&b, "i2c@3000");
+	fdt_prop_string(&b, "compatible", "vendor,i2c");
+	fdt_prop(&b, "odd", odd, sizeof(odd));
+	fdt_end_node(&b);
+
+	fdt_end_node(&b);
+
+	fdt_begin_node(&b, "chosen");
+	fdt_prop_string(&b, "bootargs", "console=ttyS0");
+	fdt_end_node(&b);
+
+	fdt_end_node(&b);
+	return fdt_finish(&b, blob);
+}
+
+// Compare two trees node by node, property by property, in order.
+static int dt_same_node(DeviceTreeNode *a, DeviceTreeNode *b)
+{
+	if (strcmp(a->name, b->name))
+		return 0;
+
+	ListNode *la = a->properties.next, *lb = b->properties.next;
+	for (; la && lb; la = la->next, lb = lb->next) {
+		FdtProperty *pa = &container_of(la, DeviceTreeProperty,
+						list_node)->prop;
+		FdtProperty *pb = &container_of(lb, DeviceTreeProperty,
+						list_node)->prop;
+		if (strcmp(pa->name, pb->name) || pa->size != pb->size ||
+		    memcmp(pa->data, pb->data, pa->size))
+			return 0;
+	}
+	if (la || lb)
+		return 0;
+
+	la = a->children.next;
+	lb = b->children.next;
+	for (; la && lb; la = la->next, lb = lb->next) {
+		if (!dt_same_node(container_of(la, DeviceTreeNode, list_node),
+				  container_of(lb, DeviceTreeNode, list_node)))
+			return 0;
+	}
+	return !la && !lb;
+}
+
+static int dt_prop_is(DeviceTreeNode *node, const char *name,
+		      const void *data, size_t size)
+{
+	void *found;
+	size_t found_size;
+
+	dt_find_bin_prop(node, name, &found, &found_size);
+	return found && found_size == size && !memcmp(found, data, size);
+}
+
+// Trees and everything hanging off them are never freed, so keep them
+// reachable.
+static DeviceTree *dt_trees[8];
+
+static uint64_t dt_blob[16 * 1024], dt_flat[16 * 1024], dt_reflat[16 * 1024];
+
+// Flatten a tree and check the result holds together, and that
+// dt_flat_size() got its size right.
+static uint32_t check_flatten(DeviceTree *tree, void *dest, size_t max)
+{
+	uint32_t size = dt_flat_size(tree);
+
+	CHECK(size + 64 <= max);
+	memset(dest, 0xa5, max);
+	dt_flatten(tree, dest);
+
+	uint8_t *bytes = dest;
+	uint32_t struct_offset = fdt_be32(dest, 8);
+	uint32_t strings_offset = fdt_be32(dest, 12);
+	CHECK(fdt_be32(dest, 0) == FdtMagic);
+	CHECK(fdt_be32(dest, 4) == size);
+	CHECK(fdt_be32(dest, 36) % 4 == 0);
+	CHECK(fdt_be32(dest, struct_offset + fdt_be32(dest, 36) - 4) ==
+	      TokenEnd);
+	CHECK(strings_offset + fdt_be32(dest, 32) == size);
+	int untouched = 1;
+	for (int i = size; i < size + 64; i++)
+		if (bytes[i] != 0xa5)
+			untouched = 0;
+	CHECK(untouched);
+	return size;
+}
+
+static void test_dt_round_trip(void)
+{
+	build_test_fdt(dt_blob);
+	DeviceTree *tree = dt_trees[0] = fdt_unflatten(dt_blob);
+
+	CHECK(tree->header_size == FdtHeaderSize);
+	CHECK(tree->root && !strcmp(tree->root->name, ""));
+
+	// The reserve map comes across in order.
+	DeviceTreeReserveMapEntry *entry;
+	int entries = 0;
+	list_for_each(entry, tree->reserve_map, list_node) {
+		CHECK(entry->start == (entries ? 0x90000000 : 0x1000));
+		CHECK(entry->size == (entries ? 0x100000 : 0x2000));
+		entries++;
+	}
+	CHECK(entries == 2);
+
+	// Flattening writes back the same tree, with the same structure
+	// block as dtc, which comes out the same again the next time around.
+	uint32_t size = check_flatten(tree, dt_flat, sizeof(dt_flat));
+	CHECK(fdt_be32(dt_flat, 36) == fdt_be32(dt_blob, 36));
+	DeviceTree *again = dt_trees[1] = fdt_unflatten(dt_flat);
+	CHECK(dt_same_node(tree->root, again->root));
+	CHECK(check_flatten(again, dt_reflat, sizeof(dt_reflat)) == size);
+	CHECK(!memcmp(dt_flat, dt_reflat, size));
+
+	// The walkers for flat trees agree on where nodes end.
+	uint32_t struct_offset = fdt_be32(dt_blob, 8);
+	CHECK(fdt_skip_node(dt_blob, struct_offset) ==
+	      fdt_be32(dt_blob, 36) - sizeof(uint32_t));
+}
+
+static void test_dt_lookup(void)
+{
+	DeviceTree *tree = dt_trees[0];
+	DeviceTreeNode *root = tree->root;
+	uint32_t addrc = 0, sizec = 0;
+
+	// Paths pick up the cell sizes of the nodes they go through.
+	const char *uart_path[] = { "soc", "uart@2000", NULL };
+	DeviceTreeNode *uart2 = dt_find_node(root, uart_path, &addrc, &sizec,
+					     0);
+	CHECK(uart2 && !strcmp(uart2->name, "uart@2000"));
+	CHECK(addrc == 1 && sizec == 1);
+	const char *memory_path[] = { "memory", NULL };
+	DeviceTreeNode *memory = dt_find_node(root, memory_path, &addrc,
+					      &sizec, 0);
+	CHECK(memory && addrc == 2 && sizec == 1);
+	const char *missing_path[] = { "soc", "spi@4000", NULL };
+	CHECK(!dt_find_node(root, missing_path, NULL, NULL, 0));
+
+	// Compatible strings match whole entries of the list anywhere in the
+	// subtree, but not prefixes of them.
+	CHECK(dt_find_compat(root, "vendor,family") == root);
+	CHECK(dt_find_compat(root, "vendor,i2c") &&
+	      !strcmp(dt_find_compat(root, "vendor,i2c")->name, "i2c@3000"));
+	CHECK(!dt_find_compat(root, "vendor,uar"));
+	CHECK(!dt_find_compat(root, "vendor,uart-v2x"));
+
+	const char *soc_path[] = { "soc", NULL };
+	DeviceTreeNode *soc = dt_find_node(root, soc_path, NULL, NULL, 0);
+	DeviceTreeNode *uart = dt_find_next_compat_child(soc, NULL,
+							 "vendor,uart");
+	CHECK(uart && !strcmp(uart->name, "uart@1000"));
+	uart = dt_find_next_compat_child(soc, uart, "vendor,uart");
+	CHECK(uart == uart2);
+	CHECK(!dt_find_next_compat_child(soc, uart, "vendor,uart"));
+
+	CHECK(dt_find_prop_value(root, "status", "disabled", 9) == uart2);
+	CHECK(!dt_find_prop_value(root, "status", "disable", 8));
+
+	CHECK(!strcmp(dt_find_string_prop(root, "model"), "Test board"));
+	CHECK(!dt_find_string_prop(root, "serial-number"));
+	void *data;
+	size_t size;
+	dt_find_bin_prop(soc, "ranges", &data, &size);
+	CHECK(data && size == 0);
+}
+
+static int dt_fixup_calls;
+
+static int dt_count_fixup(DeviceTreeFixup *fixup, DeviceTree *tree)
+{
+	dt_fixup_calls++;
+	return 0;
+}
+
+static int dt_chosen_fixup(DeviceTreeFixup *fixup, DeviceTree *tree)
+{
+	const char *path[] = { "chosen", NULL };
+	DeviceTreeNode *chosen = dt_find_node(tree->root, path, NULL, NULL, 1);
+	dt_add_string_prop(chosen, "bootargs", "console=ttyS0 quiet");
+	return 0;
+}
+
+static int dt_failing_fixup(DeviceTreeFixup *fixup, DeviceTree *tree)
+{
+	return 1;
+}
+
+static void test_dt_edit(void)
+{
+	build_test_fdt(dt_blob);
+	DeviceTree *tree = dt_trees[2] = fdt_unflatten(dt_blob);
+	DeviceTreeNode *root = tree->root;
+	uint32_t addrc = 0, sizec = 0;
+
+	// Missing nodes are created along the way when asked.
+	const char *path[] = { "firmware", "coreboot", NULL };
+	DeviceTreeNode *coreboot = dt_find_node(root, path, &addrc, &sizec,
+						1);
+	CHECK(coreboot && !strcmp(coreboot->name, "coreboot"));
+	CHECK(dt_find_node(root, path, NULL, NULL, 0) == coreboot);
+
+	// Properties of each kind, big endian, and registers sized by the
+	// cells in effect.
+	uint64_t addrs[] = { 0x123456789a, 0x2000 };
+	uint64_t sizes[] = { 0x1000, 0x30 };
+	static const uint8_t reg[] = {
+		0x00, 0x00, 0x00, 0x12, 0x34, 0x56, 0x78, 0x9a,
+		0x00, 0x00, 0x10, 0x00,
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0x00,
+		0x00, 0x00, 0x00, 0x30,
+	};
+	static const uint8_t u32[] = { 0xde, 0xad, 0xbe, 0xef };
+	dt_add_reg_prop(coreboot, addrs, sizes, 2, addrc, sizec);
+	dt_add_u32_prop(coreboot, "magic", 0xdeadbeef);
+	dt_add_string_prop(coreboot, "compatible", "coreboot");
+	CHECK(dt_prop_is(coreboot, "reg", reg, sizeof(reg)));
+	CHECK(dt_prop_is(coreboot, "magic", u32, sizeof(u32)));
+	CHECK(dt_find_compat(root, "coreboot") == coreboot);
+
+	uint8_t bytes[5];
+	dt_write_int(bytes, 0x0102030405, sizeof(bytes));
+	CHECK(!memcmp(bytes, "\x01\x02\x03\x04\x05", sizeof(bytes)));
+
+	// Updating a property replaces it rather than adding another.
+	dt_add_string_prop(coreboot, "label", "old");
+	dt_add_string_prop(coreboot, "label", "new");
+	CHECK(!strcmp(dt_find_string_prop(coreboot, "label"), "new"));
+	int count = 0;
+	DeviceTreeProperty *prop;
+	list_for_each(prop, coreboot->properties, list_node)
+		count++;
+	CHECK(count == 4);
+
+	// Fixups run in order, and stop at the first one which fails.
+	static DeviceTreeFixup count_fixup = { &dt_count_fixup };
+	static DeviceTreeFixup chosen_fixup = { &dt_chosen_fixup };
+	static DeviceTreeFixup failing_fixup = { &dt_failing_fixup };
+	list_insert_after(&count_fixup.list_node, &device_tree_fixups);
+	list_insert_after(&chosen_fixup.list_node, &count_fixup.list_node);
+	CHECK(!dt_apply_fixups(tree));
+	CHECK(dt_fixup_calls == 1);
+	list_insert_after(&failing_fixup.list_node, &device_tree_fixups);
+	CHECK(dt_apply_fixups(tree));
+	CHECK(dt_fixup_calls == 1);
+	list_remove(&failing_fixup.list_node);
+	list_remove(&chosen_fixup.list_node);
+	list_remove(&count_fixup.list_node);
+
+	// The edits survive being flattened.
+	check_flatten(tree, dt_flat, sizeof(dt_flat));
+	DeviceTree *flat = dt_trees[3] = fdt_unflatten(dt_flat);
+	CHECK(dt_same_node(tree->root, flat->root));
+	const char *chosen_path[] = { "chosen", NULL };
+	DeviceTreeNode *chosen = dt_find_node(flat->root, chosen_path, NULL,
+					      NULL, 0);
+	CHECK(chosen && !strcmp(dt_find_string_prop(chosen, "bootargs"),
+				"console=ttyS0 quiet"));
+	CHECK(dt_prop_is(dt_find_node(flat->root, path, NULL, NULL, 0),
+			 "reg", reg, sizeof(reg)));
+}
+
+void test_device_tree(void)
+{
+	test_dt_round_trip();
+	test_dt_lookup();
+	test_dt_edit();
+}
+
+// Something the size of a kernel's tree for a small board: 64 devices with
+// 8 properties and 2 children of their own with 4 each.
+static uint32_t build_bench_fdt(void *blob)
+{
+	static FdtBuilder b;
+	char name[32];
+
+	memset(&b, 0, sizeof(b));
+	fdt_begin_node(&b, "");
+	fdt_prop_u32(&b, "#address-cells", 1);
+	fdt_prop_u32(&b, "#size-cells", 1);
+	for (int i = 0; i < 64; i++) {
+		snprintf(name, sizeof(name), "device@%x", i * 0x1000);
+		fdt_begin_node(&b, name);
+		snprintf(name, sizeof(name), "vendor,device-%d", i);
+		fdt_prop_string(&b, "compatible", name);
+		fdt_prop_u32(&b, "reg", i * 0x1000);
+		fdt_prop_u32(&b, "interrupts", i);
+		fdt_prop_u32(&b, "clocks", i);
+		fdt_prop_string(&b, "clock-names", "core");
+		fdt_prop_u32(&b, "#address-cells", 1);
+		fdt_prop_u32(&b, "#size-cells", 0);
+		fdt_prop_string(&b, "status", "okay");
+		for (int j = 0; j < 2; j++) {
+			snprintf(name, sizeof(name), "port@%d", j);
+			fdt_begin_node(&b, name);
+			fdt_prop_u32(&b, "reg", j);
+			fdt_prop_u32(&b, "remote", i);
+			fdt_prop_string(&b, "label", name);
+			fdt_prop_string(&b, "status", "okay");
+			fdt_end_node(&b);
+		}
+		fdt_end_node(&b);
+	}
+	fdt_end_node(&b);
+	return fdt_finish(&b, blob);
+}
+
+static void bench_unflatten(void *data)
+{
+	hosttest_use((uintptr_t)fdt_unflatten(data));
+}
+
+static void bench_flatten(void *data)
+{
+	DeviceTree *tree = data;
+	dt_flat_size(tree);
+	dt_flatten(tree, dt_flat);
+}
+
+static void bench_find_compat(void *data)
+{
+	DeviceTree *tree = data;
+	hosttest_use((uintptr_t)dt_find_compat(tree->root,
+					       "vendor,device-63"));
+}
+
+void bench_device_tree(void)
+{
+	uint32_t size = build_bench_fdt(dt_blob);
+	DeviceTree *tree = fdt_unflatten(dt_blob);
+
+	// Only the first passes get nodes from the static pools, which is
+	// what happens at boot; the rest come from the host's malloc().
+	hosttest_bench("fdt_unflatten 193 nodes", 100, size, &bench_unflatten,
+		       dt_blob);
+	hosttest_bench("dt_flatten 193 nodes", 2000, size, &bench_flatten,
+		       tree);
+	hosttest_bench("dt_find_compat last of 193", 20000, 0,
+		       &bench_find_compat, tree);
+}
@@ -0,0 +1,212 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "base/fwdb.h"
+#include "hosttest.h"
+
+// The header is private to fwdb.c, so the tests poke at it by offset.
+enum {
+	FwdbMajorOffset = 0,
+	FwdbSignatureOffset = 2,
+	FwdbMaxSizeOffset = 16,
+	FwdbHeaderSize = 24,
+	FwdbRegionSize = 4096,
+};
+
+static uint64_t fwdb_region[FwdbRegionSize / sizeof(uint64_t)];
+static uint64_t fwdb_copy[FwdbRegionSize / sizeof(uint64_t)];
+
+static void fwdb_set_max_size(void *db, uint32_t max_size)
+{
+	memcpy((uint8_t *)db + FwdbMaxSizeOffset, &max_size,
+	       sizeof(max_size));
+}
+
+static int fwdb_add(const char *name, const void *data, size_t size)
+{
+	FwdbEntry new_entry = { (void *)data, size };
+	return fwdb_access(name, NULL, &new_entry);
+}
+
+// Fill entries with something derived from their names, so each can be
+// told apart and checked after the table has moved.
+static void fwdb_fill(uint8_t *data, const char *name, size_t size)
+{
+	size_t len = strlen(name);
+	for (size_t i = 0; i < size; i++)
+		data[i] = name[i % len] + i;
+}
+
+static int fwdb_check_entry(const char *name, size_t size)
+{
+	uint8_t expected[256];
+	FwdbEntry entry;
+
+	fwdb_fill(expected, name, size);
+	return !fwdb_access(name, &entry, NULL) && entry.size == size &&
+	       !((uintptr_t)entry.ptr % sizeof(uint64_t)) &&
+	       !memcmp(entry.ptr, expected, size);
+}
+
+static void test_fwdb_entries(void)
+{
+	static const char *const names[] = {
+		"a", "bb", "ccc", "dddd", "eeeee", "ffffff", "ggggggg",
+		"hhhhhhhh", "a longer name which takes several words",
+	};
+	const int count = sizeof(names) / sizeof(names[0]);
+	uint8_t data[256];
+	FwdbEntry entry;
+
+	memset(fwdb_region, 0xff, sizeof(fwdb_region));
+	CHECK(!fwdb_create_db(fwdb_region, sizeof(fwdb_region)));
+	CHECK(fwdb_db_pointer() == (FwdbHeader *)fwdb_region);
+	CHECK(fwdb_db_max_size() == sizeof(fwdb_region));
+
+	// Names and data of every length up to and past a whole number of
+	// words, so all the padding cases come up.
+	for (int i = 0; i < count; i++) {
+		fwdb_fill(data, names[i], i * 3 + 1);
+		CHECK(!fwdb_add(names[i], data, i * 3 + 1));
+	}
+	for (int i = 0; i < count; i++)
+		CHECK(fwdb_check_entry(names[i], i * 3 + 1));
+
+	// New entries without data start out zeroed.
+	FwdbEntry zeroed = { NULL, 40 };
+	CHECK(!fwdb_access("zeroed", &entry, &zeroed));
+	CHECK(entry.size == 40);
+	memset(data, 0, 40);
+	CHECK(!memcmp(entry.ptr, data, 40));
+	memset(entry.ptr, 0x5a, 40);
+
+	// Names have to be unique, but asking for an entry which might
+	// already be there returns the existing one.
+	CHECK(fwdb_add("bb", NULL, 8));
+	CHECK(!fwdb_access("zeroed", &entry, &zeroed));
+	memset(data, 0x5a, 40);
+	CHECK(entry.size == 40 && !memcmp(entry.ptr, data, 40));
+	CHECK(fwdb_access("missing", &entry, NULL));
+
+	// The table can be handed over somewhere else and picked up again.
+	memcpy(fwdb_copy, fwdb_region, sizeof(fwdb_copy));
+	memset(fwdb_region, 0, sizeof(fwdb_region));
+	CHECK(!fwdb_use_db((FwdbHeader *)fwdb_copy));
+	for (int i = 0; i < count; i++)
+		CHECK(fwdb_check_entry(names[i], i * 3 + 1));
+	CHECK(!fwdb_access("zeroed", &entry, NULL));
+	CHECK((uint8_t *)entry.ptr > (uint8_t *)fwdb_copy);
+	CHECK((uint8_t *)entry.ptr < (uint8_t *)fwdb_copy + sizeof(fwdb_copy));
+}
+
+static void test_fwdb_bounds(void)
+{
+	uint8_t data[64];
+
+	// The header and the terminating size have to fit.
+	CHECK(fwdb_create_db(fwdb_region, FwdbHeaderSize + 3));
+	CHECK(!fwdb_create_db(fwdb_region, FwdbHeaderSize + 4));
+	CHECK(fwdb_add("x", NULL, 0));
+
+	// An entry named "entry" holding 20 bytes takes 4 + 6 bytes for its
+	// size and name, padded to 16, then 20 of data padded to 24. The
+	// table just has room for that and the terminating size.
+	const uint32_t exact = FwdbHeaderSize + 16 + 24 + 4;
+	memset(fwdb_region, 0xff, sizeof(fwdb_region));
+	CHECK(!fwdb_create_db(fwdb_region, exact));
+	fwdb_fill(data, "entry", 20);
+	CHECK(!fwdb_add("entry", data, 20));
+	CHECK(fwdb_add("more", NULL, 0));
+	CHECK(fwdb_check_entry("entry", 20));
+	CHECK(!fwdb_use_db((FwdbHeader *)fwdb_region));
+
+	CHECK(!fwdb_create_db(fwdb_region, exact - 1));
+	CHECK(fwdb_add("entry", data, 20));
+	CHECK(!fwdb_add("entry", data, 12));
+
+	// Picking up an existing table checks it fits the size it claims,
+	// padding included.
+	CHECK(!fwdb_create_db(fwdb_region, exact));
+	CHECK(!fwdb_add("entry", data, 20));
+	memcpy(fwdb_copy, fwdb_region, exact);
+	fwdb_set_max_size(fwdb_copy, exact - 1);
+	CHECK(fwdb_use_db((FwdbHeader *)fwdb_copy));
+	fwdb_set_max_size(fwdb_copy, exact - 4);
+	CHECK(fwdb_use_db((FwdbHeader *)fwdb_copy));
+	fwdb_set_max_size(fwdb_copy, exact);
+	CHECK(!fwdb_use_db((FwdbHeader *)fwdb_copy));
+
+	// A name which runs off the end of its entry.
+	uint8_t *entry = (uint8_t *)fwdb_copy + FwdbHeaderSize;
+	uint32_t short_size = 8;
+	memcpy(entry, &short_size, sizeof(short_size));
+	memcpy(entry + 4, "longname", 8);
+	CHECK(fwdb_use_db((FwdbHeader *)fwdb_copy));
+
+	// Something else entirely.
+	memcpy(fwdb_copy, fwdb_region, exact);
+	((uint8_t *)fwdb_copy)[FwdbSignatureOffset] ^= 1;
+	CHECK(fwdb_use_db((FwdbHeader *)fwdb_copy));
+	memcpy(fwdb_copy, fwdb_region, exact);
+	((uint8_t *)fwdb_copy)[FwdbMajorOffset]++;
+	CHECK(fwdb_use_db((FwdbHeader *)fwdb_copy));
+
+	// Tables which are turned down don't replace the last good one.
+	CHECK(fwdb_db_pointer() == (FwdbHeader *)fwdb_copy);
+}
+
+void test_fwdb(void)
+{
+	// Nothing works before there's a table.
+	FwdbEntry entry;
+	CHECK(fwdb_access("early", &entry, NULL));
+	CHECK(!fwdb_db_max_size());
+
+	test_fwdb_entries();
+	test_fwdb_bounds();
+}
+
+enum { FwdbBenchEntries = 64 };
+
+static void bench_lookup(void *data)
+{
+	FwdbEntry entry;
+	hosttest_use(fwdb_access(data, &entry, NULL));
+}
+
+static void bench_create(void *data)
+{
+	char name[16];
+
+	fwdb_create_db(fwdb_region, sizeof(fwdb_region));
+	for (int i = 0; i < FwdbBenchEntries; i++) {
+		snprintf(name, sizeof(name), "entry %d", i);
+		fwdb_add(name, NULL, 32);
+	}
+}
+
+void bench_fwdb(void)
+{
+	hosttest_bench("fwdb create 64 entries", 20000, 0, &bench_create,
+		       NULL);
+	// The table's a list, so the last entry is the slowest to find.
+	hosttest_bench("fwdb find first of 64", 1000000, 0, &bench_lookup,
+		       "entry 0");
+	hosttest_bench("fwdb find last of 64", 100000, 0, &bench_lookup,
+		       "entry 63");
+}
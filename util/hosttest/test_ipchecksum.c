@@ -0,0 +1,110 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "base/ipchecksum.h"
+#include "hosttest.h"
+
+// The RFC 1071 algorithm one 16 bit word at a time, in memory order.
+static uint16_t reference_sum(const uint8_t *data, size_t size)
+{
+	uint32_t sum = 0;
+	size_t i;
+
+	for (i = 0; i + 1 < size; i += 2) {
+		uint16_t word;
+		memcpy(&word, data + i, sizeof(word));
+		sum += word;
+	}
+	if (i < size) {
+		uint16_t word = 0;
+		memcpy(&word, data + i, 1);
+		sum += word;
+	}
+	while (sum >> 16)
+		sum = (sum & 0xffff) + (sum >> 16);
+	return sum;
+}
+
+void test_ipchecksum(void)
+{
+	uint8_t buf[1600], copy[1600];
+
+	hosttest_fill_corpus(buf, sizeof(buf));
+	for (int i = 0; i < sizeof(buf); i += 7)
+		buf[i] = 0xff;
+
+	// Every length at every alignment, since the word-at-a-time code has
+	// separate paths for the head and tail.
+	for (size_t offset = 0; offset < 8; offset++) {
+		for (size_t size = 0; size <= 300; size++) {
+			const uint8_t *data = buf + offset;
+			uint16_t sum = reference_sum(data, size);
+			CHECK(ipchecksum(data, size) == (uint16_t)~sum);
+
+			memset(copy, 0, sizeof(copy));
+			CHECK(ipchecksum_copy(copy + offset, data, size) ==
+			      sum);
+			CHECK(!memcmp(copy + offset, data, size));
+		}
+	}
+
+	// Summing in pieces matches summing in one go, as long as each piece
+	// but the last has an even length.
+	uint16_t sum = 0;
+	for (size_t pos = 0; pos < 1500; pos += 100)
+		sum = ipchecksum_add(sum, buf + pos, 100);
+	CHECK(sum == reference_sum(buf, 1500));
+
+	// A packet with its own checksum filled in checks out as zero.
+	memset(buf, 0, 20);
+	uint16_t check = ipchecksum(buf + 20, 1480);
+	memcpy(buf, &check, sizeof(check));
+	CHECK(ipchecksum(buf, 1500) == 0);
+}
+
+typedef struct {
+	const uint8_t *src;
+	uint8_t *dest;
+	size_t size;
+} ChecksumBench;
+
+static void bench_sum(void *data)
+{
+	ChecksumBench *bench = data;
+	hosttest_use(ipchecksum(bench->src, bench->size));
+}
+
+static void bench_copy(void *data)
+{
+	ChecksumBench *bench = data;
+	hosttest_use(ipchecksum_copy(bench->dest, bench->src, bench->size));
+}
+
+void bench_ipchecksum(void)
+{
+	static uint8_t src[64 * 1024], dest[64 * 1024];
+	hosttest_fill_corpus(src, sizeof(src));
+
+	ChecksumBench packet = { src, dest, 1500 };
+	ChecksumBench large = { src, dest, sizeof(src) };
+	hosttest_bench("ipchecksum 1500", 200000, packet.size,
+		       &bench_sum, &packet);
+	hosttest_bench("ipchecksum 64K", 5000, large.size,
+		       &bench_sum, &large);
+	hosttest_bench("ipchecksum_copy 1500", 200000, packet.size,
+		       &bench_copy, &packet);
+}
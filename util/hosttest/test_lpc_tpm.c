@@ -0,0 +1,419 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <endian.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base/cleanup.h"
+#include "base/time.h"
+#include "drivers/tpm/lpc.h"
+#include "hosttest.h"
+
+// A fake TIS FIFO behind locality 0 of the LPC TPM driver. It enforces what
+// a real part would: no more bytes are moved than the last burst count
+// allowed, nothing is written past the end of a command or read past the end
+// of a response, and XDATA is only used if the interface advertises it.
+enum {
+	RegAccess = 0x00,
+	RegIntCapability = 0x14,
+	RegSts = 0x18,
+	RegData = 0x24,
+	RegInterfaceId = 0x30,
+	RegXdata = 0x80,
+	RegDidVid = 0xf00,
+
+	LocalitySize = 0x1000,
+	FifoSize = 4096,
+	HeaderSize = 6,
+};
+
+enum {
+	StsValid = 0x80,
+	StsCommandReady = 0x40,
+	StsTpmGo = 0x20,
+	StsDataAvailable = 0x10,
+	StsExpect = 0x08,
+
+	AccessValid = 0x80,
+	AccessActiveLocality = 0x20,
+	AccessRequestUse = 0x02,
+};
+
+typedef struct {
+	// Configuration.
+	int burst_max;
+	int xdata;
+	// Bytes of response to make available, and the size in its header.
+	int rsp_len;
+	uint32_t rsp_size_field;
+	// Never finish executing a command.
+	int stuck;
+
+	// FIFO state.
+	int active;
+	int go;
+	uint8_t cmd[FifoSize];
+	int cmd_count;
+	// Size of the last command executed.
+	int executed;
+	uint8_t rsp[FifoSize];
+	int rsp_pos;
+	// Bytes moved since the burst count was last read, and that count.
+	int moved;
+	int granted;
+
+	// Problems seen, and accesses made, since the last reset.
+	int burst_violations;
+	int overruns;
+	int xdata_misuse;
+	int accesses;
+	int xdata_accesses;
+} FakeTpm;
+
+static uint8_t fake_regs[5 * LocalitySize];
+static FakeTpm fake;
+
+static void fake_reset(int burst_max, int xdata)
+{
+	int active = fake.active;
+	memset(&fake, 0, sizeof(fake));
+	fake.burst_max = burst_max;
+	fake.xdata = xdata;
+	fake.active = active;
+}
+
+static int fake_offset(const volatile void *addr)
+{
+	return (const volatile uint8_t *)addr - fake_regs;
+}
+
+static int fake_cmd_size(void)
+{
+	uint32_t size;
+	if (fake.cmd_count < HeaderSize)
+		return HeaderSize;
+	memcpy(&size, fake.cmd + 2, sizeof(size));
+	return be32toh(size);
+}
+
+static int fake_burst(void)
+{
+	if (fake.go) {
+		int left = fake.stuck ? 0 : fake.rsp_len - fake.rsp_pos;
+		return left < fake.burst_max ? left : fake.burst_max;
+	}
+	return fake.burst_max;
+}
+
+static uint8_t fake_sts(void)
+{
+	uint8_t sts = StsValid;
+	if (fake.go) {
+		if (!fake.stuck && fake.rsp_pos < fake.rsp_len)
+			sts |= StsDataAvailable;
+	} else {
+		if (fake.cmd_count < fake_cmd_size())
+			sts |= StsExpect;
+		if (!fake.cmd_count)
+			sts |= StsCommandReady;
+	}
+	return sts;
+}
+
+static void fake_move(void)
+{
+	if (++fake.moved > fake.granted)
+		fake.burst_violations++;
+}
+
+static void fake_data_write(uint8_t value)
+{
+	fake_move();
+	if (fake.go || fake.cmd_count >= fake_cmd_size() ||
+	    fake.cmd_count == FifoSize) {
+		fake.overruns++;
+		return;
+	}
+	fake.cmd[fake.cmd_count++] = value;
+}
+
+static uint8_t fake_data_read(void)
+{
+	fake_move();
+	if (!fake.go || fake.rsp_pos >= fake.rsp_len) {
+		fake.overruns++;
+		return 0xff;
+	}
+	return fake.rsp[fake.rsp_pos++];
+}
+
+// The response pattern depends on the offset so misplaced bytes show up.
+static uint8_t rsp_byte(int offset)
+{
+	return offset * 7 + 3;
+}
+
+static void fake_execute(void)
+{
+	fake.go = 1;
+	fake.executed = fake.cmd_count;
+	fake.rsp_pos = 0;
+	fake.rsp[0] = 0x80;
+	fake.rsp[1] = 0x01;
+	uint32_t size = htobe32(fake.rsp_size_field);
+	memcpy(fake.rsp + 2, &size, sizeof(size));
+	for (int i = HeaderSize; i < fake.rsp_len; i++)
+		fake.rsp[i] = rsp_byte(i);
+}
+
+uint8_t read8(const volatile void *addr)
+{
+	fake.accesses++;
+	switch (fake_offset(addr)) {
+	case RegAccess:
+		return AccessValid | (fake.active ? AccessActiveLocality : 0);
+	case RegSts:
+		return fake_sts();
+	case RegData:
+		return fake_data_read();
+	}
+	return 0;
+}
+
+void write8(volatile void *addr, uint8_t value)
+{
+	fake.accesses++;
+	switch (fake_offset(addr)) {
+	case RegAccess:
+		if (value == AccessActiveLocality)
+			fake.active = 0;
+		else if (value == AccessRequestUse)
+			fake.active = 1;
+		break;
+	case RegSts:
+		if (value == StsCommandReady) {
+			fake.go = 0;
+			fake.cmd_count = 0;
+		} else if (value == StsTpmGo && !fake.go &&
+			   fake.cmd_count == fake_cmd_size()) {
+			fake_execute();
+		}
+		break;
+	case RegData:
+		fake_data_write(value);
+		break;
+	}
+}
+
+uint32_t read32(const volatile void *addr)
+{
+	fake.accesses++;
+	switch (fake_offset(addr)) {
+	case RegIntCapability:
+		// Data transfer size support, 8 bytes or more.
+		return fake.xdata ? 0x3 << 9 : 0;
+	case RegSts:
+		fake.moved = 0;
+		fake.granted = fake_burst();
+		return fake_sts() | fake.granted << 8;
+	case RegInterfaceId:
+		return fake.xdata ? 0 : 0xffffffff;
+	case RegXdata: {
+		fake.xdata_accesses++;
+		if (!fake.xdata)
+			fake.xdata_misuse++;
+		uint32_t word = 0;
+		for (int i = 0; i < 4; i++)
+			word |= (uint32_t)fake_data_read() << (8 * i);
+		return word;
+	}
+	case RegDidVid:
+		// An Infineon SLB9660.
+		return 0x001a15d1;
+	}
+	return 0;
+}
+
+void write32(volatile void *addr, uint32_t value)
+{
+	fake.accesses++;
+	if (fake_offset(addr) != RegXdata)
+		return;
+	fake.xdata_accesses++;
+	if (!fake.xdata)
+		fake.xdata_misuse++;
+	for (int i = 0; i < 4; i++)
+		fake_data_write(value >> (8 * i));
+}
+
+// The driver's close on handoff isn't exercised here.
+void cleanup_add(CleanupEvent *event)
+{
+}
+
+static void make_cmd(uint8_t *cmd, int size)
+{
+	for (int i = 0; i < size; i++)
+		cmd[i] = i * 3 + 1;
+	cmd[0] = 0x80;
+	cmd[1] = 0x01;
+	uint32_t be_size = htobe32(size);
+	memcpy(cmd + 2, &be_size, sizeof(be_size));
+}
+
+// Send a command of cmd_size bytes and expect a response of rsp_len.
+static int transfer(int burst_max, int xdata, int cmd_size, int rsp_len)
+{
+	fake_reset(burst_max, xdata);
+	fake.rsp_len = rsp_len;
+	fake.rsp_size_field = rsp_len;
+
+	LpcTpm *tpm = new_lpc_tpm(fake_regs);
+	uint8_t cmd[FifoSize], rsp[FifoSize];
+	make_cmd(cmd, cmd_size);
+	size_t len = sizeof(rsp);
+	int ret = tpm->ops.xmit(&tpm->ops, cmd, cmd_size, rsp, &len);
+	int ok = !ret && fake.executed == cmd_size &&
+		 !memcmp(fake.cmd, cmd, cmd_size) && len == rsp_len &&
+		 !memcmp(rsp, fake.rsp, rsp_len) &&
+		 tpm->xdata == xdata && !fake.burst_violations &&
+		 !fake.overruns && !fake.xdata_misuse &&
+		 // Bursts too short for a word go a byte at a time.
+		 !!fake.xdata_accesses == (xdata && burst_max >= 4);
+	if (!ok)
+		printf("lpc_tpm: burst %d xdata %d cmd %d rsp %d failed\n",
+		       burst_max, xdata, cmd_size, rsp_len);
+	free(tpm);
+	return ok;
+}
+
+static void test_lpc_tpm_bursts(void)
+{
+	// Sizes around word and header boundaries, including a response of
+	// only a header and one which ends a byte past it.
+	static const int sizes[][2] = {
+		{ 10, 6 }, { 10, 7 }, { 11, 9 }, { 12, 10 }, { 13, 14 },
+		{ 63, 64 }, { 64, 65 }, { 65, 63 }, { 269, 272 },
+		{ 1024, 2048 },
+	};
+
+	for (int xdata = 0; xdata < 2; xdata++) {
+		for (int burst = 1; burst <= 64; burst++) {
+			for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+				CHECK(transfer(burst, xdata, sizes[i][0],
+					       sizes[i][1]));
+		}
+	}
+
+	// A TPM without XDATA after one with it, and the other way around.
+	CHECK(transfer(59, 1, 64, 64));
+	CHECK(transfer(59, 0, 64, 64));
+	CHECK(transfer(59, 1, 64, 64));
+}
+
+static int bad_response(uint32_t size_field, int rsp_len, size_t len)
+{
+	fake_reset(59, 1);
+	fake.rsp_len = rsp_len;
+	fake.rsp_size_field = size_field;
+
+	LpcTpm *tpm = new_lpc_tpm(fake_regs);
+	uint8_t cmd[32], rsp[FifoSize];
+	make_cmd(cmd, sizeof(cmd));
+	int ret = tpm->ops.xmit(&tpm->ops, cmd, sizeof(cmd), rsp, &len);
+	free(tpm);
+	return ret && !fake.overruns && !fake.burst_violations;
+}
+
+static void test_lpc_tpm_errors(void)
+{
+	// Response sizes smaller than the header, or bigger than the buffer,
+	// are refused without reading any further.
+	CHECK(bad_response(0, 64, FifoSize));
+	CHECK(bad_response(5, 64, FifoSize));
+	CHECK(bad_response(100, 100, 64));
+	CHECK(bad_response(0xffffffff, 64, FifoSize));
+	// The TPM has less data than it claimed.
+	CHECK(bad_response(64, 32, FifoSize));
+
+	// A TPM which never finishes the command, and one which never takes
+	// any of it, time out after about a second of backing off.
+	uint8_t cmd[32], rsp[64];
+	make_cmd(cmd, sizeof(cmd));
+	for (int burst = 0; burst < 2; burst++) {
+		fake_reset(burst, 0);
+		fake.stuck = 1;
+		LpcTpm *tpm = new_lpc_tpm(fake_regs);
+		size_t len = sizeof(rsp);
+		uint64_t start = time_us(0);
+		CHECK(tpm->ops.xmit(&tpm->ops, cmd, sizeof(cmd), rsp, &len));
+		uint64_t elapsed = time_us(start);
+		CHECK(elapsed >= 1000000 && elapsed < 1100000);
+		// Polls back off to one a millisecond.
+		CHECK(fake.accesses < 1100);
+		free(tpm);
+	}
+}
+
+void test_lpc_tpm(void)
+{
+	test_lpc_tpm_bursts();
+	test_lpc_tpm_errors();
+}
+
+typedef struct {
+	LpcTpm *tpm;
+	int size;
+} LpcTpmBench;
+
+static void bench_lpc_tpm_xmit(void *data)
+{
+	LpcTpmBench *bench = data;
+	uint8_t cmd[FifoSize], rsp[FifoSize];
+	size_t len = sizeof(rsp);
+
+	make_cmd(cmd, bench->size);
+	bench->tpm->ops.xmit(&bench->tpm->ops, cmd, bench->size, rsp, &len);
+}
+
+void bench_lpc_tpm(void)
+{
+	static const struct {
+		const char *name;
+		int xdata;
+	} modes[] = {
+		{ "lpc_tpm xmit 1K byte", 0 },
+		{ "lpc_tpm xmit 1K xdata", 1 },
+	};
+
+	for (int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		LpcTpmBench bench = { NULL, 1024 };
+		fake_reset(59, modes[i].xdata);
+		fake.rsp_len = fake.rsp_size_field = bench.size;
+		bench.tpm = new_lpc_tpm(fake_regs);
+
+		// Register accesses are what cost time on real hardware.
+		fake.accesses = 0;
+		bench_lpc_tpm_xmit(&bench);
+		printf("bench: %-28s %8d accesses/op\n", modes[i].name,
+		       fake.accesses);
+
+		hosttest_bench(modes[i].name, 2000, 2 * bench.size,
+			       &bench_lpc_tpm_xmit, &bench);
+		free(bench.tpm);
+	}
+}
@@ -0,0 +1,333 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "base/algorithm.h"
+#include "hosttest.h"
+#include "libc.h"
+
+enum { MallocSlots = 256 };
+
+typedef struct {
+	uint8_t *ptr;
+	size_t size;
+	size_t align;
+	uint8_t fill;
+} MallocSlot;
+
+static uint32_t malloc_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static int malloc_filled(const uint8_t *ptr, size_t size, uint8_t fill)
+{
+	for (size_t i = 0; i < size; i++)
+		if (ptr[i] != fill)
+			return 0;
+	return 1;
+}
+
+// Everything allocated so far has been freed again if one block can take up
+// nearly all of the heap. The memalign bookkeeping holds on to a little.
+static int malloc_heap_whole(void)
+{
+	void *ptr = dc_malloc(CONFIG_HEAP_SIZE - 256);
+	dc_free(ptr);
+	return ptr != NULL;
+}
+
+static void test_malloc_basic(void)
+{
+	static MallocSlot slots[MallocSlots];
+
+	// Blocks are aligned for their headers and don't overlap.
+	int aligned = 1;
+	for (int i = 0; i < MallocSlots; i++) {
+		slots[i].size = i * 7 + 1;
+		slots[i].fill = i;
+		slots[i].ptr = dc_malloc(slots[i].size);
+		CHECK(slots[i].ptr);
+		if ((uintptr_t)slots[i].ptr % 8)
+			aligned = 0;
+		memset(slots[i].ptr, slots[i].fill, slots[i].size);
+	}
+	CHECK(aligned);
+
+	// Free every other block, then the rest, so freed space has to
+	// merge with blocks on both sides.
+	int intact = 1;
+	for (int pass = 0; pass < 2; pass++) {
+		for (int i = pass; i < MallocSlots; i += 2) {
+			if (!malloc_filled(slots[i].ptr, slots[i].size,
+					   slots[i].fill))
+				intact = 0;
+			dc_free(slots[i].ptr);
+		}
+	}
+	CHECK(intact);
+	CHECK(malloc_heap_whole());
+
+	// Freeing something twice, or something that isn't from the heap,
+	// is ignored.
+	uint8_t outside;
+	void *ptr = dc_malloc(16);
+	dc_free(ptr);
+	dc_free(ptr);
+	dc_free(&outside);
+	dc_free(NULL);
+	CHECK(malloc_heap_whole());
+
+	// Sizes which can't be satisfied fail cleanly, including ones which
+	// would be small if they were truncated.
+	CHECK(!dc_malloc(0));
+	CHECK(!dc_malloc(CONFIG_HEAP_SIZE));
+	CHECK(!dc_malloc(((size_t)1 << 32) | 16));
+	CHECK(!dc_malloc(SIZE_MAX));
+	CHECK(!dc_calloc(SIZE_MAX / 2 + 2, 2));
+	CHECK(!dc_calloc(1 << 16, 1 << 16));
+	CHECK(malloc_heap_whole());
+
+	// calloc clears memory which has been used before.
+	ptr = dc_malloc(1000);
+	memset(ptr, 0xa5, 1000);
+	dc_free(ptr);
+	ptr = dc_calloc(10, 100);
+	CHECK(ptr && malloc_filled(ptr, 1000, 0));
+	dc_free(ptr);
+	CHECK(malloc_heap_whole());
+}
+
+static void test_malloc_realloc(void)
+{
+	// realloc of NULL allocates, and of zero bytes frees.
+	uint8_t *ptr = dc_realloc(NULL, 64);
+	CHECK(ptr);
+	CHECK(!dc_realloc(ptr, 0));
+	CHECK(malloc_heap_whole());
+
+	// Growing keeps the contents, whether the block moves or grows in
+	// place into free space after it.
+	uint8_t *before = dc_malloc(64);
+	ptr = dc_malloc(64);
+	uint8_t *after = dc_malloc(64);
+	uint8_t *guard = dc_malloc(64);
+	memset(ptr, 0x11, 64);
+	dc_free(after);
+	uint8_t *grown = dc_realloc(ptr, 128);
+	CHECK(grown == ptr);
+	CHECK(grown && malloc_filled(grown, 64, 0x11));
+	memset(grown, 0x22, 128);
+
+	// Moving into a free block which overlaps the old one, the
+	// bookkeeping for what's left over mustn't land on the data.
+	dc_free(before);
+	ptr = dc_realloc(grown, 160);
+	CHECK(ptr && malloc_filled(ptr, 128, 0x22));
+
+	// Shrinking keeps the start.
+	grown = dc_realloc(ptr, 8);
+	CHECK(grown && malloc_filled(grown, 8, 0x22));
+
+	// A failed realloc leaves the original alone.
+	memset(grown, 0x33, 8);
+	CHECK(!dc_realloc(grown, CONFIG_HEAP_SIZE));
+	CHECK(malloc_filled(grown, 8, 0x33));
+	dc_free(grown);
+	dc_free(guard);
+	CHECK(malloc_heap_whole());
+}
+
+static void test_malloc_memalign(void)
+{
+	static const size_t aligns[] = { 8, 16, 64, 256, 1024, 4096 };
+	static const size_t sizes[] = { 1, 24, 100, 1000, 5000 };
+	static MallocSlot slots[MallocSlots];
+	int count = 0;
+
+	// Small requests share regions per alignment, large ones get their
+	// own, and none of them overlap.
+	int aligned = 1;
+	for (int round = 0; round < 4; round++) {
+		for (int a = 0; a < sizeof(aligns) / sizeof(aligns[0]); a++) {
+			for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]);
+			     s++) {
+				MallocSlot *slot = &slots[count++];
+				slot->align = aligns[a];
+				slot->size = sizes[s];
+				slot->fill = count;
+				slot->ptr = dc_memalign(slot->align,
+							slot->size);
+				CHECK(slot->ptr);
+				if ((uintptr_t)slot->ptr % slot->align)
+					aligned = 0;
+				memset(slot->ptr, slot->fill, slot->size);
+			}
+		}
+	}
+	CHECK(aligned);
+
+	int intact = 1;
+	for (int pass = 0; pass < 2; pass++) {
+		for (int i = pass; i < count; i += 2) {
+			if (!malloc_filled(slots[i].ptr, slots[i].size,
+					   slots[i].fill))
+				intact = 0;
+			dc_free(slots[i].ptr);
+		}
+	}
+	CHECK(intact);
+	CHECK(malloc_heap_whole());
+}
+
+// Random allocations, frees and resizes, checking every live block is still
+// intact as things move around it.
+static void test_malloc_random(void)
+{
+	static MallocSlot slots[MallocSlots];
+	uint32_t seed = 1;
+	int intact = 1, failed = 0;
+
+	memset(slots, 0, sizeof(slots));
+	for (int op = 0; op < 20000; op++) {
+		MallocSlot *slot = &slots[malloc_rand(&seed) % MallocSlots];
+		size_t size = malloc_rand(&seed) % 4096 + 1;
+
+		if (slot->ptr && !malloc_filled(slot->ptr, slot->size,
+						slot->fill))
+			intact = 0;
+
+		switch (malloc_rand(&seed) % 4) {
+		case 0:
+			dc_free(slot->ptr);
+			slot->ptr = dc_malloc(size);
+			slot->align = 0;
+			break;
+		case 1:
+			dc_free(slot->ptr);
+			slot->align = 8 << malloc_rand(&seed) % 8;
+			slot->ptr = dc_memalign(slot->align, size);
+			if (slot->ptr && (uintptr_t)slot->ptr % slot->align)
+				intact = 0;
+			break;
+		case 2:
+			// Only blocks from malloc can be resized.
+			if (!slot->ptr) {
+				slot->ptr = dc_realloc(NULL, size);
+				slot->align = 0;
+				break;
+			}
+			if (slot->align)
+				continue;
+			slot->ptr = dc_realloc(slot->ptr, size);
+			if (slot->ptr && !malloc_filled(slot->ptr,
+					MIN(size, slot->size), slot->fill))
+				intact = 0;
+			break;
+		case 3:
+			dc_free(slot->ptr);
+			slot->ptr = NULL;
+			continue;
+		}
+		if (!slot->ptr) {
+			failed++;
+			continue;
+		}
+		slot->size = size;
+		slot->fill = op;
+		memset(slot->ptr, slot->fill, slot->size);
+	}
+
+	for (int i = 0; i < MallocSlots; i++) {
+		if (slots[i].ptr && !malloc_filled(slots[i].ptr, slots[i].size,
+						   slots[i].fill))
+			intact = 0;
+		dc_free(slots[i].ptr);
+	}
+	CHECK(intact);
+	CHECK(!failed);
+	CHECK(malloc_heap_whole());
+}
+
+void test_malloc(void)
+{
+	test_malloc_basic();
+	test_malloc_realloc();
+	test_malloc_memalign();
+	test_malloc_random();
+}
+
+typedef struct {
+	size_t size;
+	size_t align;
+	int live;
+} MallocBench;
+
+// Allocate and free a block while "live" other blocks are in the way, since
+// every allocation walks the heap from the start.
+static void bench_alloc_free(void *data)
+{
+	MallocBench *bench = data;
+	void *ptr;
+
+	if (bench->align)
+		ptr = dc_memalign(bench->align, bench->size);
+	else
+		ptr = dc_malloc(bench->size);
+	hosttest_use((uintptr_t)ptr);
+	dc_free(ptr);
+}
+
+static void bench_grow(void *data)
+{
+	MallocBench *bench = data;
+	void *ptr = NULL;
+
+	for (size_t size = 64; size <= bench->size; size += 64)
+		ptr = dc_realloc(ptr, size);
+	dc_free(ptr);
+}
+
+void bench_malloc(void)
+{
+	static void *ptrs[4096];
+	static const struct {
+		const char *name;
+		MallocBench bench;
+	} cases[] = {
+		{ "malloc/free 64, 16 live", { 64, 0, 16 } },
+		{ "malloc/free 64, 4096 live", { 64, 0, 4096 } },
+		{ "memalign/free 64, 16 live", { 64, 64, 16 } },
+		{ "memalign/free 4K, 16 live", { 4096, 4096, 16 } },
+	};
+
+	for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		MallocBench bench = cases[i].bench;
+
+		for (int j = 0; j < bench.live; j++)
+			ptrs[j] = dc_malloc(64);
+		hosttest_bench(cases[i].name, 20000, 0, &bench_alloc_free,
+			       &bench);
+		for (int j = 0; j < bench.live; j++)
+			dc_free(ptrs[j]);
+	}
+
+	// With nothing after it, a growing block can stay where it is.
+	MallocBench grow = { 16 * 1024 };
+	hosttest_bench("realloc 64 to 16K", 2000, 0, &bench_grow, &grow);
+}
@@ -0,0 +1,207 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "base/algorithm.h"
+#include "drivers/console/console.h"
+#include "hosttest.h"
+#include "libc.h"
+
+// printf() writes to the console, which is captured here.
+static char console_buf[256];
+static size_t console_len;
+
+void console_write(const void *buffer, size_t count)
+{
+	count = MIN(count, sizeof(console_buf) - 1 - console_len);
+	memcpy(console_buf + console_len, buffer, count);
+	console_len += count;
+	console_buf[console_len] = '\0';
+}
+
+// Format the same thing with depthcharge's printf and the host's, which
+// agree on everything depthcharge supports other than the cases below.
+static void __attribute__((format(printf, 2, 3)))
+check_same(int line, const char *fmt, ...)
+{
+	char dc[256], host[256];
+	va_list args, args_copy;
+
+	va_start(args, fmt);
+	va_copy(args_copy, args);
+	int dc_len = dc_vsnprintf(dc, sizeof(dc), fmt, args);
+	int host_len = vsnprintf(host, sizeof(host), fmt, args_copy);
+	va_end(args_copy);
+	va_end(args);
+
+	if (dc_len != host_len || strcmp(dc, host)) {
+		printf("line %d: \"%s\" gave \"%s\" (%d), expected \"%s\" "
+		       "(%d)\n", line, fmt, dc, dc_len, host, host_len);
+		hosttest_fail(__FILE__, line, fmt);
+	}
+}
+
+#define CHECK_SAME(...) check_same(__LINE__, __VA_ARGS__)
+
+static void check_output(int line, const char *expected, const char *fmt,
+			 ...)
+{
+	char dc[256];
+	va_list args;
+
+	va_start(args, fmt);
+	int dc_len = dc_vsnprintf(dc, sizeof(dc), fmt, args);
+	va_end(args);
+
+	if (dc_len != strlen(expected) || strcmp(dc, expected)) {
+		printf("line %d: \"%s\" gave \"%s\" (%d), expected \"%s\"\n",
+		       line, fmt, dc, dc_len, expected);
+		hosttest_fail(__FILE__, line, fmt);
+	}
+}
+
+#define CHECK_OUTPUT(...) check_output(__LINE__, __VA_ARGS__)
+
+static void test_printf_conversions(void)
+{
+	CHECK_SAME("plain text");
+	CHECK_SAME("100%% sure %c%c", 'o', 'k');
+	CHECK_SAME("%d %i %u", 42, -42, 42u);
+	CHECK_SAME("%d %d %u", INT_MAX, INT_MIN, UINT_MAX);
+	CHECK_SAME("%ld %lu %lld %llu", LONG_MIN, ULONG_MAX, LLONG_MIN,
+		   ULLONG_MAX);
+	CHECK_SAME("%zu %zd %zx", (size_t)12345, (ssize_t)-5, SIZE_MAX);
+	CHECK_SAME("%hhd %hhu %hd %hu", 0x17f, 0x1ff, 0x18000, 0x1ffff);
+	CHECK_SAME("%hhd %hd", -3, -300);
+	CHECK_SAME("%x %X %o", 0xdeadbeef, 0xdeadbeef, 0755);
+	CHECK_SAME("%llx %llX", 0x0123456789abcdefULL, 0xfedcba9876543210ULL);
+	CHECK_SAME("%p", (void *)0x1234);
+	CHECK_SAME("%s and %s", "this", "");
+
+	// Flags.
+	CHECK_SAME("%#x %#X %#o", 0x1f, 0x1f, 8);
+	CHECK_SAME("%+d %+d % d % d", 5, -5, 5, -5);
+	CHECK_SAME("[%-6d] [%-6u] [%-6x] [%-6s] [%-3c]", -12, 12, 0xab, "ab",
+		   'c');
+	CHECK_SAME("[%06d] [%06d] [%06x] [%#06x] [%+06d]", 12, -12, 0xab, 0xab,
+		   12);
+
+	// Flags which override others, which the compiler only warns about
+	// in literal formats.
+	const char *overridden = "[%+ d] [%-06d] [%08.4d]";
+	CHECK_SAME(overridden, 5, 12, 12);
+
+	// Width and precision.
+	CHECK_SAME("[%6d] [%6s] [%3c] [%2d] [%2s]", -12, "ab", 'c', 12345,
+		   "abcd");
+	CHECK_SAME("[%.4d] [%.4d] [%.4x] [%8.4d] [%-8.4d]", 12, -12, 0xab, 12,
+		   12);
+	CHECK_SAME("[%.2s] [%6.2s] [%-6.2s] [%.10s] [%6.10s]", "abcd", "abcd",
+		   "abcd", "abcd", "abcd");
+	CHECK_SAME("[%.0s] [%5.0s]", "abcd", "abcd");
+	CHECK_SAME("[%*d] [%-*d] [%*d]", 5, 1, 5, 1, -5, 1);
+	CHECK_SAME("[%.*d] [%*.*x]", 3, 7, 6, 3, 0xa);
+	CHECK_SAME("[%.*s] [%.*s] [%.*s]", 2, "abcd", 0, "abcd", -1, "abcd");
+
+	// Things depthcharge does differently, or which are its own.
+	CHECK_OUTPUT("(NULL)", "%s", (char *)NULL);
+	CHECK_OUTPUT("101 0b101 0", "%b %#b %b", 5, 5, 0);
+	CHECK_OUTPUT("0X12AB", "%P", (void *)0x12ab);
+	CHECK_OUTPUT("[%y]", "[%y]", 5);
+}
+
+static void test_printf_truncation(void)
+{
+	char buf[16];
+
+	// snprintf() always terminates what it writes, and returns the
+	// length it would have been.
+	memset(buf, 'x', sizeof(buf));
+	CHECK(dc_snprintf(buf, 8, "%s-%d", "truncated", 12345) == 15);
+	CHECK(!strcmp(buf, "truncat"));
+	CHECK(buf[8] == 'x');
+
+	memset(buf, 'x', sizeof(buf));
+	CHECK(dc_snprintf(buf, 1, "%d", 12345) == 5);
+	CHECK(buf[0] == '\0' && buf[1] == 'x');
+
+	memset(buf, 'x', sizeof(buf));
+	CHECK(dc_snprintf(buf, 0, "%d", 12345) == 5);
+	CHECK(buf[0] == 'x');
+	CHECK(dc_snprintf(NULL, 0, "%d", 12345) == 5);
+
+	// Output which ends exactly at the end of the buffer, in pieces.
+	memset(buf, 'x', sizeof(buf));
+	CHECK(dc_snprintf(buf, 6, "ab%sde", "c") == 5);
+	CHECK(!strcmp(buf, "abcde"));
+	CHECK(dc_snprintf(buf, 6, "ab%sdef", "c") == 6);
+	CHECK(!strcmp(buf, "abcde"));
+
+	// Padding wider than the number buffer.
+	char wide[200];
+	CHECK(dc_snprintf(wide, sizeof(wide), "%150d|%-150d|", 1, 2) == 302);
+	CHECK(strlen(wide) == sizeof(wide) - 1);
+	CHECK(wide[148] == ' ' && wide[149] == '1' && wide[150] == '|');
+	CHECK(wide[151] == '2' && wide[152] == ' ');
+
+	CHECK(dc_sprintf(buf, "%s=%x", "val", 0x2a) == 6);
+	CHECK(!strcmp(buf, "val=2a"));
+}
+
+void test_printf(void)
+{
+	test_printf_conversions();
+	test_printf_truncation();
+
+	console_len = 0;
+	CHECK(dc_printf("%s %d\n", "console", 7) == 10);
+	CHECK(!strcmp(console_buf, "console 7\n"));
+}
+
+typedef struct {
+	const char *fmt;
+	uint64_t value;
+	const char *str;
+} PrintfBench;
+
+static void bench_snprintf(void *data)
+{
+	PrintfBench *bench = data;
+	char buf[128];
+
+	hosttest_use(dc_snprintf(buf, sizeof(buf), bench->fmt, bench->value,
+				 bench->str));
+}
+
+void bench_printf(void)
+{
+	static const struct {
+		const char *name;
+		PrintfBench bench;
+	} cases[] = {
+		{ "snprintf text", { "no conversions in this one at all" } },
+		{ "snprintf %llu", { "%llu", 18446744073709551615ULL } },
+		{ "snprintf %#018llx %s", { "%#018llx %s", 0xdeadbeef, "str" } },
+		{ "snprintf log line", { "%08llx: %-20s", 0x1234, "status" } },
+	};
+
+	for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+		hosttest_bench(cases[i].name, 1000000, 0, &bench_snprintf,
+			       (void *)&cases[i].bench);
+}
@@ -0,0 +1,216 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hosttest.h"
+#include "libc.h"
+
+// Elements carry a 32 bit key, then for the larger sizes an id and filler
+// derived from it, so the checks can tell the elements were moved whole.
+enum { QsortMaxSize = 16, QsortMaxCount = 10000 };
+
+typedef enum {
+	QsortRandom,
+	QsortFewKeys,
+	QsortSorted,
+	QsortReversed,
+	QsortEqual,
+	QsortOrganPipe,
+	QsortHalves,
+	QsortPatterns
+} QsortPattern;
+
+static const char *const qsort_pattern_names[QsortPatterns] = {
+	"random", "few keys", "sorted", "reversed", "equal", "organ pipe",
+	"halves",
+};
+
+static int qsort_compares;
+
+static uint32_t qsort_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 8;
+}
+
+static uint32_t qsort_key(const void *elem)
+{
+	uint32_t key;
+	memcpy(&key, elem, sizeof(key));
+	return key;
+}
+
+static int qsort_cmp(const void *a, const void *b)
+{
+	uint32_t key_a = qsort_key(a), key_b = qsort_key(b);
+
+	qsort_compares++;
+	return key_a < key_b ? -1 : key_a > key_b;
+}
+
+static int qsort_cmp_u32(const void *a, const void *b)
+{
+	uint32_t key_a = *(const uint32_t *)a, key_b = *(const uint32_t *)b;
+	return key_a < key_b ? -1 : key_a > key_b;
+}
+
+static uint32_t qsort_make_key(QsortPattern pattern, int i, int n,
+			       uint32_t *seed)
+{
+	switch (pattern) {
+	case QsortRandom:
+		return qsort_rand(seed);
+	case QsortFewKeys:
+		return qsort_rand(seed) % 4;
+	case QsortSorted:
+		return i;
+	case QsortReversed:
+		return n - i;
+	case QsortEqual:
+		return 7;
+	case QsortOrganPipe:
+		return i < n / 2 ? i : n - i;
+	case QsortHalves:
+		// Split around the median without needing any swaps, but
+		// with the first half backwards.
+		return i < n / 2 ? n / 2 - 1 - i : i;
+	default:
+		return 0;
+	}
+}
+
+static void qsort_fill(uint8_t *elems, uint32_t *keys, size_t size,
+		       QsortPattern pattern, int n, uint32_t seed)
+{
+	for (int i = 0; i < n; i++) {
+		uint8_t *elem = elems + i * size;
+		uint32_t id = i;
+
+		keys[i] = qsort_make_key(pattern, i, n, &seed);
+		memcpy(elem, &keys[i], sizeof(keys[i]));
+		if (size >= 8)
+			memcpy(elem + 4, &id, sizeof(id));
+		for (size_t j = 8; j < size; j++)
+			elem[j] = id * 31 + j;
+	}
+}
+
+// Sort n elements of the given size, which also decides how qsort swaps
+// them, and check the keys come out in order with every element intact.
+static void check_qsort(size_t size, size_t misalign, QsortPattern pattern,
+			int n, uint32_t seed)
+{
+	static uint8_t buf[QsortMaxSize * QsortMaxCount + 8];
+	static uint32_t keys[QsortMaxCount];
+	static uint8_t seen[QsortMaxCount];
+	uint8_t *elems = buf + misalign;
+
+	qsort_fill(elems, keys, size, pattern, n, seed);
+	qsort(keys, n, sizeof(keys[0]), &qsort_cmp_u32);
+
+	qsort_compares = 0;
+	dc_qsort(elems, n, size, &qsort_cmp);
+
+	int sorted = 1, intact = 1;
+	memset(seen, 0, n);
+	for (int i = 0; i < n; i++) {
+		const uint8_t *elem = elems + i * size;
+		uint32_t id;
+
+		if (qsort_key(elem) != keys[i])
+			sorted = 0;
+		if (size < 8)
+			continue;
+		memcpy(&id, elem + 4, sizeof(id));
+		if (id >= n || seen[id]++) {
+			intact = 0;
+			continue;
+		}
+		for (size_t j = 8; j < size; j++)
+			if (elem[j] != (uint8_t)(id * 31 + j))
+				intact = 0;
+	}
+	CHECK(sorted);
+	CHECK(intact);
+
+	// Nothing here should need more than a few n log n comparisons.
+	int log2n = 1;
+	while ((1 << log2n) < n)
+		log2n++;
+	CHECK(qsort_compares <= 4 * n * log2n + 16);
+}
+
+void test_qsort(void)
+{
+	// Sizes which swap a long at a time, a long at a time in a loop, and
+	// byte by byte, and a misaligned array which forces bytes too.
+	static const size_t sizes[] = { 8, 16, 4, 12 };
+	static const int counts[] = {
+		0, 1, 2, 3, 6, 7, 8, 9, 40, 41, 100, 1000, QsortMaxCount
+	};
+
+	for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		for (int c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+			for (int p = 0; p < QsortPatterns; p++) {
+				check_qsort(sizes[s], 0, p, counts[c], c + 1);
+				check_qsort(sizes[s], 1, p, counts[c], c + 1);
+			}
+		}
+	}
+}
+
+typedef struct {
+	QsortPattern pattern;
+	size_t size;
+	int count;
+	uint8_t *elems;
+} QsortBench;
+
+static void bench_sort(void *data)
+{
+	static uint32_t keys[QsortMaxCount];
+	QsortBench *bench = data;
+
+	// Refilling is a small, fixed part of each operation.
+	qsort_fill(bench->elems, keys, bench->size, bench->pattern,
+		   bench->count, 1);
+	dc_qsort(bench->elems, bench->count, bench->size, &qsort_cmp);
+}
+
+void bench_qsort(void)
+{
+	static uint8_t elems[QsortMaxSize * QsortMaxCount];
+	static const QsortPattern patterns[] = {
+		QsortRandom, QsortSorted, QsortFewKeys, QsortHalves
+	};
+
+	for (int p = 0; p < sizeof(patterns) / sizeof(patterns[0]); p++) {
+		QsortBench bench = { patterns[p], 8, QsortMaxCount, elems };
+		char name[64];
+
+		snprintf(name, sizeof(name), "qsort 10000 %s",
+			 qsort_pattern_names[patterns[p]]);
+		qsort_compares = 0;
+		bench_sort(&bench);
+		printf("bench: %-28s %8d compares/op\n", name,
+		       qsort_compares);
+		hosttest_bench(name, 200, 0, &bench_sort, &bench);
+	}
+
+	QsortBench large = { QsortRandom, 16, QsortMaxCount, elems };
+	hosttest_bench("qsort 10000 random 16B", 200, 0, &bench_sort, &large);
+}
@@ -0,0 +1,122 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "base/ranges.h"
+#include "hosttest.h"
+
+// Small enough to check exhaustively against a bitmap of covered units.
+enum { RangesUniverse = 256 };
+
+typedef struct {
+	uint8_t covered[RangesUniverse];
+	int bad_order;
+	uint64_t last_end;
+} RangesModel;
+
+static void ranges_mark(uint64_t start, uint64_t end, void *data)
+{
+	RangesModel *model = data;
+
+	// Ranges come out sorted, non-empty and not touching each other.
+	if (start >= end || (model->last_end && start <= model->last_end))
+		model->bad_order = 1;
+	model->last_end = end;
+	for (uint64_t i = start; i < end && i < RangesUniverse; i++)
+		model->covered[i] = 1;
+}
+
+static uint32_t ranges_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 16;
+}
+
+static void check_ranges(Ranges *ranges, const uint8_t *expected)
+{
+	RangesModel model;
+	memset(&model, 0, sizeof(model));
+	ranges_for_each(ranges, &ranges_mark, &model);
+	CHECK(!model.bad_order);
+	CHECK(!memcmp(model.covered, expected, RangesUniverse));
+}
+
+void test_ranges(void)
+{
+	Ranges ranges;
+	uint8_t expected[RangesUniverse];
+
+	// Touching ranges merge, and holes split them again.
+	ranges_init(&ranges);
+	ranges_add(&ranges, 0, 10);
+	ranges_add(&ranges, 10, 20);
+	CHECK(ranges.count == 2);
+	ranges_sub(&ranges, 5, 15);
+	CHECK(ranges.count == 4);
+	ranges_sub(&ranges, 0, 20);
+	CHECK(ranges.count == 0);
+	ranges_teardown(&ranges);
+
+	// Random adds and subtracts against a simple model.
+	uint32_t seed = 1;
+	for (int round = 0; round < 200; round++) {
+		ranges_init(&ranges);
+		memset(expected, 0, sizeof(expected));
+		for (int op = 0; op < 50; op++) {
+			uint32_t start = ranges_rand(&seed) % RangesUniverse;
+			uint32_t end = ranges_rand(&seed) % RangesUniverse;
+			if (start == end)
+				continue;
+			if (start > end) {
+				uint32_t tmp = start;
+				start = end;
+				end = tmp;
+			}
+			int add = ranges_rand(&seed) & 1;
+			if (add)
+				ranges_add(&ranges, start, end);
+			else
+				ranges_sub(&ranges, start, end);
+			memset(expected + start, add, end - start);
+			check_ranges(&ranges, expected);
+		}
+		ranges_teardown(&ranges);
+	}
+}
+
+static void bench_ranges_ops(void *data)
+{
+	Ranges ranges;
+	uint32_t seed = 1;
+
+	ranges_init(&ranges);
+	for (int op = 0; op < 1000; op++) {
+		uint64_t start = ranges_rand(&seed) * 4096;
+		uint64_t size = (ranges_rand(&seed) % 64 + 1) * 4096;
+		if (op % 3)
+			ranges_add(&ranges, start, start + size);
+		else
+			ranges_sub(&ranges, start, start + size);
+	}
+	hosttest_use(ranges.count);
+	ranges_teardown(&ranges);
+}
+
+void bench_ranges(void)
+{
+	hosttest_bench("ranges add/sub x1000", 2000, 0, &bench_ranges_ops,
+		       NULL);
+}
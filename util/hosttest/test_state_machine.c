@@ -0,0 +1,170 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "base/state_machine.h"
+#include "hosttest.h"
+
+// The pseudo keyboard's machine on Ryu, which turns combinations and
+// sequences of the power and volume buttons into keys.
+enum {
+	SmStart,
+	SmCtrlD,
+	SmCtrlU,
+	SmEnter,
+	SmSpace,
+	SmCtrlL,
+	SmTab,
+	SmPower,
+	SmStates,
+};
+
+enum {
+	SmVolDown = 1 << 0,
+	SmVolUp = 1 << 1,
+	SmPwr = 1 << 2,
+};
+
+static const int sm_final_states[] = {
+	SmCtrlD, SmCtrlU, SmEnter, SmSpace, SmCtrlL, SmTab,
+};
+
+static const struct {
+	int src;
+	int input;
+	int dst;
+} sm_transitions[] = {
+	{ SmStart, SmPwr | SmVolUp, SmCtrlD },
+	{ SmStart, SmPwr | SmVolDown, SmCtrlU },
+	{ SmStart, SmVolUp, SmEnter },
+	{ SmStart, SmVolDown, SmSpace },
+	{ SmStart, SmPwr, SmPower },
+	{ SmPower, SmVolUp, SmCtrlL },
+	{ SmPower, SmVolDown, SmTab },
+};
+
+// State machines can't be freed, so keep them reachable. These are only
+// ever written, so they're volatile to keep the stores.
+static struct sm_data *volatile sm_keyboard, *volatile sm_chain;
+
+static struct sm_data *sm_build_keyboard(void)
+{
+	struct sm_data *sm = sm_init(SmStates);
+
+	sm_add_start_state(sm, SmStart);
+	sm_add_nonfinal_state(sm, SmPower);
+	for (int i = 0; i < sizeof(sm_final_states) /
+			    sizeof(sm_final_states[0]); i++)
+		sm_add_final_state(sm, sm_final_states[i]);
+	for (int i = 0; i < sizeof(sm_transitions) /
+			    sizeof(sm_transitions[0]); i++)
+		sm_add_transition(sm, sm_transitions[i].src,
+				  sm_transitions[i].input,
+				  sm_transitions[i].dst);
+	return sm;
+}
+
+void test_state_machine(void)
+{
+	struct sm_data *sm = sm_keyboard = sm_build_keyboard();
+	int output = -1;
+
+	// Single presses finish straight away, and put the machine back at
+	// the start.
+	CHECK(sm_run(sm, SmVolUp, &output) == STATE_FINAL);
+	CHECK(output == SmEnter);
+	CHECK(sm_run(sm, SmPwr | SmVolDown, &output) == STATE_FINAL);
+	CHECK(output == SmCtrlU);
+
+	// Sequences go through intermediate states.
+	CHECK(sm_run(sm, SmPwr, &output) == STATE_NOT_FINAL);
+	CHECK(output == SmPower);
+	CHECK(sm_run(sm, SmVolDown, &output) == STATE_FINAL);
+	CHECK(output == SmTab);
+
+	// Inputs with nowhere to go leave the state and output alone.
+	CHECK(sm_run(sm, SmPwr, &output) == STATE_NOT_FINAL);
+	output = -1;
+	CHECK(sm_run(sm, SmPwr, &output) == STATE_NO_TRANSITION);
+	CHECK(output == -1);
+	CHECK(sm_run(sm, SmVolUp, &output) == STATE_FINAL);
+	CHECK(output == SmCtrlL);
+
+	// Resetting abandons a sequence.
+	CHECK(sm_run(sm, SmPwr, &output) == STATE_NOT_FINAL);
+	sm_reset_state(sm);
+	CHECK(sm_run(sm, SmVolUp, &output) == STATE_FINAL);
+	CHECK(output == SmEnter);
+
+	// Adding a state twice keeps the first one.
+	sm = sm_init(3);
+	sm_add_start_state(sm, 0);
+	sm_add_nonfinal_state(sm, 1);
+	sm_add_final_state(sm, 1);
+	sm_add_final_state(sm, 2);
+	sm_add_transition(sm, 0, 'a', 1);
+	sm_add_transition(sm, 1, 'b', 2);
+	CHECK(sm_run(sm, 'a', &output) == STATE_NOT_FINAL && output == 1);
+	CHECK(sm_run(sm, 'b', &output) == STATE_FINAL && output == 2);
+
+	// When a state has two transitions for the same input, the one
+	// added last wins.
+	sm_add_transition(sm, 0, 'a', 2);
+	CHECK(sm_run(sm, 'a', &output) == STATE_FINAL && output == 2);
+	sm_chain = sm;
+}
+
+typedef struct {
+	struct sm_data *sm;
+	const int *inputs;
+	int count;
+} SmBench;
+
+static void bench_run(void *data)
+{
+	SmBench *bench = data;
+	int output;
+
+	for (int i = 0; i < bench->count; i++)
+		hosttest_use(sm_run(bench->sm, bench->inputs[i], &output));
+}
+
+void bench_state_machine(void)
+{
+	enum { ChainStates = 128 };
+	static int chain[ChainStates];
+
+	// Every key the Ryu machine knows, once each.
+	static const int keys[] = {
+		SmPwr | SmVolUp, SmPwr | SmVolDown, SmVolUp, SmVolDown,
+		SmPwr, SmVolUp, SmPwr, SmVolDown,
+	};
+	SmBench keyboard = { sm_build_keyboard(), keys,
+			     sizeof(keys) / sizeof(keys[0]) };
+	sm_keyboard = keyboard.sm;
+	hosttest_bench("sm_run keyboard, 6 keys", 1000000, 0, &bench_run,
+		       &keyboard);
+
+	// A start state with a transition for each of many inputs, where
+	// finding the right one means walking the list.
+	sm_chain = sm_init(ChainStates + 1);
+	sm_add_start_state(sm_chain, ChainStates);
+	for (int i = 0; i < ChainStates; i++) {
+		sm_add_final_state(sm_chain, i);
+		sm_add_transition(sm_chain, ChainStates, i, i);
+		chain[i] = i;
+	}
+	SmBench wide = { sm_chain, chain, ChainStates };
+	hosttest_bench("sm_run 128 transitions", 10000, 0, &bench_run, &wide);
+}
@@ -0,0 +1,131 @@
+/* Copyright 2016 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "base/time.h"
+#include "hosttest.h"
+
+// base/time.c runs on the fake 32 bit timer in hosttest.c.
+
+static uint64_t time_rand(uint64_t *seed)
+{
+	*seed = *seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return *seed;
+}
+
+static void test_time_conversion(void)
+{
+	// time_us() doesn't mask the raw value, so it can be fed full 64 bit
+	// values to push the high half of the 128 bit product. The result
+	// should be within one of the exact quotient.
+	uint64_t seed = 1;
+	hosttest_timer.mask = ~0ULL;
+	hosttest_timer.step = 0;
+	for (int i = 0; i < 100000; i++) {
+		uint64_t raw = time_rand(&seed) >> (i % 64);
+		hosttest_timer.raw = raw;
+		uint64_t expected =
+			(unsigned __int128)raw * 1000000 / HostTimerHz;
+		uint64_t got = time_us(0);
+		CHECK(got - expected + 1 <= 2);
+	}
+	hosttest_timer.raw = ~0ULL;
+	CHECK(time_us(0) ==
+	      (unsigned __int128)~0ULL * 1000000 / HostTimerHz);
+	hosttest_timer.mask = 0xffffffff;
+
+	// Deadlines are the scaled interval on top of the current count.
+	for (uint64_t us = 0; us < 1000000; us += 997) {
+		hosttest_timer.raw = 0;
+		uint64_t ticks = time_deadline_us(us);
+		uint64_t expected = us * (HostTimerHz / 1000000.0);
+		CHECK(ticks - expected + 1 <= 2);
+	}
+	hosttest_timer.raw = 0;
+	CHECK(time_deadline_ms(1000) == HostTimerHz);
+}
+
+static void test_time_wrap(void)
+{
+	hosttest_timer.step = 0;
+
+	// A deadline set just before the 32 bit counter wraps lands after it.
+	hosttest_timer.raw = 0xffffff00;
+	uint64_t deadline = time_deadline_us(100);
+	// 100us is 1920 ticks, 0x100 before the wrap and 0x680 after it.
+	CHECK(deadline == 0x680);
+
+	uint64_t not_yet[] = { 0xffffff00, 0xffffffff, 0, deadline - 1 };
+	for (int i = 0; i < sizeof(not_yet) / sizeof(not_yet[0]); i++) {
+		hosttest_timer.raw = not_yet[i];
+		CHECK(!time_deadline_expired(deadline));
+	}
+	uint64_t expired[] = { deadline, deadline + 1, 0x10000,
+			       deadline + 0x7fffffff };
+	for (int i = 0; i < sizeof(expired) / sizeof(expired[0]); i++) {
+		hosttest_timer.raw = expired[i];
+		CHECK(time_deadline_expired(deadline));
+	}
+
+	// The same for a deadline that doesn't wrap.
+	hosttest_timer.raw = 0x1000;
+	deadline = time_deadline_ms(1);
+	CHECK(deadline == 0x1000 + 19200);
+	hosttest_timer.raw = deadline - 1;
+	CHECK(!time_deadline_expired(deadline));
+	hosttest_timer.raw = deadline;
+	CHECK(time_deadline_expired(deadline));
+
+	// Delays across the wrap finish, and take about as long as asked.
+	hosttest_timer.step = 7;
+	hosttest_timer.raw = 0xfffffff0;
+	udelay(100);
+	CHECK(hosttest_timer.raw >= 1920 - 16 && hosttest_timer.raw < 1920 + 16);
+	hosttest_timer.step = 0;
+}
+
+void test_time(void)
+{
+	test_time_conversion();
+	test_time_wrap();
+	hosttest_timer.step = 1;
+}
+
+static void bench_time_us(void *data)
+{
+	for (int i = 0; i < 1000; i++) {
+		hosttest_timer.raw = i * 0x123456789ULL;
+		hosttest_use(time_us(0));
+	}
+}
+
+static void bench_time_deadline(void *data)
+{
+	uint64_t deadline = time_deadline_us(1000);
+	for (int i = 0; i < 1000; i++) {
+		hosttest_timer.raw = (i * 0x1234567ULL) & hosttest_timer.mask;
+		hosttest_use(time_deadline_expired(deadline));
+	}
+}
+
+void bench_time(void)
+{
+	hosttest_timer.step = 0;
+	hosttest_timer.mask = ~0ULL;
+	hosttest_bench("time_us x1000", 20000, 0, &bench_time_us, NULL);
+	hosttest_timer.mask = 0xffffffff;
+	hosttest_bench("time_deadline_expired x1000", 20000, 0,
+		       &bench_time_deadline, NULL);
+	hosttest_timer.step = 1;
+}
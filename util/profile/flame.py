@@ -0,0 +1,78 @@
+#!/usr/bin/python
+#
+# Copyright 2016 Google Inc.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# Render the boot profile depthcharge prints when built with CONFIG_PROFILE
+# as a text flame chart. Pass it the console log, for instance the output of
+# "cbmem -c", as a file name or on stdin.
+
+import re
+import sys
+
+RECORD = re.compile(r'profile: ( *)(\S+) (\d+) (\d+) (\d+)$')
+TOTAL = re.compile(r'profile-total: (\S+) (\d+) (\d+) (\d+) (\d+)$')
+
+WIDTH = 60
+
+def main():
+    log = open(sys.argv[1]) if len(sys.argv) > 1 else sys.stdin
+
+    records = []
+    totals = []
+    for line in log:
+        line = line.rstrip()
+        match = RECORD.search(line)
+        if match:
+            indent, name, start, duration, size = match.groups()
+            records.append((len(indent) // 2, name, int(start),
+                            int(duration), int(size)))
+            continue
+        match = TOTAL.search(line)
+        if match:
+            name, calls, duration, size, rate = match.groups()
+            totals.append((name, int(calls), int(duration), int(size),
+                           int(rate)))
+
+    if not records:
+        print('No profile records found.')
+        return 1
+
+    first = min(record[2] for record in records)
+    last = max(record[2] + record[3] for record in records)
+    span = max(last - first, 1)
+
+    # Each row is drawn at its offset into the profile, scaled to WIDTH
+    # columns, so nested zones line up underneath the zones they're in.
+    for depth, name, start, duration, size in records:
+        offset = (start - first) * WIDTH // span
+        length = max(duration * WIDTH // span, 1)
+        bar = ' ' * offset + '#' * length
+        label = '  ' * depth + name
+        print('%-*s |%-*s| %8.3f ms %10d B' % (
+            24, label, WIDTH, bar, duration / 1000.0, size))
+
+    if totals:
+        print('')
+        print('%-16s %8s %12s %12s %10s' %
+              ('zone', 'calls', 'ms', 'bytes', 'KB/s'))
+        totals.sort(key=lambda total: total[2], reverse=True)
+        for name, calls, duration, size, rate in totals:
+            print('%-16s %8d %12.3f %12d %10d' %
+                  (name, calls, duration / 1000.0, size, rate))
+
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main())